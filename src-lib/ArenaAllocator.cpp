@@ -0,0 +1,73 @@
+/*
+ * ArenaAllocator.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "ArenaAllocator.hpp"
+#include <algorithm>
+
+using namespace std;
+
+namespace cpprob
+{
+
+  Arena::Arena(std::size_t block_size)
+      : blocks_(), block_size_(block_size), end_(0), free_objects_(), next_(
+          0), reserved_objects_(0)
+  {
+  }
+
+  Arena::~Arena()
+  {
+    for (auto b = blocks_.begin(); b != blocks_.end(); ++b)
+      ::operator delete(*b);
+  }
+
+  void*
+  Arena::allocate(std::size_t size)
+  {
+    size = aligned_size(size);
+    auto free_object = free_objects_.find(size);
+    if (free_object != free_objects_.end() && free_object->second != 0)
+    {
+      void* object = free_object->second;
+      free_object->second = *static_cast<void**>(object);
+      return object;
+    }
+
+    const size_t room = end_ - next_;
+    if (room < size || room < reserved_objects_ * size)
+    {
+      const size_t block_size = max(max(block_size_, size),
+          reserved_objects_ * size);
+      blocks_.reserve(blocks_.size() + 1);
+      next_ = static_cast<char*>(::operator new(block_size));
+      end_ = next_ + block_size;
+      blocks_.push_back(next_);
+      reserved_objects_ = 0;
+    }
+    void* object = next_;
+    next_ += size;
+    return object;
+  }
+
+  std::size_t
+  Arena::aligned_size(std::size_t size)
+  {
+    // Every object can hold the link of the free list.
+    const size_t alignment = alignof(max_align_t);
+    size = max(size, sizeof(void*));
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  void
+  Arena::deallocate(void* object, std::size_t size)
+  {
+    void*& first = free_objects_[aligned_size(size)];
+    *static_cast<void**>(object) = first;
+    first = object;
+  }
+
+} /* namespace cpprob */
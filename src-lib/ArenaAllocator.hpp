@@ -0,0 +1,167 @@
+/*
+ * ArenaAllocator.hpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#ifndef ARENAALLOCATOR_HPP_
+#define ARENAALLOCATOR_HPP_
+
+#include "cont/map.hpp"
+#include "cont/vector.hpp"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace cpprob
+{
+
+  /**
+   * Memory for many small objects in a few large blocks. An allocation
+   * takes the next bytes of the current block; so objects allocated one
+   * after the other lie next to each other in memory. A freed object goes
+   * to a free list of its size and is reused by the next allocation of
+   * this size. The blocks are returned to the system only when the arena is
+   * destroyed.
+   */
+  class Arena
+  {
+
+  public:
+
+    explicit
+    Arena(std::size_t block_size = 64 * 1024);
+
+    ~Arena();
+
+    void*
+    allocate(std::size_t size);
+
+    void
+    deallocate(void* object, std::size_t size);
+
+    /**
+     * Makes room for the given number of allocations of the size that is
+     * allocated next, in one block. This is a hint; it saves the
+     * allocation of many blocks when the number of objects is known.
+     */
+    void
+    reserve(std::size_t objects)
+    {
+      reserved_objects_ = objects;
+    }
+
+  private:
+
+    cont::vector<char*> blocks_;
+    std::size_t block_size_;
+    char* end_;
+    /* The first free object of every size; a free object holds the pointer
+     * to the next one. */
+    cont::map<std::size_t, void*> free_objects_;
+    char* next_;
+    std::size_t reserved_objects_;
+
+    Arena(const Arena&);
+
+    Arena&
+    operator=(const Arena&);
+
+    static std::size_t
+    aligned_size(std::size_t size);
+
+  };
+
+  /**
+   * Allocator that takes single objects from an Arena and larger arrays
+   * from the free store. Copies of the allocator, also of a rebound one,
+   * share the arena. So the nodes of a list are allocated contiguously in
+   * the order of their insertion, and their addresses never change.
+   */
+  template<class T>
+    class ArenaAllocator
+    {
+
+    public:
+
+      typedef T value_type;
+      typedef T* pointer;
+      typedef const T* const_pointer;
+      typedef T& reference;
+      typedef const T& const_reference;
+      typedef std::size_t size_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef std::true_type propagate_on_container_move_assignment;
+      typedef std::true_type propagate_on_container_swap;
+
+      template<class U>
+        struct rebind
+        {
+          typedef ArenaAllocator<U> other;
+        };
+
+      ArenaAllocator()
+          : arena_(std::make_shared<Arena>())
+      {
+      }
+
+      template<class U>
+        ArenaAllocator(const ArenaAllocator<U>& other)
+            : arena_(other.arena_)
+        {
+        }
+
+      // Use the implicit destructor, so the implicit copy and move operations
+      // are generated by the compiler.
+
+      pointer
+      allocate(size_type n)
+      {
+        if (n == 1)
+          return static_cast<pointer>(arena_->allocate(sizeof(T)));
+        return static_cast<pointer>(::operator new(n * sizeof(T)));
+      }
+
+      Arena&
+      arena() const
+      {
+        return *arena_;
+      }
+
+      void
+      deallocate(pointer p, size_type n)
+      {
+        if (n == 1)
+          arena_->deallocate(p, sizeof(T));
+        else
+          ::operator delete(p);
+      }
+
+      template<class U>
+        bool
+        operator==(const ArenaAllocator<U>& other) const
+        {
+          return arena_ == other.arena_;
+        }
+
+      template<class U>
+        bool
+        operator!=(const ArenaAllocator<U>& other) const
+        {
+          return arena_ != other.arena_;
+        }
+
+    private:
+
+      template<class U>
+        friend class ArenaAllocator;
+
+      std::shared_ptr<Arena> arena_;
+
+    };
+
+} /* namespace cpprob */
+
+#endif /* ARENAALLOCATOR_HPP_ */
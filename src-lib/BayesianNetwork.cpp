@@ -9,6 +9,12 @@
 #endif
 
 #include "BayesianNetwork.hpp"
+#include "cont/map.hpp"
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <thread>
 
 using namespace boost;
 using namespace std;
@@ -16,305 +22,1483 @@ using namespace std;
 namespace cpprob
 {
 
-  class BayesianNetwork::CopyNode : public static_visitor<>
+  /**
+   * Builds the factors for #eliminate(). Every categorical node contributes
+   * one factor. Its variables are the free variables among the node variable
+   * and the condition variables. All other variables keep their current
+   * values; so they are evidence for the factor.
+   */
+  class BayesianNetwork::CollectFactors : public static_visitor<>
   {
 
-    typedef variant<CategoricalNode*, ConditionalCategoricalNode*,
-        ConditionalDirichletNode*, ConstantDirichletProcessParametersNode*,
-        ConstantDiscreteRandomVariableNode*,
-        ConstantRandomConditionalProbabilitiesNode*,
-        ConstantRandomProbabilitiesNode*, DirichletNode*, DirichletProcessNode*> NodePointer;
-    typedef variant<const CategoricalNode*, const ConditionalCategoricalNode*,
-        const ConditionalDirichletNode*,
-        const ConstantDirichletProcessParametersNode*,
-        const ConstantDiscreteRandomVariableNode*,
-        const ConstantRandomConditionalProbabilitiesNode*,
-        const ConstantRandomProbabilitiesNode*, const DirichletNode*,
-        const DirichletProcessNode*> ConstNodePointer;
-    typedef variant<const DirichletProcessParameters*,
-        const DiscreteRandomVariable*, const RandomConditionalProbabilities*,
-        const RandomProbabilities*> ValuePointer;
-    typedef map<ConstNodePointer, NodePointer> NodeNodeTable;
-    typedef map<ValuePointer, NodePointer> ValueNodeTable;
-
   public:
 
-    explicit
-    CopyNode(BayesianNetwork& new_network)
-        : new_network_(new_network)
+    CollectFactors(const DiscreteFactor::Variables& free_variables,
+        cont::list<DiscreteFactor>& factors)
+        : free_variables_(free_variables), factors_(factors)
     {
     }
 
     void
-    operator()(const CategoricalNode& old_node)
+    operator()(CategoricalNode& node) const
     {
-      ValuePointer old_probabilities = &old_node.probabilities();
-      ValueNodeTable::iterator new_probabilities_node = value_node_table.find(
-          old_probabilities);
-      if (new_probabilities_node == value_node_table.end())
-        cpprob_throw_logic_error(
-          "BayesianNetwork: Could not copy the network because of an inconsistent structure. New probabilities could not be found. Old probabilities: "
-          << apply_visitor(StreamOutPointerValueToString(), old_probabilities));
+      DiscreteFactor::Variables factor_variables;
+      add_if_free(factor_variables, node.value());
+      collect(factor_variables, node);
+    }
+
+    void
+    operator()(ConditionalCategoricalNode& node) const
+    {
+      DiscreteFactor::Variables factor_variables;
+      add_if_free(factor_variables, node.value());
+      const DiscreteRandomReferences& condition = node.condition();
+      for (auto c = condition.begin(); c != condition.end(); ++c)
+        add_if_free(factor_variables, *c);
+      collect(factor_variables, node);
+    }
 
-      if (DirichletNode** new_dirichlet = get<DirichletNode*>(
-          &new_probabilities_node->second))
+    template<class V, class C>
+      void
+      operator()(ConstantNode<V, C>&) const
       {
-        CategoricalNode& new_node = new_network_.add_categorical(
-            old_node.value(), **new_dirichlet);
-        new_node.is_evidence(old_node.is_evidence());
-        node_node_table[&old_node] = &new_node;
-        value_node_table[&old_node.value()] = &new_node;
       }
-      else if (ConstantRandomProbabilitiesNode **new_constant = get<ConstantRandomProbabilitiesNode*>(
-          &new_probabilities_node->second))
+
+    template<class N>
+      void
+      operator()(N& node) const
       {
-        CategoricalNode& new_node = new_network_.add_categorical(
-            old_node.value(), **new_constant);
-        new_node.is_evidence(old_node.is_evidence());
-        node_node_table[&old_node] = &new_node;
-        value_node_table[&old_node.value()] = &new_node;
+        if (node.is_evidence())
+          cpprob_throw_network_error(
+              "BayesianNetwork: Cannot eliminate with the evidence node " //
+              << node.value().name() << " of type " << typeid(N).name() << ".");
       }
+
+  private:
+
+    const DiscreteFactor::Variables& free_variables_;
+    cont::list<DiscreteFactor>& factors_;
+
+    void
+    add_if_free(DiscreteFactor::Variables& factor_variables,
+        const DiscreteRandomVariable& var) const
+    {
+      DiscreteRandomVariable* const p =
+          &const_cast<DiscreteRandomVariable&>(var);
+      if (std::find(free_variables_.begin(), free_variables_.end(), p)
+          != free_variables_.end())
+        factor_variables.push_back(p);
+    }
+
+    template<class N>
+      void
+      collect(const DiscreteFactor::Variables& factor_variables,
+          const N& node) const
+      {
+        DiscreteFactor factor(factor_variables);
+        factor.fill([&node]()
+        {
+          return node.at_references();
+        });
+        factors_.push_back(factor);
+      }
+
+  };
+
+  /**
+   * Copies the nodes of a network in their order for the copy constructor
+   * and #overlay(). Every copied node is entered with its address and the
+   * address of its value, which is how the later nodes refer to it. So a
+   * reference is translated by one hash lookup, and the copy takes linear
+   * time.
+   *
+   * In an overlay, the parameter nodes are not copied but shared: The new
+   * node refers to the parameters of the old network. Otherwise, every
+   * parent must have been copied before its children.
+   */
+  class BayesianNetwork::CopyNode : public static_visitor<>
+  {
+
+    typedef unordered_map<const void*, Node*> VertexTable;
+
+  public:
+
+    CopyNode(BayesianNetwork& new_network, std::size_t size,
+        bool is_overlay)
+        : new_network_(new_network), is_overlay_(is_overlay), vertex_table_()
+    {
+      vertex_table_.reserve(2 * size);
     }
 
     void
-    operator()(const ConditionalCategoricalNode& old_node)
+    operator()(const CategoricalNode& old_node)
     {
-      ValuePointer old_probabilities = &old_node.probabilities();
-      ValueNodeTable::iterator new_probabilities_node = value_node_table.find(
-          old_probabilities);
-      if (new_probabilities_node == value_node_table.end())
-        cpprob_throw_logic_error(
-          "BayesianNetwork: Could not copy the network because of an inconsistent structure. New pobabilities could not be found. Old probabilities: "
-          << apply_visitor(StreamOutPointerValueToString(), old_probabilities));
+      Node* parameter_node = find(&old_node.probabilities());
+      CategoricalNode* new_node;
+      if (parameter_node == 0)
+      {
+        check_overlay(old_node.probabilities());
+        // The parameters are read only; see overlay().
+        new_node = &new_network_.insert_categorical(old_node.value(),
+            const_cast<RandomProbabilities&>(old_node.probabilities()));
+      }
+      else if (DirichletNode* dirichlet = get<DirichletNode>(parameter_node))
+        new_node = &new_network_.add_categorical(old_node.value(), *dirichlet);
+      else
+        new_node = &new_network_.add_categorical(old_node.value(),
+            get<ConstantRandomProbabilitiesNode>(*parameter_node));
+      new_node->is_evidence(old_node.is_evidence());
+      add(old_node, *new_node);
+    }
 
-      cont::RefVector<DiscreteNode> new_condition_nodes;
-      for (DiscreteRandomReferences::const_iterator c =
-          old_node.condition().begin(); c != old_node.condition().end(); ++c)
+    void
+    operator()(const ConditionalCategoricalNode& old_node)
+    {
+      cont::RefVector<DiscreteNode> condition_nodes;
+      for (auto c = old_node.condition().begin();
+          c != old_node.condition().end(); ++c)
       {
-        ValueNodeTable::iterator new_condition_node = value_node_table.find(
-            &(*c));
-        if (new_condition_node == value_node_table.end())
+        Node* condition_node = find(&*c);
+        if (condition_node == 0)
           cpprob_throw_logic_error(
             "BayesianNetwork: Could not copy the network because of an inconsistent structure. New condition node could not be found. Old node: "
             << *c);
 
-        if (CategoricalNode** new_categorical = get<CategoricalNode*>(&new_condition_node->second))
-          new_condition_nodes.push_back(**new_categorical);
-
-        else if (ConditionalCategoricalNode** new_conditional_categorical = get<ConditionalCategoricalNode*>(&new_condition_node->second))
-          new_condition_nodes.push_back(**new_conditional_categorical);
-
-        else if (DirichletProcessNode** new_dirichlet_process = get<DirichletProcessNode*>(&new_condition_node->second))
-          new_condition_nodes.push_back(**new_dirichlet_process);
-
+        if (CategoricalNode* categorical = get<CategoricalNode>(condition_node))
+          condition_nodes.push_back(*categorical);
+        else if (ConditionalCategoricalNode* conditional_categorical = get<
+            ConditionalCategoricalNode>(condition_node))
+          condition_nodes.push_back(*conditional_categorical);
+        else if (DirichletProcessNode* dirichlet_process = get<
+            DirichletProcessNode>(condition_node))
+          condition_nodes.push_back(*dirichlet_process);
         else
           cpprob_throw_logic_error(
-						"BayesianNetwork: Could not copy the network because of an inconsistent structure. Invalid type of the condition node. New condition node: "
-						<< apply_visitor(StreamOutPointerValueToString(), new_condition_node->second));
+            "BayesianNetwork: Could not copy the network because of an inconsistent structure. Invalid type of the condition node. Old node: "
+            << *c);
       }
 
-      if (ConditionalDirichletNode** new_dirichlet = get<ConditionalDirichletNode*>(&new_probabilities_node->second))
+      Node* parameter_node = find(&old_node.probabilities());
+      ConditionalCategoricalNode* new_node;
+      if (parameter_node == 0)
       {
-        ConditionalCategoricalNode& new_node =
-            new_network_.add_conditional_categorical(old_node.value(),
-                new_condition_nodes, **new_dirichlet);
-        new_node.is_evidence(old_node.is_evidence());
-        node_node_table[&old_node] = &new_node;
-        value_node_table[&old_node.value()] = &new_node;
-      }
-      else if (ConstantRandomConditionalProbabilitiesNode** new_constant = get<ConstantRandomConditionalProbabilitiesNode*>(&new_probabilities_node->second))
-      {
-        ConditionalCategoricalNode& new_node =
-            new_network_.add_conditional_categorical(old_node.value(),
-                new_condition_nodes, **new_constant);
-        new_node.is_evidence(old_node.is_evidence());
-        node_node_table[&old_node] = &new_node;
-        value_node_table[&old_node.value()] = &new_node;
+        check_overlay(old_node.probabilities());
+        DiscreteRandomReferences condition;
+        for (auto n = condition_nodes.begin(); n != condition_nodes.end(); ++n)
+          condition.insert(n->value());
+        new_node = &new_network_.insert_conditional_categorical(
+            old_node.value(), condition,
+            const_cast<RandomConditionalProbabilities&>(old_node.probabilities()));
+        for (auto n = condition_nodes.begin(); n != condition_nodes.end(); ++n)
+          n->children().push_back(*new_node);
       }
+      else if (ConditionalDirichletNode* dirichlet = get<
+          ConditionalDirichletNode>(parameter_node))
+        new_node = &new_network_.add_conditional_categorical(old_node.value(),
+            condition_nodes, *dirichlet);
+      else
+        new_node = &new_network_.add_conditional_categorical(old_node.value(),
+            condition_nodes,
+            get<ConstantRandomConditionalProbabilitiesNode>(*parameter_node));
+      new_node->is_evidence(old_node.is_evidence());
+      add(old_node, *new_node);
     }
 
     void
     operator()(const ConditionalDirichletNode& old_node)
     {
+      if (is_overlay_)
+        return;
+
       ConditionalDirichletNode& new_node =
           new_network_.add_conditional_dirichlet(old_node.value(),
               old_node.parameters().begin()->second);
       new_node.is_evidence(old_node.is_evidence());
-      node_node_table[&old_node] = &new_node;
-      value_node_table[&old_node.value()] = &new_node;
+      new_node.is_collapsed(old_node.is_collapsed());
+      new_node.forgetting_ = old_node.forgetting_;
+      // The condition of the observations stays empty until the first one.
+      if (!old_node.observed_totals_.empty())
+        new_node.observed_condition_ = old_node.observed_condition_;
+      new_node.observed_counts_ = old_node.observed_counts_;
+      new_node.observed_totals_ = old_node.observed_totals_;
+      new_node.observation_scale_ = old_node.observation_scale_;
+      new_node.children().reserve(old_node.children().size());
+      add(old_node, new_node);
     }
 
     void
     operator()(const ConstantDirichletProcessParametersNode& old_node)
     {
-      typedef ConstantDirichletProcessParametersNode NodeType;
-      const auto& old_value = old_node.value();
-
-      // Translate the Dirichlet nodes managed by the Dirichlet process.
-      DirichletProcessParameters::ManagedNodes managed_nodes;
-      auto old_managed_nodes = old_value.managed_nodes();
-      for (auto node_it = old_managed_nodes.begin();
-          node_it != old_managed_nodes.end(); ++node_it)
+      // The Dirichlet process changes its parameters while sampling; so
+      // they cannot be shared.
+      if (is_overlay_)
+        cpprob_throw_logic_error(
+            "BayesianNetwork: Cannot overlay a network with a Dirichlet process (node " << old_node.value().name() << ").");
+
+      // Copy the components and settings, and translate the Dirichlet nodes
+      // managed by the Dirichlet process.
+      DirichletProcessParameters new_value = old_node.value();
+      DirichletProcessParameters::ManagedNodes& managed_nodes =
+          new_value.managed_nodes();
+      for (auto n = managed_nodes.begin(); n != managed_nodes.end(); ++n)
       {
-        ConditionalDirichletNode* old_managed_node = &(*node_it);
-        ConditionalDirichletNode* new_managed_node = get<
-            ConditionalDirichletNode*>(node_node_table.at(old_managed_node));
-        managed_nodes.push_back(*new_managed_node);
+        Node* managed_node = find(&*n);
+        if (managed_node == 0)
+          cpprob_throw_logic_error(
+              "BayesianNetwork: Could not copy the network because of an inconsistent structure. A managed node of " << old_node.value().name() << " could not be found.");
+        *n.base() = &get<ConditionalDirichletNode>(*managed_node);
       }
 
-      // Create the new node for the Dirichlet process parameters.
-      NodeType& new_node = new_network_.add_dirichlet_process_parameters(
-          old_value.name(), old_value.concentration(), managed_nodes);
-      node_node_table[&old_node] = &new_node;
-      value_node_table[&old_value] = &new_node;
+      add(old_node, new_network_.add_constant(new_value));
+    }
+
+    void
+    operator()(const ConstantDiscreteRandomVariableNode& old_node)
+    {
+      add(old_node, new_network_.add_constant(old_node.value()));
     }
 
     void
     operator()(const DirichletNode& old_node)
     {
+      if (is_overlay_)
+        return;
+
       DirichletNode& new_node = new_network_.add_dirichlet(old_node.value(),
           old_node.parameters().begin()->second);
       new_node.is_evidence(old_node.is_evidence());
-      node_node_table[&old_node] = &new_node;
-      value_node_table[&old_node.value()] = &new_node;
+      new_node.is_collapsed(old_node.is_collapsed());
+      new_node.forgetting_ = old_node.forgetting_;
+      new_node.observed_counts_ = old_node.observed_counts_;
+      new_node.observed_total_ = old_node.observed_total_;
+      new_node.observation_scale_ = old_node.observation_scale_;
+      new_node.children().reserve(old_node.children().size());
+      add(old_node, new_node);
     }
 
     void
     operator()(const DirichletProcessNode& old_node)
     {
-      auto* new_parameters_node = get<ConstantDirichletProcessParametersNode*>(
-          value_node_table.at(&old_node.parameters()));
+      Node* parameters_node = find(&old_node.parameters());
+      if (parameters_node == 0)
+        cpprob_throw_logic_error(
+            "BayesianNetwork: Could not copy the network because of an inconsistent structure. The parameters of " << old_node.value() << " could not be found.");
+
+      // Take over the component; a new node would reset the number of
+      // components of the component variable.
+      ConstantDirichletProcessParametersNode& new_parameters_node = get<
+          ConstantDirichletProcessParametersNode>(*parameters_node);
+      iterator new_vertex = new_network_.insert_vertex(
+          DirichletProcessNode(new_parameters_node.value(), old_node.value()));
+      DirichletProcessNode& new_node = get<DirichletProcessNode>(*new_vertex);
+      new_parameters_node.children().push_back(new_node);
+      add(old_node, new_node);
+    }
 
-      auto& new_node = new_network_.add_dirichlet_process(*new_parameters_node);
-      node_node_table[&old_node] = &new_node;
-      value_node_table[&old_node.value()] = &new_node;
+    void
+    operator()(const PlateNode& old_node)
+    {
+      // Translate the parameter nodes of the template variables. The plate
+      // comes after its parameter nodes, so they have been copied already.
+      PlateTemplate new_template = old_node.template_nodes();
+      PlateTemplate::Nodes& nodes = new_template.nodes();
+      for (auto n = nodes.begin(); n != nodes.end(); ++n)
+        n->parameter_node_ = apply_visitor(TranslateParameterNode(*this),
+            n->parameter_node_);
+
+      // The values of the latent variables are taken over like observed
+      // values. So reset the evidence flags afterwards. Only the copied
+      // parameter nodes learn from the new plate.
+      iterator new_vertex = new_network_.insert_vertex(
+          PlateNode(new_template, old_node.value()));
+      PlateNode& new_node = get<PlateNode>(*new_vertex);
+      const PlateTemplate::Nodes& old_nodes =
+          old_node.template_nodes().nodes();
+      for (std::size_t n = 0; n != nodes.size(); ++n)
+      {
+        new_node.is_evidence(nodes[n].value_,
+            old_node.is_evidence(nodes[n].value_));
+        if (nodes[n].parameter_node_ == old_nodes[n].parameter_node_)
+          continue;
+        if (DirichletNode* const * dirichlet = get<DirichletNode*>(
+            &nodes[n].parameter_node_))
+          (*dirichlet)->plates().push_back(new_node);
+        else if (ConditionalDirichletNode* const * conditional_dirichlet = get<
+            ConditionalDirichletNode*>(&nodes[n].parameter_node_))
+          (*conditional_dirichlet)->plates().push_back(new_node);
+      }
+      add(old_node, new_node);
     }
 
     template<class V, class C>
       void
       operator()(const ConstantNode<V, C>& old_node)
       {
+        if (is_overlay_)
+          return;
+
         ConstantNode<V, C>& new_node = new_network_.add_constant(
             old_node.value());
-        node_node_table[&old_node] = &new_node;
-        value_node_table[&old_node.value()] = &new_node;
+        new_node.children().reserve(old_node.children().size());
+        add(old_node, new_node);
       }
 
   private:
 
+    class TranslateParameterNode : public static_visitor<
+        PlateTemplate::ParameterNode>
+    {
+
+    public:
+
+      explicit
+      TranslateParameterNode(const CopyNode& copy_node)
+          : copy_node_(copy_node)
+      {
+      }
+
+      template<class N>
+        PlateTemplate::ParameterNode
+        operator()(N* old_node) const
+        {
+          Node* new_node = copy_node_.find(old_node);
+          if (new_node != 0)
+            return &get<N>(*new_node);
+          copy_node_.check_overlay(old_node->value());
+          return old_node;
+        }
+
+    private:
+
+      const CopyNode& copy_node_;
+
+    };
+
     BayesianNetwork& new_network_;
-    NodeNodeTable node_node_table;
-    ValueNodeTable value_node_table;
+    /* If true, the parameter nodes are shared instead of copied. */
+    bool is_overlay_;
+    /* The new node for the address of an old node and of its value */
+    VertexTable vertex_table_;
+
+    /* Only an overlay shares parameters that have not been copied. */
+    template<class V>
+      void
+      check_overlay(const V& parameters) const
+      {
+        if (!is_overlay_)
+          cpprob_throw_logic_error(
+              "BayesianNetwork: Could not copy the network because of an inconsistent structure. New probabilities could not be found. Old probabilities: " << parameters.name());
+      }
+
+    /* Enters the new node, which is the last one of the new network. */
+    template<class N>
+      void
+      add(const N& old_node, const N& new_node)
+      {
+        cpprob_check_debug(&get<N>(new_network_.vertices_.back()) == &new_node,
+            "BayesianNetwork: The copy of a node is not the last node.");
+
+        Node* new_vertex = &new_network_.vertices_.back();
+        vertex_table_[&old_node] = new_vertex;
+        vertex_table_[&old_node.value()] = new_vertex;
+      }
+
+    Node*
+    find(const void* old_address) const
+    {
+      auto entry = vertex_table_.find(old_address);
+      return entry == vertex_table_.end() ? 0 : entry->second;
+    }
+
+  };
+
+  /**
+   * Removes the references to the erased nodes from the children and plates
+   * of a parent node for #erase_vertices(). The Dirichlet nodes drop their
+   * counts if they lose a child or plate.
+   */
+  class BayesianNetwork::EraseReferences : public static_visitor<>
+  {
+
+  public:
+
+    /**
+     * @param erased the sorted addresses of the erased nodes
+     */
+    EraseReferences(const cont::vector<const void*>& erased)
+        : erased_(erased)
+    {
+    }
+
+    template<class N>
+      void
+      operator()(N& node) const
+      {
+        erase_references(node.children());
+      }
+
+    void
+    operator()(ConditionalDirichletNode& node) const
+    {
+      if (erase_references(node.children()) | erase_references(node.plates()))
+        node.invalidate_counts();
+    }
+
+    void
+    operator()(DirichletNode& node) const
+    {
+      if (erase_references(node.children()) | erase_references(node.plates()))
+        node.invalidate_counts();
+    }
+
+  private:
+
+    const cont::vector<const void*>& erased_;
+
+    /* Compacts the references in one pass and tells whether any was
+     * erased. */
+    template<class References>
+      bool
+      erase_references(References& references) const
+      {
+        auto kept = remove_if(references.begin().base(),
+            references.end().base(), [this](const void* address)
+            {
+              return binary_search(erased_.begin(), erased_.end(), address);
+            });
+        if (kept == references.end().base())
+          return false;
+
+        references.erase(typename References::iterator(kept),
+            references.end());
+        return true;
+      }
+
+  };
+
+  /**
+   * Tells for #erase_vertices() whether a node has a child or plate that is
+   * not erased with it.
+   */
+  class BayesianNetwork::HasDependents : public static_visitor<bool>
+  {
+
+  public:
+
+    /**
+     * @param erased the sorted addresses of the erased nodes
+     */
+    HasDependents(const cont::vector<const void*>& erased)
+        : erased_(erased)
+    {
+    }
+
+    template<class N>
+      bool
+      operator()(const N& node) const
+      {
+        return has_kept(node.children());
+      }
+
+    bool
+    operator()(const ConditionalDirichletNode& node) const
+    {
+      return has_kept(node.children()) || has_kept(node.plates());
+    }
+
+    bool
+    operator()(const DirichletNode& node) const
+    {
+      return has_kept(node.children()) || has_kept(node.plates());
+    }
+
+  private:
+
+    const cont::vector<const void*>& erased_;
+
+    template<class References>
+      bool
+      has_kept(const References& references) const
+      {
+        for (auto r = references.begin(); r != references.end(); ++r)
+        {
+          if (!binary_search(erased_.begin(), erased_.end(),
+              static_cast<const void*>(&*r)))
+            return true;
+        }
+        return false;
+      }
+
+  };
+
+  /**
+   * Provides the address of a node and of its value, the keys of the node
+   * in #addresses_.
+   */
+  class BayesianNetwork::NodeAddresses : public static_visitor<
+      pair<const void*, const void*> >
+  {
+
+  public:
+
+    template<class N>
+      pair<const void*, const void*>
+      operator()(const N& node) const
+      {
+        return make_pair(static_cast<const void*>(&node),
+            static_cast<const void*>(&node.value()));
+      }
+
+  };
+
+  /**
+   * Collects the addresses by which a node refers to its parents: the
+   * values of the parameter and condition nodes, or the parameter nodes of
+   * the template of a plate. These are keys of #addresses_.
+   */
+  class BayesianNetwork::ParentsOfNode : public static_visitor<>
+  {
+
+  public:
+
+    ParentsOfNode(cont::vector<const void*>& parents)
+        : parents_(parents)
+    {
+    }
+
+    template<class N>
+      void
+      operator()(const N&) const
+      {
+      }
+
+    void
+    operator()(const CategoricalNode& node) const
+    {
+      parents_.push_back(&node.probabilities());
+    }
+
+    void
+    operator()(const ConditionalCategoricalNode& node) const
+    {
+      parents_.push_back(&node.probabilities());
+      const DiscreteRandomReferences& condition = node.condition();
+      for (auto c = condition.begin(); c != condition.end(); ++c)
+        parents_.push_back(&*c);
+    }
+
+    void
+    operator()(const DirichletProcessNode& node) const
+    {
+      parents_.push_back(&node.parameters());
+    }
+
+    void
+    operator()(const PlateNode& node) const
+    {
+      const PlateTemplate::Nodes& nodes = node.template_nodes().nodes();
+      for (auto n = nodes.begin(); n != nodes.end(); ++n)
+        apply_visitor(*this, n->parameter_node_);
+    }
+
+    template<class N>
+      void
+      operator()(N* parameter_node) const
+      {
+        parents_.push_back(parameter_node);
+      }
+
+  private:
+
+    cont::vector<const void*>& parents_;
 
   };
 
+  /**
+   * Learns the parameter nodes of the network for #learn(). The visitor
+   * collects the Dirichlet nodes first; run() then counts the evidence and
+   * writes the probabilities.
+   *
+   * The children of a node are split into shards of at least
+   * #shard_size_ children. Every shard counts into a count buffer of its
+   * own, so the shards of all nodes can be counted in parallel. Then the
+   * buffers of every node are added and the probabilities are written, in
+   * parallel for the nodes. The counts are whole numbers in doubles; so
+   * the sums and the learned probabilities do not depend on the number of
+   * threads.
+   */
   class BayesianNetwork::LearnParameters : public static_visitor<>
   {
 
   public:
 
-    /**
-     * Learns a parameter of type RandomConditionalProbabilities that is
-     * Dirichlet distributed. So this method learns the maximum a posteriori
-     * probabilities given the data and the Dirichlet prior. To get the maximum
-     * likelihood probabilities, just set the Dirichlet parameters to 0.
-     *
-     * @param node the parameter node to learn
-     * @throw Any #learn() catches all exceptions and maps them appropriately
-     *     for its interface.
-     */
+    explicit
+    LearnParameters(unsigned int threads)
+        : threads_(threads), nodes_(), shards_()
+    {
+    }
+
+    /**
+     * Adds a parameter of type RandomConditionalProbabilities that is
+     * Dirichlet distributed. So learning finds the maximum a posteriori
+     * probabilities given the data and the Dirichlet prior. To get the
+     * maximum likelihood probabilities, just set the Dirichlet parameters to
+     * 0.
+     *
+     * @param node the parameter node to learn
+     */
+    void
+    operator()(ConditionalDirichletNode& node)
+    {
+      if (node.is_evidence())
+        return;
+
+      /* Check requirements */
+      cpprob_check_debug(
+          node.children().begin() != node.children().end() || node.plates().begin() != node.plates().end() || !node.observed_totals_.empty(),
+          "BayesianNetwork: Cannot learn the conditional Dirichlet node without children (node name: " + node.value().name() + ").");
+
+      /* I need the range of the condition variable to set up the table of
+       * the counters. */
+      DiscreteRandomVariable::Range condition_range = node.condition_range();
+      add_node(0, &node, condition_range.size(), node.children().size());
+    }
+
+    /**
+     * Adds a parameter of type RandomProbabilities that is Dirichlet
+     * distributed. See operator()(ConditionalDirichletNode&).
+     *
+     * @param node the parameter node to learn
+     */
+    void
+    operator()(DirichletNode& node)
+    {
+      if (node.is_evidence())
+        return;
+
+      add_node(&node, 0, 1, node.children().size());
+    }
+
+    template<class N>
+      void
+      operator()(N&) const
+      {
+      }
+
+    /**
+     * Counts the evidence of the collected nodes and writes the learned
+     * probabilities.
+     *
+     * @throw Any The first exception of a thread is rethrown after all
+     *     threads have finished.
+     */
+    void
+    run()
+    {
+      for_each_index(shards_.size(), [this](size_t s)
+      { count_shard(s);});
+      for_each_index(nodes_.size(), [this](size_t n)
+      { write_node(n);});
+    }
+
+    /* A parameter node to learn; exactly one of the pointers is set. Its
+     * shards are shards_[first_shard_] to shards_[end_shard_ - 1]. */
+    struct Node
+    {
+      DirichletNode* node_;
+      ConditionalDirichletNode* conditional_node_;
+      std::size_t row_size_;
+      std::size_t rows_;
+      std::size_t first_shard_;
+      std::size_t end_shard_;
+    };
+
+    const cont::vector<Node>&
+    nodes() const
+    {
+      return nodes_;
+    }
+
+    /**
+     * Writes the probabilities of the collected nodes from the given counts
+     * instead of counting the evidence children. This is the M-step of
+     * ExpectationMaximization.
+     *
+     * @param counts the counts of every collected node, rows_ * row_size_
+     *     values per node; the counts of the plates and the observations
+     *     are added
+     */
+    void
+    write(const cont::vector<cont::vector<double> >& counts) const
+    {
+      for_each_index(nodes_.size(), [this, &counts](size_t n)
+      {
+        cont::vector<double> node_counts(counts[n]);
+        if (nodes_[n].node_ != 0)
+          write_probabilities(*nodes_[n].node_, node_counts);
+        else
+          write_probabilities(*nodes_[n].conditional_node_, node_counts);
+      });
+    }
+
+    /* Runs the function for the indices 0 to count - 1 on the threads. */
+    template<class Function>
+      void
+      for_each_index(std::size_t count, const Function& function) const
+      {
+        const unsigned int threads = std::min<std::size_t>(threads_, count);
+        if (threads <= 1)
+        {
+          for (std::size_t i = 0; i != count; ++i)
+            function(i);
+          return;
+        }
+
+        std::atomic<std::size_t> next(0);
+        cont::vector<exception_ptr> errors(threads);
+        auto run_indices = [&](unsigned int t)
+        {
+          try
+          {
+            for (std::size_t i = next++; i < count; i = next++)
+            function(i);
+          }
+          catch (...)
+          {
+            errors[t] = current_exception();
+          }
+        };
+
+        cont::vector<std::thread> workers;
+        for (unsigned int t = 0; t != threads; ++t)
+          workers.push_back(std::thread(run_indices, t));
+        for (auto w = workers.begin(); w != workers.end(); ++w)
+          w->join();
+
+        for (auto e = errors.begin(); e != errors.end(); ++e)
+        {
+          if (*e)
+            rethrow_exception(*e);
+        }
+      }
+
+  private:
+
+    /* A range of children of a node and its count buffer of
+     * rows_ * row_size_ counts. */
+    struct Shard
+    {
+      std::size_t node_;
+      std::size_t begin_;
+      std::size_t end_;
+      cont::vector<double> counts_;
+    };
+
+    static const std::size_t shard_size_ = 4096;
+
+    unsigned int threads_;
+    cont::vector<Node> nodes_;
+    cont::vector<Shard> shards_;
+
+    void
+    add_node(DirichletNode* node, ConditionalDirichletNode* conditional_node,
+        std::size_t rows, std::size_t children)
+    {
+      const std::size_t shards = std::max<std::size_t>(1,
+          std::min<std::size_t>(threads_, children / shard_size_));
+      Node n =
+      { node, conditional_node, node ?
+          node->parameters().size() : conditional_node->parameters().size(),
+          rows, shards_.size(), shards_.size() + shards };
+      nodes_.push_back(n);
+
+      for (std::size_t s = 0; s != shards; ++s)
+      {
+        Shard shard =
+        { nodes_.size() - 1, children * s / shards, children * (s + 1)
+            / shards, cont::vector<double>() };
+        shards_.push_back(shard);
+      }
+    }
+
+    void
+    count_shard(std::size_t s)
+    {
+      Shard& shard = shards_[s];
+      const Node& node = nodes_[shard.node_];
+      shard.counts_.assign(node.rows_ * node.row_size_, 0.0);
+
+      if (node.node_ != 0)
+      {
+        auto& children = node.node_->children();
+        for (std::size_t c = shard.begin_; c != shard.end_; ++c)
+        {
+          if (children[c].is_evidence())
+            shard.counts_.at(children[c].value().value_index()) += 1.0;
+        }
+      }
+      else
+      {
+        auto& children = node.conditional_node_->children();
+        for (std::size_t c = shard.begin_; c != shard.end_; ++c)
+        {
+          if (children[c].is_evidence())
+          {
+            const DiscreteRandomVariable child_condition =
+                children[c].condition().joint_value();
+            shard.counts_.at(
+                child_condition.value_index() * node.row_size_
+                    + children[c].value().value_index()) += 1.0;
+          }
+        }
+      }
+    }
+
+    void
+    write_node(std::size_t n)
+    {
+      const Node& node = nodes_[n];
+
+      /* Add the counts of the shards. */
+      cont::vector<double> counts(node.rows_ * node.row_size_, 0.0);
+      for (std::size_t s = node.first_shard_; s != node.end_shard_; ++s)
+      {
+        for (std::size_t i = 0; i != counts.size(); ++i)
+          counts[i] += shards_[s].counts_[i];
+      }
+
+      if (node.node_ != 0)
+        write_probabilities(*node.node_, counts);
+      else
+        write_probabilities(*node.conditional_node_, counts);
+    }
+
+    void
+    write_probabilities(ConditionalDirichletNode& node,
+        cont::vector<double>& counts) const
+    {
+      const std::size_t row_size = node.parameters().size();
+
+      /* Add the rows of the plates. */
+      DiscreteRandomVariableMap<DiscreteRandomVariableMap<double> > plate_counts;
+      auto& plates = node.plates();
+      for (auto p = plates.begin(); p != plates.end(); ++p)
+        p->add_counts(node, plate_counts, true);
+      for (auto row = plate_counts.begin(); row != plate_counts.end(); ++row)
+      {
+        for (auto c = row->second.begin(); c != row->second.end(); ++c)
+          counts.at(row->first.value_index() * row_size + c->first.value_index()) +=
+              c->second;
+      }
+
+      /* Add the observations. */
+      const std::size_t observed_rows = std::min(node.observed_totals_.size(),
+          counts.size() / row_size);
+      for (std::size_t i = 0; i != observed_rows * row_size; ++i)
+        counts[i] += node.observed_counts_[i] * node.observation_scale_;
+
+      /* Clear the target variable. I use it for counters and normalize it
+       * in the end. Initialize the counters with the values of the Dirichlet
+       * prior distribution. If the prior values are zero, the algorithm
+       * performs just maximum likelihood learning. The parameter set of the
+       * Dirichlet prior contains only one Dirichlet distribution that is
+       * equal for all condition values. The rows are written with set(); so
+       * a table in the dense layout stays dense. */
+      RandomConditionalProbabilities& probabilities = node.value();
+      probabilities.clear();
+      DiscreteRandomVariable::Range condition_range = node.condition_range();
+      RandomProbabilities prob_set;
+      for (auto condition = condition_range.begin();
+          condition != condition_range.end(); ++condition)
+      {
+        prob_set.clear();
+        copy(node.parameters().begin(), node.parameters().end(),
+            inserter(prob_set, prob_set.begin()));
+
+        /* Add the likelihood to the counters. */
+        const double* row = &counts[condition.value_index() * row_size];
+        for (auto p = prob_set.begin(); p != prob_set.end(); ++p)
+          p->second += static_cast<float>(row[p->first.value_index()]);
+        probabilities.set(condition, prob_set);
+      }
+
+      /* Normalize the counters to probabilities. */
+      probabilities.normalize();
+    }
+
+    void
+    write_probabilities(DirichletNode& node,
+        cont::vector<double>& counts) const
+    {
+      /* Add the rows of the plates. */
+      DiscreteRandomVariableMap<double> plate_counts;
+      auto& plates = node.plates();
+      for (auto p = plates.begin(); p != plates.end(); ++p)
+        p->add_counts(node, plate_counts, true);
+      for (auto c = plate_counts.begin(); c != plate_counts.end(); ++c)
+        counts.at(c->first.value_index()) += c->second;
+
+      /* Add the observations. */
+      for (std::size_t i = 0; i != node.observed_counts_.size(); ++i)
+        counts[i] += node.observed_counts_[i] * node.observation_scale_;
+
+      /* Clear the target variable. I use it for counters and normalize it
+       * in the end. Initialize the counters with the parameter values of the
+       * Dirichlet prior values. Without this pre-initialization, the
+       * algorithm performs just maximum likelihood learning. */
+      RandomProbabilities& probabilities = node.value();
+      probabilities.clear();
+      copy(node.parameters().begin(), node.parameters().end(),
+          inserter(probabilities, probabilities.begin()));
+
+      /* Add the likelihood to the counters. */
+      for (auto p = probabilities.begin(); p != probabilities.end(); ++p)
+        p->second += static_cast<float>(counts[p->first.value_index()]);
+
+      /* Normalize the counters to probabilities. */
+      probabilities.normalize();
+    }
+
+  };
+
+  /**
+   * Learns the parameter nodes of the network by expectation maximization
+   * for #learn_em(). The categorical nodes are split into rows: the
+   * connected components of the graph without the parameter nodes. The
+   * counts of the rows without latent nodes are fixed, but their
+   * log-likelihood is computed from the current tables. For every row with
+   * latent nodes, expect() enumerates the joint values of its latent nodes
+   * and adds the expected counts of all its nodes. Then maximize() writes
+   * the probabilities like #learn().
+   *
+   * The rows are split into chunks of #chunk_size_ rows. Every chunk
+   * counts into a buffer of its own, so the chunks can be computed in
+   * parallel. The buffers are added in the order of the chunks; so the
+   * result does not depend on the number of threads.
+   */
+  class BayesianNetwork::ExpectationMaximization : public static_visitor<>
+  {
+
+  public:
+
+    /**
+     * @throw NetworkError A row has more than #max_states_ joint values of
+     *     its latent nodes.
+     */
+    ExpectationMaximization(BayesianNetwork& network, unsigned int threads)
+        : parameters_(threads), variables_(), rows_(), fixed_counts_(),
+            fixed_variables_(), counts_()
+    {
+      for (iterator n = network.begin(); n != network.end(); ++n)
+      {
+        apply_visitor(parameters_, *n);
+        apply_visitor(*this, *n);
+      }
+      set_up_rows();
+    }
+
+    void
+    operator()(CategoricalNode& node)
+    {
+      Variable variable =
+      { &node, 0, no_parameter_ };
+      variables_.push_back(variable);
+    }
+
+    void
+    operator()(ConditionalCategoricalNode& node)
+    {
+      Variable variable =
+      { 0, &node, no_parameter_ };
+      variables_.push_back(variable);
+    }
+
+    template<class N>
+      void
+      operator()(N&) const
+      {
+      }
+
+    /**
+     * Computes the expected counts with the current parameters.
+     *
+     * @return the log-likelihood of the evidence given the current
+     *     parameters
+     */
+    double
+    expect()
+    {
+      const std::size_t chunks = (rows_.size() + chunk_size_ - 1)
+          / chunk_size_;
+      const std::size_t fixed_chunks = (fixed_variables_.size() + chunk_size_
+          - 1) / chunk_size_;
+      cont::vector<cont::vector<cont::vector<double> > > chunk_counts(chunks);
+      cont::vector<double> chunk_log_likelihoods(chunks + fixed_chunks, 0.0);
+      parameters_.for_each_index(chunks + fixed_chunks,
+          [this, chunks, &chunk_counts, &chunk_log_likelihoods](size_t c)
+          {
+            if (c >= chunks)
+            {
+              /* The observed rows under the current tables. */
+              const std::size_t begin = (c - chunks) * chunk_size_;
+              const std::size_t end = std::min(fixed_variables_.size(),
+                  begin + chunk_size_);
+              for (std::size_t v = begin; v != end; ++v)
+                chunk_log_likelihoods[c] +=
+                    log(probability(variables_[fixed_variables_[v]]));
+              return;
+            }
+            chunk_counts[c] = zero_counts();
+            const std::size_t end = std::min(rows_.size(), (c + 1) * chunk_size_);
+            for (std::size_t r = c * chunk_size_; r != end; ++r)
+              chunk_log_likelihoods[c] += expect_row(rows_[r], chunk_counts[c]);
+          });
+
+      counts_ = fixed_counts_;
+      double log_likelihood = 0.0;
+      for (std::size_t c = 0; c != chunks + fixed_chunks; ++c)
+        log_likelihood += chunk_log_likelihoods[c];
+      for (std::size_t c = 0; c != chunks; ++c)
+      {
+        for (std::size_t n = 0; n != counts_.size(); ++n)
+        {
+          for (std::size_t i = 0; i != counts_[n].size(); ++i)
+            counts_[n][i] += chunk_counts[c][n][i];
+        }
+      }
+      return log_likelihood;
+    }
+
+    /**
+     * Writes the probabilities from the counts of the last expect().
+     */
+    void
+    maximize() const
+    {
+      parameters_.write(counts_);
+    }
+
+  private:
+
+    /* A categorical node; exactly one of the pointers is set. The index of
+     * its parameter node in parameters_ is no_parameter_ if the parameter
+     * node is not learned. */
+    struct Variable
+    {
+      CategoricalNode* node_;
+      ConditionalCategoricalNode* conditional_node_;
+      std::size_t parameter_;
+    };
+
+    /* The variables of a row and the latent ones among them. */
+    struct Row
+    {
+      cont::vector<std::size_t> variables_;
+      cont::vector<std::size_t> latent_;
+    };
+
+    static const std::size_t chunk_size_ = 256;
+    static const std::size_t max_states_ = 1 << 16;
+    static const std::size_t no_parameter_ = static_cast<std::size_t>(-1);
+
+    LearnParameters parameters_;
+    cont::vector<Variable> variables_;
+    cont::vector<Row> rows_;
+    cont::vector<cont::vector<double> > fixed_counts_;
+    cont::vector<std::size_t> fixed_variables_;
+    cont::vector<cont::vector<double> > counts_;
+
+    void
+    add_count(const Variable& variable, double weight,
+        cont::vector<cont::vector<double> >& counts) const
+    {
+      if (variable.parameter_ == no_parameter_)
+        return;
+
+      if (variable.node_ != 0)
+      {
+        counts[variable.parameter_].at(variable.node_->value().value_index()) +=
+            weight;
+      }
+      else
+      {
+        const std::size_t row_size =
+            parameters_.nodes()[variable.parameter_].row_size_;
+        counts[variable.parameter_].at(
+            variable.conditional_node_->condition().joint_value().value_index()
+                * row_size + variable.conditional_node_->value().value_index()) +=
+            weight;
+      }
+    }
+
+    /* Adds the expected counts of the row and provides its log-likelihood.
+     * The values of the latent nodes are restored in the end. */
+    double
+    expect_row(const Row& row, cont::vector<cont::vector<double> >& counts)
+    {
+      cont::vector<DiscreteRandomVariable> saved_values;
+      cont::vector<DiscreteRandomVariable::Range> ranges;
+      for (auto l = row.latent_.begin(); l != row.latent_.end(); ++l)
+      {
+        DiscreteRandomVariable& value = this->value(variables_[*l]);
+        saved_values.push_back(value);
+        ranges.push_back(value.value_range());
+      }
+
+      /* The first pass computes the joint probabilities of all latent
+       * values, the second pass adds their normalized weights. */
+      cont::vector<double> weights;
+      double total = 0.0;
+      for (bool more = first_state(row, ranges); more;
+          more = next_state(row, ranges))
+      {
+        double weight = 1.0;
+        for (auto v = row.variables_.begin(); v != row.variables_.end(); ++v)
+          weight *= probability(variables_[*v]);
+        weights.push_back(weight);
+        total += weight;
+      }
+      if (total > 0.0)
+      {
+        auto weight = weights.begin();
+        for (bool more = first_state(row, ranges); more;
+            more = next_state(row, ranges), ++weight)
+        {
+          for (auto v = row.variables_.begin(); v != row.variables_.end();
+              ++v)
+            add_count(variables_[*v], *weight / total, counts);
+        }
+      }
+
+      for (std::size_t l = 0; l != row.latent_.size(); ++l)
+        value(variables_[row.latent_[l]]) = saved_values[l];
+      return log(total);
+    }
+
+    bool
+    first_state(const Row& row,
+        const cont::vector<DiscreteRandomVariable::Range>& ranges)
+    {
+      for (std::size_t l = 0; l != row.latent_.size(); ++l)
+        value(variables_[row.latent_[l]]) = ranges[l].begin();
+      return true;
+    }
+
+    /* Counts the latent values up like an odometer. */
+    bool
+    next_state(const Row& row,
+        const cont::vector<DiscreteRandomVariable::Range>& ranges)
+    {
+      for (std::size_t l = 0; l != row.latent_.size(); ++l)
+      {
+        DiscreteRandomVariable& value = this->value(variables_[row.latent_[l]]);
+        ++value;
+        if (value != ranges[l].end())
+          return true;
+        value = ranges[l].begin();
+      }
+      return false;
+    }
+
+    static bool
+    is_evidence(const Variable& variable)
+    {
+      return variable.node_ != 0 ?
+          variable.node_->is_evidence() :
+          variable.conditional_node_->is_evidence();
+    }
+
+    static float
+    probability(const Variable& variable)
+    {
+      return variable.node_ != 0 ?
+          variable.node_->at_references() :
+          variable.conditional_node_->at_references();
+    }
+
+    void
+    set_up_rows()
+    {
+      /* Index the variables and their parameter nodes. */
+      cont::map<const DiscreteNode*, std::size_t> index;
+      for (std::size_t v = 0; v != variables_.size(); ++v)
+        index[&node(variables_[v])] = v;
+      const cont::vector<LearnParameters::Node>& nodes = parameters_.nodes();
+      for (std::size_t n = 0; n != nodes.size(); ++n)
+      {
+        if (nodes[n].node_ != 0)
+        {
+          auto& children = nodes[n].node_->children();
+          for (auto c = children.begin(); c != children.end(); ++c)
+            variables_[index.at(&(*c))].parameter_ = n;
+        }
+        else
+        {
+          auto& children = nodes[n].conditional_node_->children();
+          for (auto c = children.begin(); c != children.end(); ++c)
+            variables_[index.at(&(*c))].parameter_ = n;
+        }
+      }
+
+      /* Find the rows by union-find over the child references. */
+      cont::vector<std::size_t> root(variables_.size());
+      for (std::size_t v = 0; v != root.size(); ++v)
+        root[v] = v;
+      auto find_root = [&root](std::size_t v)
+      {
+        while (root[v] != v)
+        {
+          root[v] = root[root[v]];
+          v = root[v];
+        }
+        return v;
+      };
+      for (std::size_t v = 0; v != variables_.size(); ++v)
+      {
+        const DiscreteNode::Children& children = node(variables_[v]).children();
+        for (auto c = children.begin(); c != children.end(); ++c)
+          root[find_root(index.at(&(*c)))] = find_root(v);
+      }
+      cont::map<std::size_t, Row> rows;
+      for (std::size_t v = 0; v != variables_.size(); ++v)
+      {
+        Row& row = rows[find_root(v)];
+        row.variables_.push_back(v);
+        if (!is_evidence(variables_[v]))
+          row.latent_.push_back(v);
+      }
+
+      /* Count the rows without latent nodes once; their variables are kept
+       * for the log-likelihood. */
+      fixed_counts_ = zero_counts();
+      for (auto r = rows.begin(); r != rows.end(); ++r)
+      {
+        const Row& row = r->second;
+        if (!row.latent_.empty())
+        {
+          std::size_t states = 1;
+          for (auto l = row.latent_.begin(); l != row.latent_.end(); ++l)
+          {
+            states *= value(variables_[*l]).value_range().size();
+            if (states > max_states_)
+              cpprob_throw_network_error(
+                  "BayesianNetwork: Cannot learn by expectation maximization with more than " << max_states_ << " joint values of the latent nodes in a row (node " << value(variables_[*l]).name() << ").");
+          }
+          rows_.push_back(row);
+          continue;
+        }
+        for (auto v = row.variables_.begin(); v != row.variables_.end(); ++v)
+        {
+          add_count(variables_[*v], 1.0, fixed_counts_);
+          fixed_variables_.push_back(*v);
+        }
+      }
+    }
+
+    static DiscreteNode&
+    node(const Variable& variable)
+    {
+      if (variable.node_ != 0)
+        return *variable.node_;
+      else
+        return *variable.conditional_node_;
+    }
+
+    static DiscreteRandomVariable&
+    value(const Variable& variable)
+    {
+      return node(variable).value();
+    }
+
+    cont::vector<cont::vector<double> >
+    zero_counts() const
+    {
+      const cont::vector<LearnParameters::Node>& nodes = parameters_.nodes();
+      cont::vector<cont::vector<double> > counts(nodes.size());
+      for (std::size_t n = 0; n != nodes.size(); ++n)
+        counts[n].assign(nodes[n].rows_ * nodes[n].row_size_, 0.0);
+      return counts;
+    }
+
+  };
+
+  /**
+   * The nodes that a Gibbs sweep samples, compiled once for the sweeps of
+   * a #sample() call. The nodes are kept in one array per node type, and
+   * the sweep runs through runs of nodes of the same type in the order of
+   * the network. So the order of the updates, and with it the stream of
+   * random numbers, is the same as with the SampleNode visitor, but the
+   * sweep does no variant dispatch per node. Evidence nodes and constant
+   * nodes are left out when the plan is built.
+   *
+   * The plan must be rebuilt when nodes are added or erased or when the
+   * evidence changes.
+   */
+  class BayesianNetwork::SweepPlan : public static_visitor<>
+  {
+
+  public:
+
+    explicit
+    SweepPlan(BayesianNetwork& network)
+        : categorical_nodes_(), conditional_categorical_nodes_(),
+            conditional_dirichlet_nodes_(), dirichlet_nodes_(),
+            dirichlet_process_nodes_(), dirichlet_process_parameters_nodes_(),
+            plate_nodes_(), runs_()
+    {
+      for (auto n = network.begin(); n != network.end(); ++n)
+        apply_visitor(*this, *n);
+    }
+
+    void
+    operator()(CategoricalNode& node)
+    {
+      add_if_latent(node, categorical_nodes_, categorical_run);
+    }
+
     void
-    operator()(ConditionalDirichletNode& node) const
+    operator()(ConditionalCategoricalNode& node)
     {
-      if (node.is_evidence())
-        return;
+      add_if_latent(node, conditional_categorical_nodes_,
+          conditional_categorical_run);
+    }
 
-      /* Check requirements */
-      cpprob_check_debug(
-          node.children().begin() != node.children().end(),
-          "BayesianNetwork: Cannot learn the conditional Dirichlet node without children (node name: " + node.value().name() + ").");
+    void
+    operator()(ConditionalDirichletNode& node)
+    {
+      add_if_latent(node, conditional_dirichlet_nodes_,
+          conditional_dirichlet_run);
+    }
 
-      /* Clear the target variable. I use it for counters and normalize it
-       * in the end. */
-      RandomConditionalProbabilities& probabilities = node.value();
-      probabilities.clear();
+    /* The parameters run the moves of the Dirichlet process; see
+     * SampleNode. */
+    void
+    operator()(ConstantDirichletProcessParametersNode& node)
+    {
+      add(node, dirichlet_process_parameters_nodes_,
+          dirichlet_process_parameters_run);
+    }
 
-      /* Initialize the counters with the values of the Dirichlet prior
-       * distribution. If the prior values are zero, the remaining algorithm
-       * performs just maximum likelihood learning. I need the range of the
-       * condition variable first to set up the table of the counters. The
-       * parameter set of the Dirichlet prior contains only one Dirichlet
-       * distribution that is equal for all condition values. */
-      DiscreteRandomVariable::Range condition_range =
-          node.children().begin()->condition().joint_value().value_range();
-      for (auto condition = condition_range.begin();
-          condition != condition_range.end(); ++condition)
+    template<class V, class C>
+      void
+      operator()(ConstantNode<V, C>&)
       {
-        RandomProbabilities& prob_set = probabilities[condition];
-        copy(node.parameters().begin(), node.parameters().end(),
-            inserter(prob_set, prob_set.begin()));
       }
 
-      /* Add the likelihood to the counters. */
-      auto& children = node.children();
-      for (auto child = children.begin(); child != children.end(); ++child)
-      {
-        if (child->is_evidence())
-        {
-          DiscreteRandomVariable& child_value = child->value();
-          DiscreteRandomVariable child_condition =
-              child->condition().joint_value();
-          probabilities[child_condition][child_value] += 1.0;
-        }
-      }
+    void
+    operator()(DirichletNode& node)
+    {
+      add_if_latent(node, dirichlet_nodes_, dirichlet_run);
+    }
 
-      /* Normalize the counters to probabilities. */
-      probabilities.normalize();
+    void
+    operator()(DirichletProcessNode& node)
+    {
+      add_if_latent(node, dirichlet_process_nodes_, dirichlet_process_run);
     }
 
-    /**
-     * Learns a parameter of type RandomProbabilities that is Dirichlet
-     * distributed. So this method learns the maximum a posteriori probabilities
-     * given the data and the Dirichlet prior. To get the maximum likelihood
-     * probabilities, just set the Dirichlet parameters to 0.
-     *
-     * @param node the parameter node to learn
-     * @throw Any #learn() catches all exceptions and maps them appropriately
-     *     for its interface.
-     */
     void
-    operator()(DirichletNode& node) const
+    operator()(PlateNode& node)
     {
-      if (node.is_evidence())
-        return;
+      add_if_latent(node, plate_nodes_, plate_run);
+    }
 
-      /* Clear the target variable. I use it for counters and normalize it
-       * in the end. */
-      RandomProbabilities& probabilities = node.value();
-      probabilities.clear();
+    /* One Gibbs sweep */
+    void
+    sweep(RandomNumberEngine& rne) const
+    {
+      for (auto run = runs_.begin(); run != runs_.end(); ++run)
+      {
+        switch (run->type_)
+        {
+        case categorical_run:
+          sample(categorical_nodes_, *run, rne);
+          break;
+        case conditional_categorical_run:
+          sample(conditional_categorical_nodes_, *run, rne);
+          break;
+        case conditional_dirichlet_run:
+          sample(conditional_dirichlet_nodes_, *run, rne);
+          break;
+        case dirichlet_run:
+          sample(dirichlet_nodes_, *run, rne);
+          break;
+        case dirichlet_process_run:
+          sample(dirichlet_process_nodes_, *run, rne);
+          break;
+        case dirichlet_process_parameters_run:
+          for (size_t n = run->begin_; n != run->end_; ++n)
+          {
+            ConstantDirichletProcessParametersNode& node =
+                *dirichlet_process_parameters_nodes_[n];
+            node.value().sample(node.children(), rne);
+          }
+          break;
+        case plate_run:
+          sample(plate_nodes_, *run, rne);
+          break;
+        }
+      }
+    }
 
-      /* Initialize the counters with the parameter values of the Dirichlet
-       * prior values. Without this pre-initialization, the remaining
-       * algorithm performs just maximum likelihood learning. */
-      copy(node.parameters().begin(), node.parameters().end(),
-          inserter(probabilities, probabilities.begin()));
+  private:
 
-      /* Add the likelihood to the counters. */
-      auto& children = node.children();
-      for (auto child = children.begin(); child != children.end(); ++child)
+    enum RunType
+    {
+      categorical_run, conditional_categorical_run, conditional_dirichlet_run,
+      dirichlet_run, dirichlet_process_run, dirichlet_process_parameters_run,
+      plate_run
+    };
+
+    /* Consecutive nodes of one type: the indices begin_ to end_ - 1 in the
+     * array of the type. */
+    struct Run
+    {
+      RunType type_;
+      size_t begin_;
+      size_t end_;
+    };
+
+    cont::vector<CategoricalNode*> categorical_nodes_;
+    cont::vector<ConditionalCategoricalNode*> conditional_categorical_nodes_;
+    cont::vector<ConditionalDirichletNode*> conditional_dirichlet_nodes_;
+    cont::vector<DirichletNode*> dirichlet_nodes_;
+    cont::vector<DirichletProcessNode*> dirichlet_process_nodes_;
+    cont::vector<ConstantDirichletProcessParametersNode*> dirichlet_process_parameters_nodes_;
+    cont::vector<PlateNode*> plate_nodes_;
+    cont::vector<Run> runs_;
+
+    template<class N>
+      void
+      add(N& node, cont::vector<N*>& nodes, RunType type)
       {
-        if (child->is_evidence())
-          probabilities[child->value()] += 1.0;
+        if (runs_.empty() || runs_.back().type_ != type)
+        {
+          Run run =
+          { type, nodes.size(), nodes.size() };
+          runs_.push_back(run);
+        }
+        nodes.push_back(&node);
+        ++runs_.back().end_;
       }
 
-      /* Normalize the counters to probabilities. */
-      probabilities.normalize();
-    }
-
     template<class N>
       void
-      operator()(N&) const
+      add_if_latent(N& node, cont::vector<N*>& nodes, RunType type)
+      {
+        if (!node.is_evidence())
+          add(node, nodes, type);
+      }
+
+    template<class N>
+      static void
+      sample(const cont::vector<N*>& nodes, const Run& run,
+          RandomNumberEngine& rne)
       {
+        N* const * n = &nodes[run.begin_];
+        N* const * const end = n + (run.end_ - run.begin_);
+        for (; n != end; ++n)
+          (*n)->sample(rne);
       }
 
   };
@@ -343,15 +1527,17 @@ namespace cpprob
   }
 
   BayesianNetwork::BayesianNetwork()
-      : vertices_()
+      : vertices_(), names_(), addresses_(), is_overlay_(false)
   {
   }
 
   BayesianNetwork::BayesianNetwork(const BayesianNetwork& other_hbn)
-      : vertices_()
+      : vertices_(), names_(), addresses_(), is_overlay_(other_hbn.is_overlay_)
   {
+    reserve(other_hbn.size());
     for_each(other_hbn.begin(), other_hbn.end(),
-        make_apply_visitor_delayed(CopyNode(*this)));
+        make_apply_visitor_delayed(
+            CopyNode(*this, other_hbn.size(), is_overlay_)));
   }
 
   CategoricalNode&
@@ -380,15 +1566,14 @@ namespace cpprob
   BayesianNetwork::add_conditional_dirichlet(
       const RandomConditionalProbabilities& value, float alpha)
   {
-    iterator new_node = vertices_.insert(end(),
-        ConditionalDirichletNode(value, alpha));
+    iterator new_node = insert_vertex(ConditionalDirichletNode(value, alpha));
     return get<ConditionalDirichletNode>(*new_node);
   }
 
   ConstantDirichletProcessParametersNode&
   BayesianNetwork::add_constant(const DirichletProcessParameters& value)
   {
-    iterator new_node = vertices_.insert(end(),
+    iterator new_node = insert_vertex(
         ConstantDirichletProcessParametersNode(value));
     return boost::get<ConstantDirichletProcessParametersNode>(*new_node);
   }
@@ -396,7 +1581,7 @@ namespace cpprob
   ConstantDiscreteRandomVariableNode&
   BayesianNetwork::add_constant(const DiscreteRandomVariable& value)
   {
-    iterator new_node = vertices_.insert(end(),
+    iterator new_node = insert_vertex(
         ConstantDiscreteRandomVariableNode(value));
     return boost::get<ConstantDiscreteRandomVariableNode>(*new_node);
   }
@@ -404,7 +1589,7 @@ namespace cpprob
   ConstantRandomConditionalProbabilitiesNode&
   BayesianNetwork::add_constant(const RandomConditionalProbabilities& value)
   {
-    iterator new_node = vertices_.insert(end(),
+    iterator new_node = insert_vertex(
         ConstantRandomConditionalProbabilitiesNode(value));
     return boost::get<ConstantRandomConditionalProbabilitiesNode>(*new_node);
   }
@@ -412,15 +1597,14 @@ namespace cpprob
   ConstantRandomProbabilitiesNode&
   BayesianNetwork::add_constant(const RandomProbabilities& value)
   {
-    iterator new_node = vertices_.insert(end(),
-        ConstantRandomProbabilitiesNode(value));
+    iterator new_node = insert_vertex(ConstantRandomProbabilitiesNode(value));
     return boost::get<ConstantRandomProbabilitiesNode>(*new_node);
   }
 
   DirichletNode&
   BayesianNetwork::add_dirichlet(const RandomProbabilities& value, float alpha)
   {
-    iterator new_node = vertices_.insert(end(), DirichletNode(value, alpha));
+    iterator new_node = insert_vertex(DirichletNode(value, alpha));
     return get<DirichletNode>(*new_node);
   }
 
@@ -428,7 +1612,7 @@ namespace cpprob
   BayesianNetwork::add_dirichlet_process(
       ConstantDirichletProcessParametersNode& parent)
   {
-    iterator new_node_it = vertices_.insert(end(),
+    iterator new_node_it = insert_vertex(
         DirichletProcessNode(parent.value()));
     DirichletProcessNode& new_node = get<DirichletProcessNode>(*new_node_it);
     parent.children().push_back(new_node);
@@ -441,14 +1625,219 @@ namespace cpprob
       float concentration,
       const std::initializer_list<ConditionalDirichletNode*>& managed_nodes)
   {
-    iterator new_node = vertices_.insert(
-        end(),
+    iterator new_node = insert_vertex(
         ConstantDirichletProcessParametersNode(
             DirichletProcessParameters(name, concentration, managed_nodes)));
     return boost::get<ConstantDirichletProcessParametersNode>(*new_node);
   }
 #endif
 
+  PlateNode&
+  BayesianNetwork::add_plate(const PlateTemplate& template_nodes,
+      const EvidenceTable& evidence_table)
+  {
+    iterator new_node_it = insert_vertex(
+        PlateNode(template_nodes, evidence_table));
+    PlateNode& new_node = get<PlateNode>(*new_node_it);
+
+    const PlateTemplate::Nodes& nodes = template_nodes.nodes();
+    for (auto n = nodes.begin(); n != nodes.end(); ++n)
+    {
+      if (DirichletNode* const * dirichlet = get<DirichletNode*>(
+          &n->parameter_node_))
+        (*dirichlet)->plates().push_back(new_node);
+      else if (ConditionalDirichletNode* const * conditional_dirichlet = get<
+          ConditionalDirichletNode*>(&n->parameter_node_))
+        (*conditional_dirichlet)->plates().push_back(new_node);
+    }
+    return new_node;
+  }
+
+  CategoricalDistribution
+  BayesianNetwork::eliminate(const DiscreteNode& X,
+      EliminationOrdering ordering)
+  {
+    /* The free variables are the values of the non-evidence categorical
+     * nodes and the query variable. Save their values to restore them in
+     * the end. */
+    DiscreteFactor::Variables free_variables;
+    DiscreteRandomVariable* x = 0;
+    for (auto n = begin(); n != end(); ++n)
+    {
+      DiscreteRandomVariable* var = apply_visitor(DiscreteValueOfNode(), *n);
+      if (var == &X.value())
+        x = var;
+      if (var != 0 && (var == x || !apply_visitor(NodeIsEvidence(), *n)))
+        free_variables.push_back(var);
+    }
+    if (x == 0)
+      cpprob_throw_invalid_argument(
+          "BayesianNetwork: Cannot eliminate for the node " //
+          << X.value().name() << ", which is not part of the network.");
+
+    cont::vector<DiscreteRandomVariable> saved_values;
+    for (auto v = free_variables.begin(); v != free_variables.end(); ++v)
+      saved_values.push_back(**v);
+    auto restore_values = [&free_variables, &saved_values]()
+    {
+      for (size_t i = 0; i != free_variables.size(); ++i)
+        *free_variables[i] = saved_values[i];
+    };
+
+    CategoricalDistribution X_distribution;
+
+    try
+    {
+      cont::list<DiscreteFactor> factors;
+      for_each(begin(), end(),
+          make_apply_visitor_delayed(CollectFactors(free_variables, factors)));
+
+      const DiscreteFactor::Variables order = elimination_order(factors,
+          free_variables, x, ordering);
+
+      for (auto v = order.begin(); v != order.end(); ++v)
+      {
+        DiscreteFactor product;
+        for (auto f = factors.begin(); f != factors.end();)
+        {
+          if (f->contains(*v))
+          {
+            product = product.product(*f);
+            f = factors.erase(f);
+          }
+          else
+          {
+            ++f;
+          }
+        }
+        factors.push_back(product.sum_out(*v));
+      }
+
+      DiscreteFactor x_factor;
+      for (auto f = factors.begin(); f != factors.end(); ++f)
+        x_factor = x_factor.product(*f);
+
+      DiscreteRandomVariable::Range X_range = x->value_range();
+      for (*x = X_range.begin(); *x != X_range.end(); ++(*x))
+        X_distribution[*x] = x_factor[x_factor.index_of_current_values()];
+
+      X_distribution.normalize();
+    }
+    catch (const NetworkError&)
+    {
+      restore_values();
+      throw;
+    }
+    catch (const std::bad_alloc&)
+    {
+      restore_values();
+      throw;
+    }
+    catch (const std::exception& e)
+    {
+      restore_values();
+      cpprob_throw_network_error(
+          "BayesianNetwork: Could not eliminate the network. " //
+          << e.what());
+    }
+
+    restore_values();
+    return X_distribution;
+  }
+
+  DiscreteFactor::Variables
+  BayesianNetwork::elimination_order(const cont::list<DiscreteFactor>& factors,
+      const DiscreteFactor::Variables& free_variables,
+      const DiscreteRandomVariable* query_variable,
+      EliminationOrdering ordering,
+      cont::vector<DiscreteFactor::Variables>* cliques)
+  {
+    /* Set up the interaction graph. The vertices are the indices of the
+     * free variables. Two vertices are adjacent if their variables share
+     * a factor. */
+    typedef cont::set<size_t> Neighbours;
+    const size_t variable_count = free_variables.size();
+    cont::vector<Neighbours> graph(variable_count);
+    cont::vector<bool> eliminated(variable_count, false);
+
+    for (auto f = factors.begin(); f != factors.end(); ++f)
+    {
+      cont::vector<size_t> indices;
+      for (auto v = f->variables().begin(); v != f->variables().end(); ++v)
+        indices.push_back(
+            std::find(free_variables.begin(), free_variables.end(), *v)
+                - free_variables.begin());
+      for (auto i = indices.begin(); i != indices.end(); ++i)
+        for (auto j = indices.begin(); j != indices.end(); ++j)
+          if (*i != *j)
+            graph[*i].insert(*j);
+    }
+
+    size_t elimination_count = variable_count;
+    for (size_t i = 0; i != variable_count; ++i)
+    {
+      if (free_variables[i] == query_variable)
+      {
+        eliminated[i] = true;
+        --elimination_count;
+      }
+    }
+
+    /* Pick greedily the cheapest variable, connect its neighbours and
+     * remove it from the graph. Ties are broken by the network order. */
+    DiscreteFactor::Variables order;
+    while (order.size() < elimination_count)
+    {
+      size_t best = variable_count;
+      size_t best_cost = 0;
+
+      for (size_t i = 0; i != variable_count; ++i)
+      {
+        if (eliminated[i])
+          continue;
+
+        size_t cost = 0;
+        if (ordering == min_degree_ordering)
+        {
+          cost = graph[i].size();
+        }
+        else
+        {
+          for (auto n1 = graph[i].begin(); n1 != graph[i].end(); ++n1)
+            for (auto n2 = n1; n2 != graph[i].end(); ++n2)
+              if (n1 != n2 && graph[*n1].count(*n2) == 0)
+                ++cost;
+        }
+
+        if (best == variable_count || cost < best_cost)
+        {
+          best = i;
+          best_cost = cost;
+        }
+      }
+
+      if (cliques)
+      {
+        cliques->push_back(DiscreteFactor::Variables(1, free_variables[best]));
+        for (auto n = graph[best].begin(); n != graph[best].end(); ++n)
+          cliques->back().push_back(free_variables[*n]);
+      }
+
+      for (auto n1 = graph[best].begin(); n1 != graph[best].end(); ++n1)
+      {
+        for (auto n2 = graph[best].begin(); n2 != graph[best].end(); ++n2)
+          if (*n1 != *n2)
+            graph[*n1].insert(*n2);
+        graph[*n1].erase(best);
+      }
+      graph[best].clear();
+      eliminated[best] = true;
+      order.push_back(free_variables[best]);
+    }
+
+    return order;
+  }
+
   CategoricalDistribution
   BayesianNetwork::enumerate(CategoricalNode& X_v)
   {
@@ -493,21 +1882,20 @@ namespace cpprob
     return X_distribution;
   }
 
-  float
+  double
   BayesianNetwork::enumerate_all(iterator current, iterator end)
   {
     if (current == end)
-      return 1.0;
+      return 0.0;
 
-    float conditional_probability = 0.0;
     ProbabilityOfNode probability_visitor;
     iterator next = current;
     ++next;
 
     if (apply_visitor(NodeIsEvidence(), *current))
     {
-      conditional_probability = apply_visitor(probability_visitor, *current);
-      return conditional_probability * enumerate_all(next, end);
+      return log(apply_visitor(probability_visitor, *current))
+          + enumerate_all(next, end);
     }
     else
     {
@@ -516,15 +1904,26 @@ namespace cpprob
       if (x == 0)
         return enumerate_all(next, end);
 
+      /* Sum the probabilities of the values by log-sum-exp. */
       DiscreteRandomVariable::Range X_range = x->value_range();
-      double probability_sum = 0.0;
-
+      cont::vector<double> log_probabilities;
+      double max_log_probability = -numeric_limits<double>::infinity();
       for (*x = X_range.begin(); *x != X_range.end(); ++(*x))
       {
-        conditional_probability = apply_visitor(probability_visitor, *current);
-        probability_sum += conditional_probability * enumerate_all(next, end);
+        const double log_probability = log(
+            apply_visitor(probability_visitor, *current))
+            + enumerate_all(next, end);
+        log_probabilities.push_back(log_probability);
+        max_log_probability = std::max(max_log_probability, log_probability);
       }
-      return static_cast<float>(probability_sum);
+      if (max_log_probability == -numeric_limits<double>::infinity())
+        return max_log_probability;
+
+      double probability_sum = 0.0;
+      for (auto l = log_probabilities.begin(); l != log_probabilities.end();
+          ++l)
+        probability_sum += exp(*l - max_log_probability);
+      return max_log_probability + log(probability_sum);
     }
   }
 
@@ -538,8 +1937,23 @@ namespace cpprob
     {
       DiscreteRandomVariable::Range X_range = x.value_range();
 
+      /* Leave the log domain only after scaling the largest probability to
+       * 1. So the distribution can be normalized even if the joint
+       * probabilities of the whole network underflow. */
+      cont::vector<double> log_probabilities;
+      double max_log_probability = -numeric_limits<double>::infinity();
       for (x = X_range.begin(); x != X_range.end(); ++x)
-        X_distribution[x] = enumerate_all(begin(), end());
+      {
+        log_probabilities.push_back(enumerate_all(begin(), end()));
+        max_log_probability = std::max(max_log_probability,
+            log_probabilities.back());
+      }
+      if (max_log_probability == -numeric_limits<double>::infinity())
+        max_log_probability = 0.0;
+
+      auto l = log_probabilities.begin();
+      for (x = X_range.begin(); x != X_range.end(); ++x, ++l)
+        X_distribution[x] = static_cast<float>(exp(*l - max_log_probability));
 
       X_distribution.normalize();
     }
@@ -559,12 +1973,96 @@ namespace cpprob
     }
   }
 
+  std::size_t
+  BayesianNetwork::erase(iterator first, iterator last)
+  {
+    cont::vector<iterator> vertices;
+    for (; first != last; ++first)
+      vertices.push_back(first);
+    return erase_vertices(vertices);
+  }
+
+  BayesianNetwork::iterator
+  BayesianNetwork::erase_vertex(iterator vertex)
+  {
+    const pair<const void*, const void*> keys = apply_visitor(NodeAddresses(),
+        *vertex);
+    addresses_.erase(keys.first);
+    auto value_entry = addresses_.find(keys.second);
+    if (value_entry != addresses_.end() && value_entry->second == vertex)
+      addresses_.erase(value_entry);
+
+    const std::string& name = apply_visitor(NameOfNode(), *vertex);
+    auto entry = names_.find(name);
+    if (entry == names_.end() || entry->second != vertex)
+      return vertices_.erase(vertex);
+
+    /* The next node of the same name takes the place in the index. */
+    auto same_name = find_if(std::next(vertex), end(),
+        make_delayed_compare_node_name(name));
+    if (same_name == end())
+      names_.erase(entry);
+    else
+      entry->second = same_name;
+    return vertices_.erase(vertex);
+  }
+
+  std::size_t
+  BayesianNetwork::erase_vertices(const cont::vector<iterator>& vertices)
+  {
+    cont::vector<const void*> erased;
+    erased.reserve(vertices.size());
+    for (auto v = vertices.begin(); v != vertices.end(); ++v)
+      erased.push_back(apply_visitor(NodeAddresses(), **v).first);
+    sort(erased.begin(), erased.end());
+
+    /* Check all nodes before the first one is erased. */
+    cont::vector<const void*> parent_addresses;
+    for (auto v = vertices.begin(); v != vertices.end(); ++v)
+    {
+      if (apply_visitor(HasDependents(erased), **v))
+        cpprob_throw_invalid_argument(
+            "BayesianNetwork: Cannot erase a node with children (node " << apply_visitor(NameOfNode(), **v) << ").");
+      apply_visitor(ParentsOfNode(parent_addresses), **v);
+    }
+
+    /* Every parent drops its references to all erased nodes in one pass. A
+     * parent outside the network is not touched. */
+    cont::vector<Node*> parents;
+    parents.reserve(parent_addresses.size());
+    for (auto p = parent_addresses.begin(); p != parent_addresses.end(); ++p)
+    {
+      auto parent = addresses_.find(*p);
+      if (parent != addresses_.end())
+        parents.push_back(&*parent->second);
+    }
+    sort(parents.begin(), parents.end());
+    parents.erase(unique(parents.begin(), parents.end()), parents.end());
+    EraseReferences erase_references(erased);
+    for (auto p = parents.begin(); p != parents.end(); ++p)
+      apply_visitor(erase_references, **p);
+
+    for (auto v = vertices.begin(); v != vertices.end(); ++v)
+      erase_vertex(*v);
+    return vertices.size();
+  }
+
+  BayesianNetwork
+  BayesianNetwork::overlay() const
+  {
+    BayesianNetwork new_network;
+    new_network.is_overlay_ = true;
+    new_network.reserve(size());
+    for_each(begin(), end(),
+        make_apply_visitor_delayed(CopyNode(new_network, size(), true)));
+    return new_network;
+  }
+
   CategoricalNode&
   BayesianNetwork::insert_categorical(const DiscreteRandomVariable& value,
       RandomProbabilities& parameters)
   {
-    iterator new_node = vertices_.insert(end(),
-        CategoricalNode(value, parameters));
+    iterator new_node = insert_vertex(CategoricalNode(value, parameters));
     return get<CategoricalNode>(*new_node);
   }
 
@@ -574,15 +2072,77 @@ namespace cpprob
       const DiscreteRandomReferences& condition,
       RandomConditionalProbabilities& parameters)
   {
-    iterator new_node = vertices_.insert(end(),
+    iterator new_node = insert_vertex(
         ConditionalCategoricalNode(value, condition, parameters));
     return get<ConditionalCategoricalNode>(*new_node);
   }
 
+  BayesianNetwork::Node*
+  BayesianNetwork::find_vertex(const std::string& name) const
+  {
+    auto entry = names_.find(name);
+    return entry == names_.end() ? 0 : &*entry->second;
+  }
+
+  BayesianNetwork::iterator
+  BayesianNetwork::insert_vertex(const Node& node)
+  {
+    iterator new_node = vertices_.insert(end(), node);
+    // An older node of the same name stays in the index.
+    names_.insert(make_pair(apply_visitor(NameOfNode(), *new_node), new_node));
+    const pair<const void*, const void*> keys = apply_visitor(NodeAddresses(),
+        *new_node);
+    addresses_[keys.first] = new_node;
+    addresses_.insert(make_pair(keys.second, new_node));
+    return new_node;
+  }
+
   void
   BayesianNetwork::learn()
   {
-    for_each(begin(), end(), make_apply_visitor_delayed(LearnParameters()));
+    learn(1);
+  }
+
+  void
+  BayesianNetwork::learn(unsigned int threads)
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+    LearnParameters learn_parameters(threads);
+    for (iterator n = begin(); n != end(); ++n)
+      apply_visitor(learn_parameters, *n);
+    learn_parameters.run();
+  }
+
+  double
+  BayesianNetwork::learn_em(unsigned int max_iterations, float tolerance,
+      unsigned int* iterations, unsigned int threads)
+  {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+
+    ExpectationMaximization em(*this, threads);
+    double log_likelihood = -numeric_limits<double>::infinity();
+    unsigned int i = 0;
+    while (i != max_iterations)
+    {
+      const double new_log_likelihood = em.expect();
+      em.maximize();
+      ++i;
+      /* An evidence of probability 0 has the log-likelihood -inf; the
+       * difference of two of them is NaN, so they are compared first. */
+      const bool is_converged = i > 1
+          && (new_log_likelihood == log_likelihood
+              || abs(new_log_likelihood - log_likelihood) <= tolerance);
+      log_likelihood = new_log_likelihood;
+      if (is_converged)
+        break;
+    }
+
+    if (iterations != 0)
+      *iterations = i;
+    return log_likelihood;
   }
 
   template<class It>
@@ -604,7 +2164,8 @@ namespace cpprob
 
   CategoricalDistribution
   BayesianNetwork::sample(const DiscreteNode& X,
-      unsigned int burn_in_iterations, unsigned int collect_iterations)
+      unsigned int burn_in_iterations, unsigned int collect_iterations,
+      RandomNumberEngine& rne)
   {
     const DiscreteRandomVariable& x = X.value();
     CategoricalDistribution X_distribution;
@@ -612,20 +2173,19 @@ namespace cpprob
         x_value != x.value_range().end(); ++x_value)
       X_distribution[x_value] = 0.0;
 
-    for_each(begin(), end(), make_apply_visitor_delayed(InitSamplingOfNode()));
+    for_each(begin(), end(),
+        make_apply_visitor_delayed(InitSamplingOfNode(rne)));
 
+    const SweepPlan sweep_plan(*this);
     for (unsigned int iteration = 0; iteration < burn_in_iterations;
         iteration++)
-      for_each(begin(), end(), make_apply_visitor_delayed(SampleNode()));
+      sweep_plan.sweep(rne);
 
     // Sample the distribution
     for (unsigned int iteration = 0; iteration < collect_iterations;
         iteration++)
     {
-      SampleNode sample_visitor;
-      for (iterator vertex_it = begin(); vertex_it != end(); ++vertex_it)
-        apply_visitor(sample_visitor, *vertex_it);
-
+      sweep_plan.sweep(rne);
       X_distribution[x] += 1.0f;
     }
 
@@ -633,63 +2193,264 @@ namespace cpprob
     return X_distribution;
   }
 
+  std::size_t
+  BayesianNetwork::position_of(const DiscreteNode& X)
+  {
+    std::size_t position = 0;
+    for (auto n = begin(); n != end(); ++n, ++position)
+    {
+      if (apply_visitor(DiscreteNodeOfNode(), *n) == &X)
+        return position;
+    }
+    cpprob_throw_invalid_argument(
+        "BayesianNetwork: Cannot sample the node " << X.value().name() << ", which is not part of the network.");
+  }
+
+  CategoricalDistribution
+  BayesianNetwork::sample(const DiscreteNode& X,
+      unsigned int burn_in_iterations, unsigned int collect_iterations,
+      unsigned int chains, unsigned int threads)
+  {
+    if (chains == 0)
+      cpprob_throw_invalid_argument(
+          "BayesianNetwork: Cannot sample with 0 chains.");
+    for (auto n = begin(); n != end(); ++n)
+    {
+      if (const ConstantDirichletProcessParametersNode* parameters_node = get<
+          ConstantDirichletProcessParametersNode>(&*n))
+        cpprob_throw_network_error(
+            "BayesianNetwork: Cannot sample several chains of a network with "
+            "the Dirichlet process " << parameters_node->value().name()
+            << ". The copies would share the size of its component variable.");
+    }
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, chains);
+
+    const size_t x_position = position_of(X);
+
+    /* Seed the engines of the chains and copy the networks in the calling
+     * thread. The seeds depend only on the global engine, not on the
+     * scheduling of the chains. */
+    cont::vector<RandomNumberEngine> engines(chains);
+    cont::list<BayesianNetwork> networks;
+    cont::vector<BayesianNetwork*> chain_networks;
+    cont::vector<DiscreteNode*> query_nodes;
+    for (unsigned int c = 0; c != chains; ++c)
+    {
+      engines[c].seed(random_number_engine());
+      networks.push_back(*this);
+      chain_networks.push_back(&networks.back());
+      auto n = networks.back().begin();
+      advance(n, x_position);
+      query_nodes.push_back(apply_visitor(DiscreteNodeOfNode(), *n));
+    }
+
+    /* Thread t runs the chains t, t + threads, t + 2 * threads etc. */
+    cont::vector<CategoricalDistribution> chain_distributions(chains);
+    cont::vector<exception_ptr> errors(threads);
+
+    auto run_chains =
+        [&](unsigned int t)
+        {
+          try
+          {
+            for (unsigned int c = t; c < chains; c += threads)
+              chain_distributions[c] = chain_networks[c]->sample(*query_nodes[c],
+                  burn_in_iterations, collect_iterations, engines[c]);
+          }
+          catch (...)
+          {
+            errors[t] = current_exception();
+          }
+        };
+
+    cont::vector<std::thread> workers;
+    for (unsigned int t = 0; t != threads; ++t)
+      workers.push_back(std::thread(run_chains, t));
+    for (auto w = workers.begin(); w != workers.end(); ++w)
+      w->join();
+
+    for (auto e = errors.begin(); e != errors.end(); ++e)
+    {
+      if (*e)
+        rethrow_exception(*e);
+    }
+
+    return mix_distributions_additively(chain_distributions.begin(),
+        chain_distributions.end());
+  }
+
   /*
-   * Run several partial samplings. Then divide the list of partial samplings
-   * in three blocks and compare the combined samplings result between the
-   * three blocks. If the maximum deviation in one of the probabilities is
-   * higher than max_deviation, proceed sampling. Only if all three
-   * distribution are very similiar (deviation < max_deviation), all partial
-   * samplings are combined to one result, which is returned.
+   * Run a few chains in rounds; a round runs a block of 500 iterations on
+   * every chain. Then divide the list of rounds in three parts and compare
+   * the distributions of the three parts. If the maximum deviation in one of
+   * the probabilities is higher than max_deviation, proceed sampling. Only if
+   * all three distributions are very similar (deviation < max_deviation), the
+   * counts of all blocks are combined to one result, which is returned.
+   *
+   * Every chain is initialized once and then kept running. A single warm
+   * chain does not switch between the symmetric modes of a latent variable,
+   * but the chains start in different modes. The first chain runs on the
+   * network itself, the others on copies.
+   * A Dirichlet process grows its component variable, which the copies would
+   * share (see DiscreteRandomVariable); so such a network runs one chain.
+   *
+   * The counts of the blocks are accumulated in a table of running sums: row
+   * k holds the counts of the first k blocks. So the counts of every part are
+   * the difference of two rows, and the check does not depend on the number
+   * of blocks.
    */
   CategoricalDistribution
   BayesianNetwork::sample(const DiscreteNode& X, float max_deviation,
       unsigned int* iterations)
   {
-    static const unsigned int partial_iterations = 500;
-    vector<CategoricalDistribution> partial_distributions;
-    float overall_deviation = 0.0f;
-    float single_deviation = 1.0f;
+    static const unsigned int block_iterations = 500;
+    static const unsigned int max_chains = 8;
+    const size_t x_position = position_of(X);
+    const DiscreteRandomVariable& x = X.value();
+
+    unsigned int chains = max_chains;
+    for (auto n = begin(); n != end(); ++n)
+    {
+      if (get<ConstantDirichletProcessParametersNode>(&*n) != 0)
+        chains = 1;
+    }
+    cont::list<BayesianNetwork> networks;
+    cont::vector<const DiscreteRandomVariable*> chain_values(1, &x);
+    cont::list<SweepPlan> sweep_plans;
+    for (unsigned int c = 1; c != chains; ++c)
+    {
+      networks.push_back(*this);
+      auto n = networks.back().begin();
+      advance(n, x_position);
+      chain_values.push_back(&apply_visitor(DiscreteNodeOfNode(), *n)->value());
+    }
+    for_each(begin(), end(), make_apply_visitor_delayed(InitSamplingOfNode()));
+    sweep_plans.push_back(SweepPlan(*this));
+    for (auto n = networks.begin(); n != networks.end(); ++n)
+    {
+      for_each(n->begin(), n->end(),
+          make_apply_visitor_delayed(InitSamplingOfNode()));
+      sweep_plans.push_back(SweepPlan(*n));
+    }
+    auto sweep_plan = sweep_plans.begin();
+    unsigned int chain = 0;
+
+    /* The caller may pass the expected number of iterations. */
+    const size_t expected_blocks = std::max<size_t>(3 * chains,
+        iterations != 0 ? *iterations / block_iterations : 0);
+    size_t domain_size = x.value_range().size();
+    cont::vector<double> cumulative_counts(domain_size, 0.0);
+    cumulative_counts.reserve((expected_blocks + 1) * domain_size);
+    CategoricalDistribution block_counts;
+    size_t block_count = 0;
+
+    auto sample_block = [&]()
+    {
+      const DiscreteRandomVariable& chain_value = *chain_values[chain];
+      block_counts.clear();
+      for (unsigned int iteration = 0; iteration < block_iterations;
+          iteration++)
+      {
+        sweep_plan->sweep(random_number_engine);
+        block_counts[chain_value] += 1.0f;
+      }
+
+      /* Sampling may have added new outcomes (e.g. components of a
+       * Dirichlet process). Then widen the rows of the table. */
+      const DiscreteRandomVariable::Range x_range = x.value_range();
+      if (x_range.size() != domain_size)
+      {
+        cont::vector<double> widened_counts;
+        widened_counts.reserve(
+            (std::max(expected_blocks, block_count) + 1) * x_range.size());
+        widened_counts.resize((block_count + 1) * x_range.size(), 0.0);
+        for (size_t row = 0; row <= block_count; ++row)
+          copy(cumulative_counts.begin() + row * domain_size,
+              cumulative_counts.begin() + (row + 1) * domain_size,
+              widened_counts.begin() + row * x_range.size());
+        cumulative_counts.swap(widened_counts);
+        domain_size = x_range.size();
+      }
 
-    partial_distributions.push_back(sample(X, 0, 500));
-    partial_distributions.push_back(sample(X, 0, 500));
+      /* Append the running sums including this block. */
+      const size_t last_row = block_count * domain_size;
+      size_t k = 0;
+      for (auto x_value = x_range.begin(); x_value != x_range.end();
+          ++x_value, ++k)
+      {
+        auto b = block_counts.find(x_value);
+        float count = b == block_counts.end() ? 0.0f : b->second;
+        cumulative_counts.push_back(cumulative_counts[last_row + k] + count);
+      }
+      ++block_count;
+
+      /* The next block goes to the next chain. */
+      if (++chain == chains)
+      {
+        chain = 0;
+        sweep_plan = sweep_plans.begin();
+      }
+      else
+        ++sweep_plan;
+    };
+
+    /* A round runs one block on every chain. */
+    auto sample_round = [&]()
+    {
+      for (unsigned int c = 0; c != chains; ++c)
+        sample_block();
+    };
+
+    sample_round();
+    sample_round();
+
+    float overall_deviation = 0.0f;
     do
     {
+      sample_round();
+
+      // Divide the rounds in three parts
+      const size_t rounds = block_count / chains;
+      const size_t first_third = std::ceil(rounds / 3.0) * chains;
+      const size_t second_third = std::ceil(rounds * 2.0 / 3.0) * chains;
+      const double* row_0 = &cumulative_counts[0];
+      const double* row_1 = &cumulative_counts[first_third * domain_size];
+      const double* row_2 = &cumulative_counts[second_third * domain_size];
+      const double* row_3 = &cumulative_counts[block_count * domain_size];
+      const double size_1 = first_third * double(block_iterations);
+      const double size_2 = (second_third - first_third)
+          * double(block_iterations);
+      const double size_3 = (block_count - second_third)
+          * double(block_iterations);
+
+      // Compare the distributions of the parts
       overall_deviation = 0.0f;
-
-      partial_distributions.push_back(sample(X, 0, 500));
-
-      // Divide the list in three parts
-      auto first_third_it = partial_distributions.begin()
-          + std::ceil(partial_distributions.size() / 3.0);
-      auto second_third_it = partial_distributions.begin()
-          + std::ceil(partial_distributions.size() * 2.0 / 3.0);
-
-      // Compute a combined distribution for every part
-      auto first_third_distribution = mix_distributions_additively(
-          partial_distributions.begin(), first_third_it);
-      auto second_third_distribution = mix_distributions_additively(
-          first_third_it, second_third_it);
-      auto third_third_distribution = mix_distributions_additively(
-          second_third_it, partial_distributions.end());
-
-      // Compare the distributions
-      single_deviation = maximum_norm(
-          difference(first_third_distribution, second_third_distribution));
-      overall_deviation = std::max(overall_deviation, single_deviation);
-      single_deviation = maximum_norm(
-          difference(first_third_distribution, third_third_distribution));
-      overall_deviation = std::max(overall_deviation, single_deviation);
-      single_deviation = maximum_norm(
-          difference(second_third_distribution, third_third_distribution));
-      overall_deviation = std::max(overall_deviation, single_deviation);
+      for (size_t k = 0; k != domain_size; ++k)
+      {
+        const double p_1 = (row_1[k] - row_0[k]) / size_1;
+        const double p_2 = (row_2[k] - row_1[k]) / size_2;
+        const double p_3 = (row_3[k] - row_2[k]) / size_3;
+        overall_deviation = std::max(overall_deviation,
+            static_cast<float>(std::max(std::fabs(p_1 - p_2),
+                std::max(std::fabs(p_1 - p_3), std::fabs(p_2 - p_3)))));
+      }
     }
     while (overall_deviation > max_deviation);
 
     if (iterations != 0)
-      *iterations = partial_distributions.size() * partial_iterations;
+      *iterations = block_count * block_iterations;
 
-    return mix_distributions_additively(partial_distributions.begin(),
-        partial_distributions.end());
+    CategoricalDistribution X_distribution;
+    const double* row_n = &cumulative_counts[block_count * domain_size];
+    size_t k = 0;
+    const DiscreteRandomVariable::Range x_range = x.value_range();
+    for (auto x_value = x_range.begin(); x_value != x_range.end();
+        ++x_value, ++k)
+      X_distribution[x_value] = row_n[k];
+    X_distribution.normalize();
+    return X_distribution;
   }
 
 }
@@ -8,12 +8,16 @@
 #ifndef BAYESIANNETWORK_HPP_
 #define BAYESIANNETWORK_HPP_
 
+#include "ArenaAllocator.hpp"
 #include "ConditionalDirichletNode.hpp"
 #include "DirichletNode.hpp"
+#include "DiscreteFactor.hpp"
 #include "NodeUtils.hpp"
+#include "PlateNode.hpp"
 #include "cont/list.hpp"
 #include <boost/variant/get.hpp>
 #include <boost/variant/variant.hpp>
+#include <unordered_map>
 
 namespace cpprob
 {
@@ -27,19 +31,44 @@ namespace cpprob
         ConditionalDirichletNode, ConstantDirichletProcessParametersNode,
         ConstantDiscreteRandomVariableNode,
         ConstantRandomConditionalProbabilitiesNode,
-        ConstantRandomProbabilitiesNode, DirichletNode, DirichletProcessNode> Node;
+        ConstantRandomProbabilitiesNode, DirichletNode, DirichletProcessNode,
+        PlateNode> Node;
 
   private:
 
-    typedef cont::list<Node> NodeList;
+    /* The nodes come from an arena; so a sweep walks through memory in
+     * the order of insertion, and adding a node rarely allocates. */
+    typedef cont::list<Node, ArenaAllocator<Node> > NodeList;
 
   public:
 
     typedef NodeList::iterator iterator;
     typedef NodeList::const_iterator const_iterator;
 
+    /**
+     * Heuristics to choose the order in which #eliminate() sums out the
+     * variables. Both heuristics are greedy: they always pick the variable
+     * that is cheapest to eliminate next.
+     * - min_degree_ordering picks the variable with the fewest neighbours in
+     *   the interaction graph of the remaining factors.
+     * - min_fill_ordering picks the variable whose elimination adds the
+     *   fewest new edges to the interaction graph.
+     */
+    enum EliminationOrdering
+    {
+      min_degree_ordering, min_fill_ordering
+    };
+
     BayesianNetwork();
 
+    /**
+     * Copies the nodes and their references in one pass over the network.
+     * The copy of an overlay is an overlay, too; it shares the parameter
+     * nodes of the same network.
+     *
+     * @throw std::logic_error A node refers to a parent that is not part of
+     *     the network, and the network is not an overlay.
+     */
     BayesianNetwork(const BayesianNetwork& other_hbn);
 
     // Use the implicit destructor, so the implicit move operations
@@ -119,36 +148,66 @@ namespace cpprob
       add_dirichlet_process_parameters(const std::string& name,
           float concentration, const NodeList& managed_nodes)
       {
-        iterator new_node = vertices_.insert(
-            end(),
+        iterator new_node = insert_vertex(
             ConstantDirichletProcessParametersNode(
                 DirichletProcessParameters(name, concentration,
                     managed_nodes)));
         return boost::get<ConstantDirichletProcessParametersNode>(*new_node);
       }
 
+    /**
+     * Adds a plate: the template variables repeated for every row of the
+     * evidence table. The template variables with a column in the table are
+     * observed, the others are latent. The Dirichlet parameter nodes of the
+     * template variables learn from and sample with the rows of the plate
+     * like with their children.
+     *
+     * @par Requires:
+     * - The parameter nodes of the template are nodes of this network.
+     *
+     * @param template_nodes the template variables and their parameter nodes
+     * @param evidence_table the observed values
+     * @return the new plate node, which is named like the evidence table
+     * @throw std::invalid_argument The evidence table does not fit the
+     *     template (see PlateNode::PlateNode()).
+     */
+    PlateNode&
+    add_plate(const PlateTemplate& template_nodes,
+        const EvidenceTable& evidence_table);
+
+    /**
+     * Provides the first node with the given name, that is the name of its
+     * value. The network keeps an index of the names; so this takes
+     * constant time.
+     *
+     * @par Requires:
+     * - No node has got a variable of another name since it was added. The
+     *   index holds the names the nodes were added with; to rename a node,
+     *   erase it and add it again.
+     *
+     * @throw std::out_of_range No node has this name.
+     * @throw boost::bad_get The first node with this name is not of type N.
+     */
     template<class N>
       N&
       at(const std::string& name)
       {
-        auto find_it = std::find_if(begin(), end(),
-            make_delayed_compare_node_name(name));
-        if (find_it == end())
+        Node* node = find_vertex(name);
+        if (node == 0)
           cpprob_throw_out_of_range(
               "BayesianNetwork: Could not find the node " + name + ".");
-        return boost::get<N>(*find_it);
+        return boost::get<N>(*node);
       }
 
     template<class N>
       const N&
       at(const std::string& name) const
       {
-        auto find_it = std::find_if(begin(), end(),
-            make_delayed_compare_node_name(name));
-        if (find_it == end())
+        const Node* node = find_vertex(name);
+        if (node == 0)
           cpprob_throw_out_of_range(
               "BayesianNetwork: Could not find the node " + name + ".");
-        return boost::get<N>(*find_it);
+        return boost::get<N>(*node);
       }
 
     iterator
@@ -163,12 +222,64 @@ namespace cpprob
       return vertices_.begin();
     }
 
+    /**
+     * Computes the probability distribution of the given node by variable
+     * elimination. The result is the same as the one of #enumerate(). But
+     * instead of enumerating all joint states of the network, this algorithm
+     * builds one factor per discrete node and sums out the non-evidence
+     * variables one after the other. Its costs are exponential only in the
+     * largest factor created during elimination, not in the number of
+     * nodes. So this method is the choice for exact inference in larger
+     * networks.
+     *
+     * @par Requires:
+     * - Like #enumerate(): The network consists of CategoricalNode and
+     *   ConditionalCategoricalNode objects. Constant nodes are allowed. All
+     *   other nodes must not be evidence; their values are held fixed.
+     * - X is a CategoricalNode or ConditionalCategoricalNode of this network.
+     *
+     * @par Ensures:
+     * - The network is not modified, even in case of an exception. In
+     *   particular, the values of all random variables are restored.
+     *
+     * @param X node whose distribution should be computed
+     * @param ordering heuristic for the elimination order
+     * @return the distribution of the variable of the node X given the
+     *     evidence in the network
+     * @throw NetworkError The network does not conform to the requirements of
+     *     this algorithm.
+     * @throw std::bad_alloc Failed to allocate temporary memory.
+     */
+    CategoricalDistribution
+    eliminate(const DiscreteNode& X, EliminationOrdering ordering =
+        min_fill_ordering);
+
     iterator
     end()
     {
       return vertices_.end();
     }
 
+    /**
+     * Like at(), but returns 0 instead of throwing if no node has the name
+     * or the first node with the name is not of type N.
+     */
+    template<class N>
+      N*
+      find(const std::string& name)
+      {
+        Node* node = find_vertex(name);
+        return node == 0 ? 0 : boost::get<N>(node);
+      }
+
+    template<class N>
+      const N*
+      find(const std::string& name) const
+      {
+        const Node* node = find_vertex(name);
+        return node == 0 ? 0 : boost::get<N>(node);
+      }
+
     const_iterator
     end() const
     {
@@ -217,8 +328,60 @@ namespace cpprob
 
     CategoricalDistribution
     sample(const DiscreteNode& X, unsigned int burn_in_iterations,
-        unsigned int collect_iterations);
+        unsigned int collect_iterations,
+        RandomNumberEngine& rne = random_number_engine);
+
+    /**
+     * Samples the distribution of the given node with several independent
+     * Gibbs chains in parallel. Every chain runs on its own copy of the
+     * network and draws from its own random number engine. The engines are
+     * seeded from cpprob::random_number_engine before the chains start. So
+     * the result is reproducible for a fixed seed of this engine, independent
+     * of the number of threads. The distributions of the chains are mixed
+     * with equal weights.
+     *
+     * The network itself is not modified. In particular, its values stay as
+     * they are.
+     *
+     * @par Requires:
+     * - Sampling does not create new variables or outcomes. A Dirichlet
+     *   process grows its component variable, whose size is shared by all
+     *   copies of the network (see DiscreteRandomVariable). So the chains
+     *   would not be independent, and a network with a Dirichlet process
+     *   is rejected.
+     *
+     * @param X node whose distribution should be computed
+     * @param burn_in_iterations iterations per chain before collecting samples
+     * @param collect_iterations samples collected per chain
+     * @param chains number of independent chains (at least 1)
+     * @param threads number of threads to run the chains; if 0, the number of
+     *     hardware threads is used
+     * @return the mixed distribution of all chains
+     * @throw std::invalid_argument X is not part of this network or
+     *     chains is 0.
+     * @throw NetworkError The network has a Dirichlet process.
+     */
+    CategoricalDistribution
+    sample(const DiscreteNode& X, unsigned int burn_in_iterations,
+        unsigned int collect_iterations, unsigned int chains,
+        unsigned int threads);
 
+    /**
+     * Samples the distribution of the given node until it converges. A few
+     * Gibbs chains run in blocks of 500 iterations; every chain is
+     * initialized once and kept running. The first chain runs on this
+     * network, the others on copies of it. A network with a Dirichlet
+     * process runs one chain (see the multi-chain sample()).
+     *
+     * @param x node whose distribution should be computed
+     * @param max_deviation maximum deviation of the distributions of the
+     *     three parts of the blocks for convergence
+     * @param iterations if not 0, receives the number of iterations done. A
+     *     value on entry is taken as the expected number of iterations; it
+     *     only reserves memory for the counts.
+     * @return the distribution of all blocks
+     * @throw std::invalid_argument x is not part of this network.
+     */
     CategoricalDistribution
     sample(const DiscreteNode& x, float max_deviation,
         unsigned int* iterations = 0);
@@ -258,6 +421,77 @@ namespace cpprob
     void
     learn();
 
+    /**
+     * Learns like learn(), but counts the evidence with the given number of
+     * threads. The parameter nodes are learned concurrently, and the
+     * children of a node are split into shards that are counted
+     * concurrently. The learned probabilities are exactly the same as with
+     * learn().
+     *
+     * @param threads number of threads; if 0, the number of hardware threads
+     *     is used
+     */
+    void
+    learn(unsigned int threads);
+
+    /**
+     * Learns the parameter nodes like learn(), but also from the rows with
+     * latent nodes, by expectation maximization. A row is a connected
+     * group of categorical nodes; the parameter nodes do not connect rows.
+     * The E-step enumerates the joint values of the latent nodes of every
+     * row and weights their counts with their posterior probability given
+     * the current parameters. The M-step writes the probabilities like
+     * learn(). This repeats until the log-likelihood of the evidence
+     * changes by at most the tolerance or the iterations are used up.
+     *
+     * EM starts from the current values of the parameter nodes. Uniform
+     * values are a fixed point for symmetric latent variables; so set or
+     * sample other values first.
+     *
+     * @par Requires:
+     * - Every row has at most 65536 joint values of its latent nodes.
+     * - The latent columns of plates are not considered.
+     *
+     * @par Ensures:
+     * - The values of the categorical nodes are not modified.
+     *
+     * @param max_iterations maximum number of EM iterations
+     * @param tolerance maximum change of the log-likelihood for convergence
+     * @param iterations if not 0, receives the number of iterations done;
+     *     fewer than max_iterations means that EM has converged
+     * @param threads number of threads for the E-step over the rows and
+     *     the M-step; if 0, the number of hardware threads is used. The
+     *     result does not depend on it.
+     * @return the log-likelihood of the evidence given the parameters of the
+     *     last E-step
+     * @throw NetworkError A row has too many joint latent values.
+     */
+    double
+    learn_em(unsigned int max_iterations, float tolerance,
+        unsigned int* iterations = 0, unsigned int threads = 1);
+
+    /**
+     * Creates a network that shares the parameter nodes with this network
+     * and copies the other nodes: their values, evidence flags and
+     * conditions. This is how to fork the evidence for a query: The
+     * overlay takes other evidence and is sampled or enumerated with the
+     * same probabilities, without the memory and time to copy them.
+     *
+     * The overlay only reads the shared parameters; it does not learn them.
+     * Its nodes are not children of the shared parameter nodes. So the
+     * overlay does not change this network, and learning this network
+     * does not count the evidence of the overlay.
+     *
+     * Copies of the overlay are overlays of this network, too.
+     *
+     * @par Requires:
+     * This network keeps the parameter nodes as long as the overlay.
+     * @throw std::logic_error The network has a Dirichlet process, whose
+     *     parameters change while sampling.
+     */
+    BayesianNetwork
+    overlay() const;
+
     /**
      * Removes the given node from the network. This method erases exactly
      * the single node that is at the address given by the argument reference.
@@ -267,13 +501,15 @@ namespace cpprob
      * If the referenced node is found, it is removed. In this case, this
      * method returns 1. If the node is not found, 0 is returned.
      *
-     * This method is very slow. It must walk through the whole network to
-     * find all the references to the node. To save memory and speed up
-     * computations, there are no data structures for finding these references.
-     * Erasing is considered to be very unimportant and rarely used.
+     * The network indexes the nodes by address. So erasing a node only
+     * visits its parents; the time grows with the number of children of
+     * these parents, not with the size of the network. To remove many
+     * nodes, erase(iterator, iterator) and erase_if() visit every parent
+     * only once.
      *
-     * The node to erase may not have children any more. If it has some though,
-     * this method throws an @c std::invalid_argument exception.
+     * The node to erase may not have children any more (nor plates, if it is
+     * a parameter node of a plate). If it has some though, this method throws
+     * an @c std::invalid_argument exception.
      */
     template<class Node>
       std::size_t
@@ -282,27 +518,60 @@ namespace cpprob
         cpprob_check_debug(&node != 0,
             "BayesianNetwork: Cannot erase node at address 0.");
 
-        if (node.children().size() != 0)
-          cpprob_throw_invalid_argument(
-              "BayesianNetwork: Cannot erase a node with children (node " << node.value().name() << ").");
+        auto vertex = addresses_.find(&node);
+        if (vertex == addresses_.end())
+          return 0;
+        return erase_vertices(cont::vector<iterator>(1, vertex->second));
+      }
+
+    /**
+     * Removes the nodes in the given range in one pass. Like erase(const
+     * Node&), the method removes the child references of the parents.
+     *
+     * @return the number of erased nodes
+     * @throw std::invalid_argument A node in the range has a child or plate
+     *     outside the range. Then no node is erased.
+     */
+    std::size_t
+    erase(iterator first, iterator last);
 
-        size_t erase_count = 0;
-        EraseHelper erase_helper(&node);
-        for (auto n = begin(); n != end();)
+    /**
+     * Removes all nodes for which the predicate returns true, in one pass.
+     * This is the way to drop many rows, like the oldest evidence of a
+     * sliding window.
+     *
+     * @param predicate called with every node of the network (the element
+     *     type of #iterator); it must not change the network
+     * @return the number of erased nodes
+     * @throw std::invalid_argument A node to erase has a child or plate that
+     *     is not erased. Then no node is erased.
+     */
+    template<class Predicate>
+      std::size_t
+      erase_if(Predicate predicate)
+      {
+        cont::vector<iterator> vertices;
+        for (auto n = begin(); n != end(); ++n)
         {
-          if (boost::apply_visitor(erase_helper, *n))
-          {
-            n = vertices_.erase(n);
-            ++erase_count;
-          }
-          else
-          {
-            ++n;
-          }
+          if (predicate(*n))
+            vertices.push_back(n);
         }
-        return erase_count;
+        return erase_vertices(vertices);
       }
 
+    /**
+     * Makes room for the given number of nodes to add, in one contiguous
+     * block of memory. This is a hint for building large networks; the
+     * network also grows without it.
+     */
+    void
+    reserve(std::size_t nodes)
+    {
+      vertices_.get_allocator().arena().reserve(nodes);
+      names_.reserve(names_.size() + nodes);
+      addresses_.reserve(addresses_.size() + 2 * nodes);
+    }
+
     std::size_t
     size() const
     {
@@ -311,44 +580,56 @@ namespace cpprob
 
   private:
 
+    friend class CompiledNetwork;
+
+    class CollectFactors;
     class CopyNode;
+    class EraseReferences;
+    class ExpectationMaximization;
+    class HasDependents;
     class LearnParameters;
+    class NodeAddresses;
+    class ParentsOfNode;
+    class SweepPlan;
 
-    class EraseHelper : public boost::static_visitor<bool>
-    {
-
-    public:
-
-      EraseHelper(const void* node_address)
-          : erase_node_address_(node_address)
-      {
-      }
-
-      template<class Node>
-        bool
-        operator()(Node& node)
-        {
-          if (&node == erase_node_address_)
-            return true;
-
-          auto& children = node.children();
-          for (auto c = children.begin(); c != children.end();)
-          {
-            if (&(*c) == erase_node_address_)
-              c = children.erase(c);
-            else
-              ++c;
-          }
-          return false;
-        }
-
-    private:
-
-      const void* erase_node_address_;
-
-    };
+    typedef std::unordered_map<const void*, iterator> AddressIndex;
+    typedef std::unordered_map<std::string, iterator> NameIndex;
 
     NodeList vertices_;
+    /* The first node of every name, for at() and find(). Only
+     * insert_vertex() and erase_vertex() change it. */
+    NameIndex names_;
+    /* The node at every node address and value address. The address of a
+     * value is what the children keep of their parents; so erase() finds a
+     * node and its parents without walking the network. */
+    AddressIndex addresses_;
+    /* Whether the parameter nodes are shared with another network; see
+     * overlay(). */
+    bool is_overlay_;
+
+    /**
+     * Computes the order in which #eliminate() sums out the free variables.
+     * The order is computed greedily on the interaction graph of the
+     * factors. The query variable is never part of the order.
+     *
+     * @param factors the factors of the network
+     * @param free_variables the variables to eliminate and the query variable
+     * @param query_variable the variable that remains after elimination or 0
+     *     to eliminate all free variables
+     * @param ordering the heuristic to pick the next variable
+     * @param cliques If not 0, the method appends for every eliminated
+     *     variable the clique it forms with its neighbours in the
+     *     triangulated graph. CompiledNetwork builds its junction tree from
+     *     these cliques.
+     * @return the free variables except the query variable in the order of
+     *     elimination
+     */
+    static DiscreteFactor::Variables
+    elimination_order(const cont::list<DiscreteFactor>& factors,
+        const DiscreteFactor::Variables& free_variables,
+        const DiscreteRandomVariable* query_variable,
+        EliminationOrdering ordering,
+        cont::vector<DiscreteFactor::Variables>* cliques = 0);
 
     /**
      * Computes recursively the joint probability of the network defined by
@@ -358,15 +639,39 @@ namespace cpprob
      * This method may throw any exception. They are all caught in #enumerate()
      * and transformed in appropriate exceptions.
      *
+     * The probabilities are multiplied and summed in the log domain, so the
+     * joint probability of a large network does not underflow.
+     *
      * @param current For this vertex, the probability is computed.
-     * @param end If current == end, the recursion stops with 1.0.
-     * @return the joint probability of the network
+     * @param end If current == end, the recursion stops with log(1) = 0.
+     * @return the logarithm of the joint probability of the network
      * @throw Any #enumerate() catches all exceptions and maps them
      *     appropriately for its interface.
      */
-    float
+    double
     enumerate_all(iterator current, iterator end);
 
+    /* Removes the node from the list and the indexes. */
+    iterator
+    erase_vertex(iterator vertex);
+
+    std::size_t
+    erase_vertices(const cont::vector<iterator>& vertices);
+
+    Node*
+    find_vertex(const std::string& name) const;
+
+    /* Appends the node to the list and the indexes. */
+    iterator
+    insert_vertex(const Node& node);
+
+    /* Provides the position of the node in the list. A copy of the network
+     * has the copy of the node at the same position.
+     *
+     * @throw std::invalid_argument X is not part of this network. */
+    std::size_t
+    position_of(const DiscreteNode& X);
+
     void
     enumerate_impl(CategoricalDistribution& X_distribution,
         DiscreteRandomVariable& x);
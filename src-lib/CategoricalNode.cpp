@@ -7,6 +7,7 @@
 
 #include "CategoricalNode.hpp"
 #include "ConditionalCategoricalNode.hpp"
+#include "DirichletNode.hpp"
 
 using namespace std;
 
@@ -43,9 +44,8 @@ namespace cpprob
 
   CategoricalNode::CategoricalNode(const DiscreteRandomVariable& value,
       RandomProbabilities& probabilities)
-      : DiscreteNode(value), is_evidence_(false), sampling_variate_(
-          random_number_engine, CategoricalDistribution()), probabilities_(
-          probabilities)
+      : DiscreteNode(value), is_evidence_(false), sampling_distribution_(), blanket_kernel_(),
+          probabilities_(probabilities), counter_(0)
   {
   }
 
@@ -54,29 +54,39 @@ namespace cpprob
   }
 
   void
-  CategoricalNode::init_sampling()
+  CategoricalNode::add_blanket_counts(float weight)
+  {
+    if (counter_ != 0)
+      counter_->add_count(value(), weight);
+    for (auto c = children().begin(); c != children().end(); ++c)
+      c->add_count(weight);
+  }
+
+  void
+  CategoricalNode::init_sampling(RandomNumberEngine& rne)
   {
     /* Initialize value_ by drawing from the distribution given by the
      * probability table. This also initializes sampling_distribution.
      * CategoricalNode::sample requires it to contain all possible values of
      * the DiscreteRandomVariable. */
-    CategoricalDistribution& sampling_distribution =
-        sampling_variate_.distribution();
+    CategoricalDistribution& sampling_distribution = sampling_distribution_;
     sampling_distribution.clear();
+    add_blanket_counts(-1.0f);
     for (auto p_it = probabilities_.begin(); p_it != probabilities_.end();
         ++p_it)
       sampling_distribution[p_it->first] = p_it->second;
-    value() = sampling_variate_();
+    value() = draw_from(rne, sampling_distribution);
+    add_blanket_counts(1.0f);
+    blanket_kernel_.compile(value(), children());
   }
 
   void
-  CategoricalNode::sample()
+  CategoricalNode::sample(RandomNumberEngine& rne)
   {
     /* Get the variables and references that are necessary for all block below.
      * They come before the requirements tests because they are also needed
      * for these tests. */
-    CategoricalDistribution& sampling_distribution =
-        sampling_variate_.distribution();
+    CategoricalDistribution& sampling_distribution = sampling_distribution_;
     auto d_end = sampling_distribution.end();
 
     /* Check requirements. */
@@ -84,28 +94,36 @@ namespace cpprob
         sampling_distribution.size() == probabilities_.size(),
         "CategoricalNode: While sampling, the sampling distribution (size: " << sampling_distribution.size() << ") shows the wrong size compared to the probability table(size: " << probabilities_.size() << ").");
 
+    /* In the collapsed mode, take this node out of the counts, so the
+     * probabilities are the predictive distribution given all other nodes. */
+    add_blanket_counts(-1.0f);
+
     /* Initialize the sampling distribution with the prior. */
     auto d_it = sampling_distribution.begin();
     auto p_it = probabilities_.begin();
     for (; d_it != d_end; ++d_it, ++p_it)
       d_it->second = p_it->second;
 
-    /* Update the sampling distribution with the likelihoods. */
-    for (auto c = children().begin(); c != children().end(); ++c)
+    /* Update the sampling distribution with the likelihoods. The kernel
+     * must be compiled again if the probability tables of the children have
+     * changed since init_sampling. Children of collapsed parameter nodes
+     * are scored one after the other instead. */
+    if (MarkovBlanketKernel::has_collapsed_children(children()))
+    {
+      MarkovBlanketKernel::multiply_collapsed_likelihoods(value(), children(),
+          sampling_distribution);
+    }
+    else
     {
-      auto c_value = c->value();
-      auto& c_probabilities = c->probabilities();
-      auto c_condition = c->condition().sub_range(value()).begin();
-      d_it = sampling_distribution.begin();
-
-      for (; d_it != d_end; ++d_it, ++c_condition)
-        d_it->second *= c_probabilities.at(c_condition.joint_value()).at(
-            c_value);
+      if (!blanket_kernel_.is_current())
+        blanket_kernel_.compile(value(), children());
+      blanket_kernel_.multiply_likelihoods(sampling_distribution);
     }
     sampling_distribution.normalize();
 
     /* Draw from the distribution. */
-    value() = sampling_variate_();
+    value() = draw_from(rne, sampling_distribution);
+    add_blanket_counts(1.0f);
   }
 
 } /* namespace cpprob */
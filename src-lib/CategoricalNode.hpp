@@ -30,12 +30,15 @@
 
 #include "CategoricalDistribution.hpp"
 #include "DiscreteNode.hpp"
+#include "MarkovBlanketKernel.hpp"
+#include "RandomNumberEngine.hpp"
 #include "RandomProbabilities.hpp"
 
 namespace cpprob
 {
 
   class ConditionalCategoricalNode;
+  class DirichletNode;
 
   class CategoricalNode : public DiscreteNode
   {
@@ -54,8 +57,24 @@ namespace cpprob
       return probabilities_.at(value());
     }
 
+    /**
+     * Provides the parameter node that keeps the count of the value of this
+     * node, or 0. The node updates the count while it samples.
+     */
+    DirichletNode*
+    counter() const
+    {
+      return counter_;
+    }
+
     void
-    init_sampling();
+    counter(DirichletNode* node)
+    {
+      counter_ = node;
+    }
+
+    void
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
 
     bool
     is_evidence() const
@@ -82,19 +101,26 @@ namespace cpprob
     }
 
     void
-    sample();
+    sample(RandomNumberEngine& rne = random_number_engine);
 
   private:
 
     // Variables in common with ConditionalCategoricalNode.
     bool is_evidence_;
-    std::variate_generator<RandomNumberEngine&, CategoricalDistribution> sampling_variate_;
+    CategoricalDistribution sampling_distribution_;
+    MarkovBlanketKernel blanket_kernel_;
     // Variables specific to this class.
     RandomProbabilities& probabilities_;
+    DirichletNode* counter_;
 
     friend std::ostream&
     operator<<(std::ostream& os, const CategoricalNode& node);
 
+    /* Adds the weight to the counts of this node and its children in the
+     * collapsed mode. */
+    void
+    add_blanket_counts(float weight);
+
   };
 
 } /* namespace cpprob */
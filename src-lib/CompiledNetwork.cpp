@@ -0,0 +1,473 @@
+/*
+ * CompiledNetwork.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "CompiledNetwork.hpp"
+#include <algorithm>
+
+using namespace boost;
+using namespace std;
+
+namespace cpprob
+{
+
+  /**
+   * Determines the family of a node: its own variable followed by its
+   * condition variables. Returns false for nodes that do not contribute
+   * probabilities to the junction tree.
+   */
+  class CompiledNetwork::FamilyOfNode : public static_visitor<bool>
+  {
+
+  public:
+
+    FamilyOfNode(DiscreteFactor::Variables& family)
+        : family_(family)
+    {
+    }
+
+    bool
+    operator()(CategoricalNode& node) const
+    {
+      family_.push_back(&node.value());
+      return true;
+    }
+
+    bool
+    operator()(ConditionalCategoricalNode& node) const
+    {
+      family_.push_back(&node.value());
+      const DiscreteRandomReferences& condition = node.condition();
+      for (auto c = condition.begin(); c != condition.end(); ++c)
+        family_.push_back(&const_cast<DiscreteRandomVariable&>(*c));
+      return true;
+    }
+
+    template<class V, class C>
+      bool
+      operator()(ConstantNode<V, C>&) const
+      {
+        return false;
+      }
+
+    template<class N>
+      bool
+      operator()(N& node) const
+      {
+        if (node.is_evidence())
+          cpprob_throw_network_error(
+              "CompiledNetwork: Cannot compile the evidence node " //
+              << node.value().name() << " of type " << typeid(N).name() << ".");
+        return false;
+      }
+
+  private:
+
+    DiscreteFactor::Variables& family_;
+
+  };
+
+  CompiledNetwork::CompiledNetwork(BayesianNetwork& bn,
+      BayesianNetwork::EliminationOrdering ordering)
+      : cliques_(), home_cliques_(), host_cliques_(), message_computations_(0)
+  {
+    /* Collect the families of the categorical nodes. The variables of the
+     * junction tree are the variables of these nodes. Condition variables of
+     * other nodes are held fixed; so they are removed from the families. */
+    cont::vector<BayesianNetwork::iterator> nodes;
+    cont::vector<DiscreteFactor::Variables> families;
+    DiscreteFactor::Variables variables;
+    for (auto n = bn.begin(); n != bn.end(); ++n)
+    {
+      DiscreteFactor::Variables family;
+      if (apply_visitor(FamilyOfNode(family), *n))
+      {
+        nodes.push_back(n);
+        families.push_back(family);
+        variables.push_back(family.front());
+      }
+    }
+
+    auto is_fixed = [&variables](DiscreteRandomVariable* var)
+    {
+      return find(variables.begin(), variables.end(), var) == variables.end();
+    };
+    cont::list<DiscreteFactor> family_factors;
+    for (auto f = families.begin(); f != families.end(); ++f)
+    {
+      f->erase(remove_if(f->begin(), f->end(), is_fixed), f->end());
+      family_factors.push_back(DiscreteFactor(*f));
+    }
+
+    /* Triangulate the moral graph. The cliques formed during elimination
+     * contain all maximal cliques of the triangulated graph. */
+    cont::vector<DiscreteFactor::Variables> elimination_cliques;
+    BayesianNetwork::elimination_order(family_factors, variables, 0, ordering,
+        &elimination_cliques);
+
+    auto is_subset = [](const DiscreteFactor::Variables& sub,
+        const DiscreteFactor::Variables& super)
+    {
+      for (auto v = sub.begin(); v != sub.end(); ++v)
+      {
+        if (find(super.begin(), super.end(), *v) == super.end())
+          return false;
+      }
+      return true;
+    };
+
+    for (size_type i = 0; i != elimination_cliques.size(); ++i)
+    {
+      bool is_maximal = true;
+      for (size_type j = 0; j != elimination_cliques.size() && is_maximal; ++j)
+      {
+        if (i != j && is_subset(elimination_cliques[i], elimination_cliques[j])
+            && (elimination_cliques[i].size() < elimination_cliques[j].size()
+                || j < i))
+          is_maximal = false;
+      }
+      if (is_maximal)
+      {
+        Clique clique;
+        clique.variables = elimination_cliques[i];
+        clique.potential_valid = false;
+        clique.belief_valid = false;
+        cliques_.push_back(clique);
+      }
+    }
+
+    /* Connect the cliques to a maximum spanning tree with the sizes of the
+     * separators as weights (Prim). This tree has the running intersection
+     * property. Cliques of unconnected parts of the network are connected by
+     * empty separators. */
+    cont::vector<bool> in_tree(cliques_.size(), false);
+    cont::vector<size_type> separator_sizes(cliques_.size(), 0);
+    cont::vector<size_type> tree_neighbours(cliques_.size(), cliques_.size());
+    for (size_type added = 0; added != cliques_.size(); ++added)
+    {
+      size_type best = cliques_.size();
+      for (size_type c = 0; c != cliques_.size(); ++c)
+      {
+        if (!in_tree[c]
+            && (best == cliques_.size()
+                || separator_sizes[c] > separator_sizes[best]))
+          best = c;
+      }
+
+      in_tree[best] = true;
+      if (added != 0)
+      {
+        size_type neighbour = tree_neighbours[best];
+        cliques_[best].neighbours.push_back(neighbour);
+        cliques_[neighbour].neighbours.push_back(best);
+      }
+
+      for (size_type c = 0; c != cliques_.size(); ++c)
+      {
+        if (in_tree[c])
+          continue;
+        size_type separator_size = 0;
+        for (auto v = cliques_[c].variables.begin();
+            v != cliques_[c].variables.end(); ++v)
+        {
+          if (find(cliques_[best].variables.begin(),
+              cliques_[best].variables.end(), *v)
+              != cliques_[best].variables.end())
+            ++separator_size;
+        }
+        if (separator_size > separator_sizes[c]
+            || tree_neighbours[c] == cliques_.size())
+        {
+          separator_sizes[c] = separator_size;
+          tree_neighbours[c] = best;
+        }
+      }
+    }
+
+    for (auto c = cliques_.begin(); c != cliques_.end(); ++c)
+    {
+      c->messages.resize(c->neighbours.size());
+      c->messages_valid.assign(c->neighbours.size(), false);
+    }
+
+    /* Assign every node to the smallest clique that contains its family and
+     * every variable to the smallest clique that contains it. */
+    for (size_type n = 0; n != nodes.size(); ++n)
+    {
+      size_type host = cliques_.size();
+      for (size_type c = 0; c != cliques_.size(); ++c)
+      {
+        if (is_subset(families[n], cliques_[c].variables)
+            && (host == cliques_.size()
+                || cliques_[c].variables.size()
+                    < cliques_[host].variables.size()))
+          host = c;
+      }
+      cpprob_check_debug(host != cliques_.size(),
+          "CompiledNetwork: No clique contains the family of the node " //
+          << variables[n]->name() << ".");
+      cliques_[host].nodes.push_back(nodes[n]);
+      host_cliques_[variables[n]] = host;
+
+      size_type home = host;
+      for (size_type c = 0; c != cliques_.size(); ++c)
+      {
+        if (cliques_[c].variables.size() < cliques_[home].variables.size()
+            && find(cliques_[c].variables.begin(), cliques_[c].variables.end(),
+                variables[n]) != cliques_[c].variables.end())
+          home = c;
+      }
+      home_cliques_[variables[n]] = home;
+    }
+  }
+
+  const DiscreteFactor&
+  CompiledNetwork::belief(size_type c)
+  {
+    Clique& clique = cliques_[c];
+    if (!clique.belief_valid)
+    {
+      cont::vector<size_type> order;
+      cont::vector<size_type> parents;
+      tree_order(c, order, parents);
+      collect(order, parents);
+      combine_belief(c);
+    }
+    return clique.belief;
+  }
+
+  void
+  CompiledNetwork::calibrate()
+  {
+    for (auto c = cliques_.begin(); c != cliques_.end(); ++c)
+    {
+      c->potential_valid = false;
+      c->messages_valid.assign(c->neighbours.size(), false);
+      c->belief_valid = false;
+    }
+    if (cliques_.empty())
+      return;
+
+    /* After the collect and the distribute phase, every clique has all its
+     * messages. */
+    cont::vector<size_type> order;
+    cont::vector<size_type> parents;
+    tree_order(0, order, parents);
+    collect(order, parents);
+    distribute(order, parents);
+    for (size_type c = 0; c != cliques_.size(); ++c)
+      combine_belief(c);
+  }
+
+  CompiledNetwork::size_type
+  CompiledNetwork::clique_of(const CliqueTable& table,
+      const DiscreteNode& X) const
+  {
+    auto find_it = table.find(&X.value());
+    if (find_it == table.end())
+      cpprob_throw_out_of_range(
+          "CompiledNetwork: The node " << X.value().name() << " is not a categorical node of the compiled network.");
+    return find_it->second;
+  }
+
+  void
+  CompiledNetwork::collect(const cont::vector<size_type>& order,
+      const cont::vector<size_type>& parents)
+  {
+    /* A clique comes after its parent in the order. So going backwards, all
+     * messages into a clique are there before it sends to its parent. */
+    for (size_type i = order.size(); i-- > 1;)
+      message(order[i], parents[order[i]]);
+  }
+
+  void
+  CompiledNetwork::combine_belief(size_type c)
+  {
+    Clique& clique = cliques_[c];
+    DiscreteFactor belief = potential(c);
+    for (size_type k = 0; k != clique.neighbours.size(); ++k)
+    {
+      cpprob_check_debug(clique.messages_valid[k],
+          "CompiledNetwork: The message from clique " << clique.neighbours[k] << " to clique " << c << " is missing.");
+      belief = belief.product(clique.messages[k]);
+    }
+    clique.belief = belief;
+    clique.belief_valid = true;
+  }
+
+  void
+  CompiledNetwork::distribute(const cont::vector<size_type>& order,
+      const cont::vector<size_type>& parents)
+  {
+    /* A parent has received the message of its own parent before it sends
+     * to its children. */
+    for (size_type i = 1; i < order.size(); ++i)
+      message(parents[order[i]], order[i]);
+  }
+
+  void
+  CompiledNetwork::invalidate_messages_from(size_type c)
+  {
+    cont::vector<size_type> order;
+    cont::vector<size_type> parents;
+    tree_order(c, order, parents);
+    for (size_type i = 1; i < order.size(); ++i)
+    {
+      const size_type to = order[i];
+      cliques_[to].messages_valid[neighbour_index(to, parents[to])] = false;
+    }
+  }
+
+  CategoricalDistribution
+  CompiledNetwork::marginal(const DiscreteNode& X)
+  {
+    size_type c = clique_of(home_cliques_, X);
+    DiscreteRandomVariable* x =
+        &const_cast<DiscreteRandomVariable&>(X.value());
+
+    DiscreteFactor x_factor = belief(c);
+    const DiscreteFactor::Variables clique_variables = x_factor.variables();
+    for (auto v = clique_variables.begin(); v != clique_variables.end(); ++v)
+    {
+      if (*v != x)
+        x_factor = x_factor.sum_out(*v);
+    }
+
+    const DiscreteRandomVariable saved_value = *x;
+    CategoricalDistribution X_distribution;
+    DiscreteRandomVariable::Range X_range = x->value_range();
+    for (*x = X_range.begin(); *x != X_range.end(); ++(*x))
+      X_distribution[*x] = x_factor[x_factor.index_of_current_values()];
+    *x = saved_value;
+
+    X_distribution.normalize();
+    return X_distribution;
+  }
+
+  const DiscreteFactor&
+  CompiledNetwork::message(size_type from, size_type to)
+  {
+    Clique& target = cliques_[to];
+    size_type k = neighbour_index(to, from);
+    if (!target.messages_valid[k])
+    {
+      const Clique& source = cliques_[from];
+      DiscreteFactor product = potential(from);
+      for (size_type n = 0; n != source.neighbours.size(); ++n)
+      {
+        if (source.neighbours[n] == to)
+          continue;
+        cpprob_check_debug(source.messages_valid[n],
+            "CompiledNetwork: The message from clique " << source.neighbours[n] << " to clique " << from << " is missing.");
+        product = product.product(source.messages[n]);
+      }
+
+      for (auto v = source.variables.begin(); v != source.variables.end(); ++v)
+      {
+        if (find(target.variables.begin(), target.variables.end(), *v)
+            == target.variables.end())
+          product = product.sum_out(*v);
+      }
+
+      target.messages[k] = product;
+      target.messages_valid[k] = true;
+      ++message_computations_;
+    }
+    return target.messages[k];
+  }
+
+  CompiledNetwork::size_type
+  CompiledNetwork::neighbour_index(size_type c, size_type neighbour) const
+  {
+    const cont::vector<size_type>& neighbours = cliques_[c].neighbours;
+    return find(neighbours.begin(), neighbours.end(), neighbour)
+        - neighbours.begin();
+  }
+
+  const DiscreteFactor&
+  CompiledNetwork::potential(size_type c)
+  {
+    Clique& clique = cliques_[c];
+    if (clique.potential_valid)
+      return clique.potential;
+
+    /* The factor sets the variables to all joint values. Save the values
+     * before. The saved values of the evidence nodes are the observations. */
+    cont::vector<DiscreteRandomVariable> saved_values;
+    for (auto v = clique.variables.begin(); v != clique.variables.end(); ++v)
+      saved_values.push_back(**v);
+
+    cont::vector<pair<DiscreteRandomVariable*, size_type> > evidence;
+    for (auto n = clique.nodes.begin(); n != clique.nodes.end(); ++n)
+    {
+      if (apply_visitor(NodeIsEvidence(), **n))
+      {
+        DiscreteRandomVariable* var = apply_visitor(DiscreteValueOfNode(),
+            **n);
+        evidence.push_back(
+            make_pair(
+                var,
+                find(clique.variables.begin(), clique.variables.end(), var)
+                    - clique.variables.begin()));
+      }
+    }
+
+    DiscreteFactor potential(clique.variables);
+    const cont::vector<BayesianNetwork::iterator>& nodes = clique.nodes;
+    potential.fill([&nodes, &evidence, &saved_values]()
+    {
+      for (auto e = evidence.begin(); e != evidence.end(); ++e)
+      {
+        if (*e->first != saved_values[e->second])
+          return 0.0;
+      }
+      double p = 1.0;
+      for (auto n = nodes.begin(); n != nodes.end(); ++n)
+        p *= apply_visitor(ProbabilityOfNode(), **n);
+      return p;
+    });
+
+    for (size_type i = 0; i != clique.variables.size(); ++i)
+      *clique.variables[i] = saved_values[i];
+
+    clique.potential = potential;
+    clique.potential_valid = true;
+    return clique.potential;
+  }
+
+  void
+  CompiledNetwork::tree_order(size_type root, cont::vector<size_type>& order,
+      cont::vector<size_type>& parents) const
+  {
+    order.clear();
+    order.reserve(cliques_.size());
+    parents.assign(cliques_.size(), cliques_.size());
+    order.push_back(root);
+    for (size_type i = 0; i != order.size(); ++i)
+    {
+      const size_type c = order[i];
+      const cont::vector<size_type>& neighbours = cliques_[c].neighbours;
+      for (auto n = neighbours.begin(); n != neighbours.end(); ++n)
+      {
+        if (*n == parents[c])
+          continue;
+        parents[*n] = c;
+        order.push_back(*n);
+      }
+    }
+  }
+
+  void
+  CompiledNetwork::update(const DiscreteNode& X)
+  {
+    size_type c = clique_of(host_cliques_, X);
+    cliques_[c].potential_valid = false;
+    invalidate_messages_from(c);
+    for (auto clique = cliques_.begin(); clique != cliques_.end(); ++clique)
+      clique->belief_valid = false;
+  }
+
+} /* namespace cpprob */
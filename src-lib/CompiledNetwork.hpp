@@ -0,0 +1,195 @@
+/*
+ * CompiledNetwork.hpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#ifndef COMPILEDNETWORK_HPP_
+#define COMPILEDNETWORK_HPP_
+
+#include "BayesianNetwork.hpp"
+#include "DiscreteFactor.hpp"
+#include "cont/map.hpp"
+#include "cont/vector.hpp"
+
+namespace cpprob
+{
+
+  /**
+   * Junction tree of a discrete BayesianNetwork for repeated exact queries.
+   * The constructor triangulates the moral graph of the network and builds a
+   * tree of its cliques. Every categorical node is assigned to one clique
+   * that contains the node and its parents.
+   *
+   * The tree is calibrated by passing messages between neighbouring cliques
+   * (Shafer-Shenoy). A query collects the messages toward the clique of the
+   * node, from the leaves of the tree in; #calibrate() distributes them back
+   * out as well. The messages are cached. So after one calibration,
+   * #marginal() only multiplies the cached messages into one clique and sums
+   * out the other variables. If the evidence or the probabilities of a node
+   * change, #update() invalidates only the messages that depend on the
+   * clique of this node. They are recomputed with the next query.
+   *
+   * The compiled network refers to the nodes of the Bayesian network. So the
+   * network must outlive the compiled network, and its structure must not be
+   * modified in the meantime.
+   */
+  class CompiledNetwork
+  {
+
+  public:
+
+    typedef DiscreteFactor::size_type size_type;
+
+    /**
+     * Builds the junction tree of the network. The tree is not calibrated
+     * yet; the messages are computed on demand by #marginal() or all at once
+     * by #calibrate().
+     *
+     * @par Requires:
+     * - Like BayesianNetwork::enumerate(): The network consists of
+     *   CategoricalNode and ConditionalCategoricalNode objects. Constant
+     *   nodes are allowed. All other nodes must not be evidence; their values
+     *   are held fixed.
+     *
+     * @param bn the network to compile
+     * @param ordering heuristic for the elimination order that triangulates
+     *     the network
+     * @throw NetworkError The network does not conform to the requirements.
+     */
+    explicit
+    CompiledNetwork(BayesianNetwork& bn,
+        BayesianNetwork::EliminationOrdering ordering =
+            BayesianNetwork::min_fill_ordering);
+
+    // Use the implicit destructor, so the implicit copy and move operations
+    // are generated by the compiler.
+
+    /**
+     * Reads the evidence and the probabilities of all nodes again and
+     * computes all messages of the junction tree.
+     */
+    void
+    calibrate();
+
+    /**
+     * Provides the number of cliques in the junction tree.
+     */
+    size_type
+    clique_count() const
+    {
+      return cliques_.size();
+    }
+
+    /**
+     * Provides the number of messages computed since the construction. A
+     * cached message is not counted again.
+     */
+    unsigned long
+    message_computations() const
+    {
+      return message_computations_;
+    }
+
+    /**
+     * Computes the distribution of the given node given the evidence in the
+     * network. Only the messages that are not cached yet are computed. For
+     * an evidence node, the result puts all probability on its observed
+     * value.
+     *
+     * @par Ensures:
+     * - The values of all random variables are restored.
+     *
+     * @param X node whose distribution should be computed
+     * @return the distribution of the variable of X given the evidence
+     * @throw std::out_of_range X is not a categorical node of the network.
+     */
+    CategoricalDistribution
+    marginal(const DiscreteNode& X);
+
+    /**
+     * Tells the compiled network that the evidence flag, the observed value
+     * or the probabilities of the given node have changed. Only the clique
+     * of the node and the messages sent away from it are invalidated.
+     *
+     * @param X node whose evidence or probabilities have changed
+     * @throw std::out_of_range X is not a categorical node of the network.
+     */
+    void
+    update(const DiscreteNode& X);
+
+  private:
+
+    class FamilyOfNode;
+
+    struct Clique
+    {
+      DiscreteFactor::Variables variables;
+      cont::vector<BayesianNetwork::iterator> nodes;
+      DiscreteFactor potential;
+      bool potential_valid;
+      cont::vector<size_type> neighbours;
+      /* Messages received from the neighbours in the same order. */
+      cont::vector<DiscreteFactor> messages;
+      cont::vector<bool> messages_valid;
+      DiscreteFactor belief;
+      bool belief_valid;
+    };
+
+    typedef cont::map<const DiscreteRandomVariable*, size_type> CliqueTable;
+
+    cont::vector<Clique> cliques_;
+    /* For every variable the smallest clique that contains it. */
+    CliqueTable home_cliques_;
+    /* For every variable the clique that holds the probabilities of its
+     * node. */
+    CliqueTable host_cliques_;
+    unsigned long message_computations_;
+
+    const DiscreteFactor&
+    belief(size_type c);
+
+    size_type
+    clique_of(const CliqueTable& table, const DiscreteNode& X) const;
+
+    /* Computes the missing messages toward the root of the order. */
+    void
+    collect(const cont::vector<size_type>& order,
+        const cont::vector<size_type>& parents);
+
+    /* Multiplies the potential and all messages of the clique. */
+    void
+    combine_belief(size_type c);
+
+    /* Computes the missing messages away from the root of the order. */
+    void
+    distribute(const cont::vector<size_type>& order,
+        const cont::vector<size_type>& parents);
+
+    void
+    invalidate_messages_from(size_type c);
+
+    /* Computes the message if it is not cached. All other messages into the
+     * clique from must be there. */
+    const DiscreteFactor&
+    message(size_type from, size_type to);
+
+    size_type
+    neighbour_index(size_type c, size_type neighbour) const;
+
+    const DiscreteFactor&
+    potential(size_type c);
+
+    /* Lists the cliques in breadth-first order from the root. parents
+     * receives the parent of every clique; the root has none (the number of
+     * cliques). */
+    void
+    tree_order(size_type root, cont::vector<size_type>& order,
+        cont::vector<size_type>& parents) const;
+
+  };
+
+} /* namespace cpprob */
+
+#endif /* COMPILEDNETWORK_HPP_ */
@@ -6,6 +6,7 @@
  */
 
 #include "ConditionalCategoricalNode.hpp"
+#include "ConditionalDirichletNode.hpp"
 
 using namespace std;
 
@@ -55,9 +56,8 @@ namespace cpprob
       const DiscreteRandomVariable& value,
       const DiscreteRandomReferences& condition,
       RandomConditionalProbabilities& cpt)
-      : DiscreteNode(value), is_evidence_(false), sampling_variate_(
-          random_number_engine, CategoricalDistribution()), condition_(
-          condition), probabilities_(cpt)
+      : DiscreteNode(value), is_evidence_(false), sampling_distribution_(), blanket_kernel_(),
+          condition_(condition), probabilities_(cpt), counter_(0)
   {
   }
 
@@ -66,7 +66,22 @@ namespace cpprob
   }
 
   void
-  ConditionalCategoricalNode::init_sampling()
+  ConditionalCategoricalNode::add_blanket_counts(float weight)
+  {
+    add_count(weight);
+    for (auto c = children().begin(); c != children().end(); ++c)
+      c->add_count(weight);
+  }
+
+  void
+  ConditionalCategoricalNode::add_count(float weight)
+  {
+    if (counter_ != 0)
+      counter_->add_count(condition_.joint_value(), value(), weight);
+  }
+
+  void
+  ConditionalCategoricalNode::init_sampling(RandomNumberEngine& rne)
   {
     /* Check requirements before accessing probabilities_.begin()->second. */
     cpprob_check_debug(
@@ -77,54 +92,87 @@ namespace cpprob
      * condition in probabilities_. This also initializes sampling_distribution.
      * ConditionalCategoricalNode::sample requires it to contain all possible
      * values of the DiscreteRandomVariable. */
-    CategoricalDistribution& sampling_distribution =
-        sampling_variate_.distribution();
+    CategoricalDistribution& sampling_distribution = sampling_distribution_;
     sampling_distribution.clear();
-    RandomProbabilities& probabilities_subset = probabilities_.begin()->second;
+    // Read the table as a constant; so a table in the dense layout stays.
+    const RandomConditionalProbabilities& probabilities = probabilities_;
+    const RandomConditionalProbabilities::Row probabilities_subset =
+        probabilities.begin()->second;
     auto p_it = probabilities_subset.begin();
     for (; p_it != probabilities_subset.end(); ++p_it)
       sampling_distribution[p_it->first] = p_it->second;
-    value() = sampling_variate_();
+    add_blanket_counts(-1.0f);
+    value() = draw_from(rne, sampling_distribution);
+    add_blanket_counts(1.0f);
+    blanket_kernel_.compile(value(), children());
   }
 
   void
-  ConditionalCategoricalNode::sample()
+  ConditionalCategoricalNode::sample(RandomNumberEngine& rne)
   {
     /* Get the variables and references that are necessary for all block below.
      * They come before the requirements tests because they are also needed
      * for these tests. */
-    auto& sampling_distribution = sampling_variate_.distribution();
+    auto& sampling_distribution = sampling_distribution_;
     auto d_end = sampling_distribution.end();
-    auto& conditioned_probabilities = probabilities_.at(
-        condition_.joint_value());
+    auto d_it = sampling_distribution.begin();
 
-    /* Check requirements. */
-    cpprob_check_debug(
-        sampling_distribution.size() == conditioned_probabilities.size(),
-        "ConditionalCategoricalNode: While sampling, the sampling distribution (size: " << sampling_distribution.size() << ") shows the wrong size compared to the conditional probability table(size: " << conditioned_probabilities.size() << ").");
+    /* In the collapsed mode, take this node out of the counts, so the
+     * probabilities are the predictive distribution given all other nodes. */
+    add_blanket_counts(-1.0f);
 
     /* Initialize the sampling distribution with the prior. */
-    auto d_it = sampling_distribution.begin();
-    auto p_it = conditioned_probabilities.begin();
-    for (; d_it != d_end; ++d_it, ++p_it)
-      d_it->second = p_it->second;
+    if (probabilities_.layout() == RandomConditionalProbabilities::dense_layout)
+    {
+      const float* p = probabilities_.row(condition_.joint_value());
+
+      /* Check requirements. */
+      if (p == 0)
+        cpprob_throw_out_of_range(
+            "ConditionalCategoricalNode: Could not find condition " << condition_.joint_value() << " in the probability table.");
+      cpprob_check_debug(
+          sampling_distribution.size() == probabilities_.row_size(),
+          "ConditionalCategoricalNode: While sampling, the sampling distribution (size: " << sampling_distribution.size() << ") shows the wrong size compared to the conditional probability table(size: " << probabilities_.row_size() << ").");
+
+      for (; d_it != d_end; ++d_it, ++p)
+        d_it->second = *p;
+    }
+    else
+    {
+      const RandomConditionalProbabilities& probabilities = probabilities_;
+      const auto conditioned_probabilities = probabilities.at(
+          condition_.joint_value());
+
+      /* Check requirements. */
+      cpprob_check_debug(
+          sampling_distribution.size() == conditioned_probabilities.size(),
+          "ConditionalCategoricalNode: While sampling, the sampling distribution (size: " << sampling_distribution.size() << ") shows the wrong size compared to the conditional probability table(size: " << conditioned_probabilities.size() << ").");
+
+      auto p_it = conditioned_probabilities.begin();
+      for (; d_it != d_end; ++d_it, ++p_it)
+        d_it->second = p_it->second;
+    }
 
-    /* Update the sampling distribution with the likelihoods. */
-    for (auto c = children().begin(); c != children().end(); ++c)
+    /* Update the sampling distribution with the likelihoods. The kernel
+     * must be compiled again if the probability tables of the children have
+     * changed since init_sampling. Children of collapsed parameter nodes
+     * are scored one after the other instead. */
+    if (MarkovBlanketKernel::has_collapsed_children(children()))
+    {
+      MarkovBlanketKernel::multiply_collapsed_likelihoods(value(), children(),
+          sampling_distribution);
+    }
+    else
     {
-      auto c_value = c->value();
-      auto& c_probabilities = c->probabilities();
-      auto c_condition = c->condition().sub_range(value()).begin();
-      d_it = sampling_distribution.begin();
-
-      for (; d_it != d_end; ++d_it, ++c_condition)
-        d_it->second *= c_probabilities.at(c_condition.joint_value()).at(
-            c_value);
+      if (!blanket_kernel_.is_current())
+        blanket_kernel_.compile(value(), children());
+      blanket_kernel_.multiply_likelihoods(sampling_distribution);
     }
     sampling_distribution.normalize();
 
     /* Draw from the distribution. */
-    value() = sampling_variate_();
+    value() = draw_from(rne, sampling_distribution);
+    add_blanket_counts(1.0f);
   }
 
 } /* namespace cpprob */
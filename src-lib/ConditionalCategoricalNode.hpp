@@ -31,12 +31,16 @@
 
 #include "CategoricalDistribution.hpp"
 #include "DiscreteNode.hpp"
+#include "MarkovBlanketKernel.hpp"
+#include "RandomNumberEngine.hpp"
 #include "DiscreteRandomReferences.hpp"
 #include "RandomConditionalProbabilities.hpp"
 
 namespace cpprob
 {
 
+  class ConditionalDirichletNode;
+
   class ConditionalCategoricalNode : public DiscreteNode
   {
 
@@ -49,10 +53,19 @@ namespace cpprob
     virtual
     ~ConditionalCategoricalNode();
 
+    /**
+     * Adds the weight to the count of the value and the condition value of
+     * this node in its counter, if it has one.
+     */
+    void
+    add_count(float weight);
+
     float
     at_references() const
     {
-      return probabilities_.at(condition_.joint_value()).at(value());
+      // Read the table as a constant, so a table in the dense layout stays.
+      const RandomConditionalProbabilities& probabilities = probabilities_;
+      return probabilities.at(condition_.joint_value()).at(value());
     }
 
     const DiscreteRandomReferences&
@@ -61,8 +74,25 @@ namespace cpprob
       return condition_;
     }
 
+    /**
+     * Provides the parameter node that keeps the count of the value of this
+     * node, or 0. The node updates the count while it samples; so do its
+     * parents when they change the condition value.
+     */
+    ConditionalDirichletNode*
+    counter() const
+    {
+      return counter_;
+    }
+
     void
-    init_sampling();
+    counter(ConditionalDirichletNode* node)
+    {
+      counter_ = node;
+    }
+
+    void
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
 
     bool
     is_evidence() const
@@ -89,20 +119,27 @@ namespace cpprob
     }
 
     void
-    sample();
+    sample(RandomNumberEngine& rne = random_number_engine);
 
   private:
 
     // Variables in common with CategoricalNode.
     bool is_evidence_;
-    std::variate_generator<RandomNumberEngine&, CategoricalDistribution> sampling_variate_;
+    CategoricalDistribution sampling_distribution_;
+    MarkovBlanketKernel blanket_kernel_;
     // Variables specific for this class.
     DiscreteRandomReferences condition_;
     RandomConditionalProbabilities& probabilities_;
+    ConditionalDirichletNode* counter_;
 
     friend std::ostream&
     operator<<(std::ostream& os, const ConditionalCategoricalNode& node);
 
+    /* Adds the weight to the counts of this node and its children in the
+     * collapsed mode. */
+    void
+    add_blanket_counts(float weight);
+
   };
 
 } /* namespace cpprob */
@@ -8,6 +8,7 @@
 #include "ConditionalDirichletNode.hpp"
 #include "ConditionalCategoricalNode.hpp"
 #include "DirichletDistribution.hpp"
+#include "PlateNode.hpp"
 
 using namespace std;
 
@@ -52,13 +53,19 @@ namespace cpprob
 
   ConditionalDirichletNode::ConditionalDirichletNode(
       const RandomConditionalProbabilities& value, float alpha)
-      : is_evidence_(false), value_(value)
+      : is_evidence_(false), is_collapsed_(false), value_(value), counts_(),
+          total_counts_(), counted_children_(0), forgetting_(1.0f),
+          observed_condition_(), observed_counts_(), observed_totals_(), observation_scale_(1.0)
   {
     /* Check the requirements. */
     if (value_.size() == 0)
       cpprob_throw_logic_error(
           "ConditionalDirichletNode: Cannot initialize a conditional Dirichlet node from an empty value.");
-    RandomProbabilities& pt = value_.begin()->second;
+    /* Take the values of the variable from the first row. A table in the
+     * dense layout is converted in a copy, so value_ keeps its layout. */
+    RandomConditionalProbabilities map_value(value_);
+    map_value.layout(RandomConditionalProbabilities::map_layout);
+    const RandomProbabilities& pt = map_value.begin()->second;
     if (pt.size() == 0)
       cpprob_throw_logic_error(
           "ConditionalDirichletNode: Cannot initialize a conditional Dirichlet node from an empty value.");
@@ -69,71 +76,150 @@ namespace cpprob
   }
 
   void
-  ConditionalDirichletNode::init_sampling()
+  ConditionalDirichletNode::add_count(const DiscreteRandomVariable& condition,
+      const DiscreteRandomVariable& var, float weight)
   {
-    /* Check the requirements.
-     * The range of the condition variable is taken from the children for the
+    if (condition.value_index() >= total_counts_.size())
+      return;
+
+    counts_[condition.value_index() * parameters_.size() + var.value_index()] += weight;
+    total_counts_[condition.value_index()] += weight;
+    if (is_collapsed_ && !is_evidence_)
+      refresh_row(condition);
+  }
+
+  DiscreteRandomVariable::Range
+  ConditionalDirichletNode::condition_range() const
+  {
+    /* The range of the condition variable is taken from the children for the
      * case that the range changed after construction. This happens,
      * for example, in infinite mixture models.
-     * Only if there are no children, I take the current value, which was given
-     * to the constructor. */
-    DiscreteRandomVariable::Range condition_range;
+     * Only if there are no children, I take the condition of a plate, of
+     * the observations or the current value, which was given to the
+     * constructor. */
     if (children_.size() != 0)
-    {
-      condition_range =
-          children().begin()->condition().joint_value().value_range();
-    }
+      return children().begin()->condition().joint_value().value_range();
+    else if (plates_.size() != 0)
+      return plates_.begin()->condition_range(*this);
+    else if (!observed_totals_.empty())
+      return observed_condition_.value_range();
     else if (value_.size() != 0)
-    {
-      condition_range = value().begin()->first.value_range();
-    }
+      return value().begin()->first.value_range();
     else
-    {
       cpprob_throw_logic_error(
           "ConditionalDirichletNode: Cannot sample a conditional Dirichlet node (name: " + value_.name() + ") from an empty value, if there are no children.");
+  }
+
+  void
+  ConditionalDirichletNode::count_children()
+  {
+    const Counters posterior = posterior_parameters();
+    counts_.clear();
+    total_counts_.clear();
+    for (auto row = posterior.begin(); row != posterior.end(); ++row)
+    {
+      float total = 0.0f;
+      for (auto p = row->second.begin(); p != row->second.end(); ++p)
+      {
+        counts_.push_back(p->second);
+        total += p->second;
+      }
+      total_counts_.push_back(total);
+    }
+    counted_children_ = children_.size();
+    for (auto c = children_.begin(); c != children_.end(); ++c)
+      c->counter(this);
+  }
+
+  void
+  ConditionalDirichletNode::forgetting(float factor)
+  {
+    if (!(factor > 0.0f && factor <= 1.0f))
+      cpprob_throw_invalid_argument(
+          "ConditionalDirichletNode: The forgetting factor must be in (0, 1].");
+    forgetting_ = factor;
+  }
+
+  void
+  ConditionalDirichletNode::init_sampling(RandomNumberEngine& rne)
+  {
+    const DiscreteRandomVariable::Range condition_range =
+        ConditionalDirichletNode::condition_range();
+
+    count_children();
+    if (is_collapsed_)
+    {
+      for (auto condition = condition_range.begin();
+          condition != condition_range.end(); ++condition)
+        refresh_row(condition);
+      return;
     }
 
     /* Set up the prior distribution. */
     DirichletDistribution sampling_distribution(parameters_.begin(),
         parameters_.end());
     variate_generator<RandomNumberEngine&, DirichletDistribution> sampling_variate_(
-        random_number_engine, sampling_distribution);
+        rne, sampling_distribution);
 
     /* Sample the conditional probabilities */
     for (auto condition = condition_range.begin();
         condition != condition_range.end(); ++condition)
     {
-      value_[condition] = sampling_variate_();
+      value_.set(condition, sampling_variate_());
     }
   }
 
   void
-  ConditionalDirichletNode::sample()
+  ConditionalDirichletNode::invalidate_counts()
   {
-    /* Check the requirements.
-     * The range of the condition variable is taken from the children for the
-     * case that the range changed after construction. This happens,
-     * for example, in infinite mixture models.
-     * Only if there are no children, I take the current value, which was given
-     * to the constructor. */
-    DiscreteRandomVariable::Range condition_range;
-    if (children_.size() != 0)
-    {
-      condition_range =
-          children().begin()->condition().joint_value().value_range();
-    }
-    else if (value_.size() != 0)
+    counts_.clear();
+    total_counts_.clear();
+  }
+
+  void
+  ConditionalDirichletNode::is_collapsed(bool value_is_collapsed)
+  {
+    is_collapsed_ = value_is_collapsed;
+  }
+
+  void
+  ConditionalDirichletNode::observe(const DiscreteRandomVariable& condition,
+      const DiscreteRandomVariable& var, float weight)
+  {
+    cpprob_check_debug(var.value_index() < parameters_.size(),
+        "ConditionalDirichletNode: The observed value is out of the range of the variable.");
+    /* The rows grow with the condition, which may grow in an infinite
+     * mixture. */
+    const size_t row_size = parameters_.size();
+    observed_condition_ = condition;
+    if (condition.value_index() >= observed_totals_.size())
     {
-      condition_range = value().begin()->first.value_range();
+      observed_counts_.resize((condition.value_index() + 1) * row_size, 0.0);
+      observed_totals_.resize(condition.value_index() + 1, 0.0);
     }
-    else
+
+    /* See DirichletNode::observe(). */
+    observation_scale_ *= forgetting_;
+    if (observation_scale_ < 1e-200)
     {
-      cpprob_throw_logic_error(
-          "ConditionalDirichletNode: Cannot sample a conditional Dirichlet node (name: " + value_.name() + ") from an empty value, if there are no children.");
+      for (auto c = observed_counts_.begin(); c != observed_counts_.end(); ++c)
+        *c *= observation_scale_;
+      for (auto t = observed_totals_.begin(); t != observed_totals_.end(); ++t)
+        *t *= observation_scale_;
+      observation_scale_ = 1.0;
     }
+    observed_counts_[condition.value_index() * row_size + var.value_index()] += weight
+        / observation_scale_;
+    observed_totals_[condition.value_index()] += weight / observation_scale_;
+  }
 
+  ConditionalDirichletNode::Counters
+  ConditionalDirichletNode::posterior_parameters() const
+  {
     /* Set up the counters and initialize them with the Dirichlet prior. */
-    DiscreteRandomVariableMap<Parameters> counters;
+    const DiscreteRandomVariable::Range condition_range =
+        ConditionalDirichletNode::condition_range();
+    Counters counters;
     for (auto condition = condition_range.begin();
         condition != condition_range.end(); ++condition)
     {
@@ -148,22 +234,83 @@ namespace cpprob
           child->condition().joint_value();
       counters[child_condition][child_var] += 1.0;
     }
+    for (auto p = plates_.begin(); p != plates_.end(); ++p)
+      p->add_counts(*this, counters, false);
 
-    /* Set up the sampling distribution and draw from it. */
-    for (auto counter_it = counters.begin(); counter_it != counters.end();
-        ++counter_it)
+    return counters;
+  }
+
+  float
+  ConditionalDirichletNode::probability(const DiscreteRandomVariable& var,
+      const DiscreteRandomVariable& condition) const
+  {
+    double alpha = 0.0;
+    double total = 0.0;
+    for (auto p = parameters_.begin(); p != parameters_.end(); ++p)
+    {
+      if (p->first == var)
+        alpha = p->second;
+      total += p->second;
+    }
+    double count = 0.0;
+    if (condition.value_index() < observed_totals_.size())
+    {
+      count = observed_counts_[condition.value_index() * parameters_.size()
+          + var.value_index()] * observation_scale_;
+      total += observed_totals_[condition.value_index()] * observation_scale_;
+    }
+    return total > 0.0 ? (alpha + count) / total : 1.0 / parameters_.size();
+  }
+
+  void
+  ConditionalDirichletNode::refresh_row(const DiscreteRandomVariable& condition)
+  {
+    /* The parameters are ordered by the values, like the counts. Without
+     * any count and a prior of 0, all values are equally probable. */
+    const size_t row_size = parameters_.size();
+    const float* count = &counts_[condition.value_index() * row_size];
+    const float total = total_counts_[condition.value_index()];
+    for (auto v = parameters_.begin(); v != parameters_.end(); ++v, ++count)
+      value_.set(v->first, condition,
+          total > 0.0f ? *count / total : 1.0f / row_size);
+  }
+
+  void
+  ConditionalDirichletNode::sample(RandomNumberEngine& rne)
+  {
+    const DiscreteRandomVariable::Range condition_range =
+        ConditionalDirichletNode::condition_range();
+    if (total_counts_.size() != condition_range.size()
+        || counted_children_ != children_.size() || plates_.size() != 0)
+      count_children();
+
+    if (is_collapsed_)
+    {
+      for (auto condition = condition_range.begin();
+          condition != condition_range.end(); ++condition)
+        refresh_row(condition);
+      return;
+    }
+
+    /* Set up the sampling distribution of every condition value from the
+     * counts and draw from it. */
+    Parameters row = parameters_;
+    auto count = counts_.begin();
+    for (auto condition = condition_range.begin();
+        condition != condition_range.end(); ++condition)
     {
-      DirichletDistribution sample_distribution(counter_it->second.begin(),
-          counter_it->second.end());
+      for (auto p = row.begin(); p != row.end(); ++p, ++count)
+        p->second = *count;
+      DirichletDistribution sample_distribution(row.begin(), row.end());
       variate_generator<RandomNumberEngine&, DirichletDistribution> sampling_variate_(
-          random_number_engine, sample_distribution);
-      value_[counter_it->first] = sampling_variate_();
+          rne, sample_distribution);
+      value_.set(condition, sampling_variate_());
     }
   }
 
   void
   ConditionalDirichletNode::sample(const DiscreteRandomVariable& condition,
-      const Children& children)
+      const Children& children, RandomNumberEngine& rne)
   {
     /* Set up the counters and initialize them with the Dirichlet prior. */
     Parameters counters = parameters_;
@@ -175,8 +322,8 @@ namespace cpprob
     /* Set up the sampling distribution and draw from it. */
     DirichletDistribution sample_distribution(counters.begin(), counters.end());
     std::variate_generator<RandomNumberEngine&, DirichletDistribution> sampling_variate_(
-        random_number_engine, sample_distribution);
-    value_[condition] = sampling_variate_();
+        rne, sample_distribution);
+    value_.set(condition, sampling_variate_());
   }
 
 } /* namespace cpprob */
@@ -34,6 +34,8 @@
 namespace cpprob
 {
 
+  class PlateNode;
+
   class ConditionalDirichletNode
   {
 
@@ -41,6 +43,7 @@ namespace cpprob
 
     typedef cont::RefVector<ConditionalCategoricalNode> Children;
     typedef DiscreteRandomVariableMap<float> Parameters;
+    typedef cont::RefVector<PlateNode> Plates;
 
     ConditionalDirichletNode(const RandomConditionalProbabilities& value,
         float alpha);
@@ -48,6 +51,20 @@ namespace cpprob
     // Use the implicit destructor, so the implicit copy and move operations
     // are generated by the compiler.
 
+    /**
+     * Adds the weight to the count of the given value under the given
+     * condition value. The children call this with -1 and +1 while their
+     * values change, and so do their parents while the condition values
+     * change. In the collapsed mode, the rows of the value of this node
+     * follow the counts.
+     *
+     * The counts are set up by init_sampling(). Until then, and after
+     * invalidate_counts(), the call has no effect.
+     */
+    void
+    add_count(const DiscreteRandomVariable& condition,
+        const DiscreteRandomVariable& var, float weight);
+
     Children&
     children()
     {
@@ -60,8 +77,75 @@ namespace cpprob
       return children_;
     }
 
+    /**
+     * Provides the factor of exponential forgetting. See
+     * DirichletNode::forgetting(float).
+     */
+    float
+    forgetting() const
+    {
+      return forgetting_;
+    }
+
+    /**
+     * Sets the factor of exponential forgetting. It applies to the
+     * observations of all condition values. See
+     * DirichletNode::forgetting(float).
+     *
+     * @throw std::invalid_argument The factor is not in (0, 1].
+     */
+    void
+    forgetting(float factor);
+
+    void
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
+
+    /**
+     * Drops the counts of the children, so the next sample() counts all
+     * children again. Call this if children change in a way that does not
+     * go through add_count(), e.g. if the range of the condition grows.
+     */
+    void
+    invalidate_counts();
+
+    /**
+     * Tells whether the probabilities are integrated out while sampling.
+     * See DirichletNode::is_collapsed(bool).
+     */
+    bool
+    is_collapsed() const
+    {
+      return is_collapsed_;
+    }
+
+    /**
+     * Switches the collapsed mode of Gibbs sampling on or off. It works like
+     * DirichletNode::is_collapsed(bool), with the counts kept per condition
+     * value.
+     */
+    void
+    is_collapsed(bool value_is_collapsed);
+
+    /**
+     * Folds an observation of the given value under the given condition
+     * value into the running counts of this node, in constant time. See
+     * DirichletNode::observe().
+     */
     void
-    init_sampling();
+    observe(const DiscreteRandomVariable& condition,
+        const DiscreteRandomVariable& var, float weight = 1.0f);
+
+    /**
+     * Observes every pair of a condition value and a value in the range.
+     * See observe().
+     */
+    template<class Iterator>
+      void
+      observe_batch(Iterator begin, Iterator end)
+      {
+        for (; begin != end; ++begin)
+          observe(begin->first, begin->second);
+      }
 
     Parameters&
     parameters()
@@ -75,12 +159,37 @@ namespace cpprob
       return parameters_;
     }
 
+    /**
+     * Provides the plates with template variables of this parameter node.
+     * Their rows count like children for learning and sampling.
+     */
+    Plates&
+    plates()
+    {
+      return plates_;
+    }
+
+    const Plates&
+    plates() const
+    {
+      return plates_;
+    }
+
+    /**
+     * Provides the current estimate of the probability of the value given
+     * the condition value from the Dirichlet parameters and the
+     * observations. See DirichletNode::probability().
+     */
+    float
+    probability(const DiscreteRandomVariable& var,
+        const DiscreteRandomVariable& condition) const;
+
     void
-    sample();
+    sample(RandomNumberEngine& rne = random_number_engine);
 
     void
     sample(const DiscreteRandomVariable& condition,
-        const Children& children);
+        const Children& children, RandomNumberEngine& rne);
 
     RandomConditionalProbabilities&
     value()
@@ -108,10 +217,40 @@ namespace cpprob
 
   private:
 
+    friend class BayesianNetwork;
+
+    typedef DiscreteRandomVariableMap<Parameters> Counters;
+
     bool is_evidence_;
+    bool is_collapsed_;
     Children children_;
+    Plates plates_;
     RandomConditionalProbabilities value_;
     Parameters parameters_;
+    /* Dirichlet parameters plus the counts of the children, one row per
+     * condition index, and the sums of the rows. See DirichletNode. */
+    cont::vector<float> counts_;
+    cont::vector<float> total_counts_;
+    std::size_t counted_children_;
+    /* Counts of the observations, one row per condition index, and the
+     * sums of the rows. See DirichletNode. */
+    float forgetting_;
+    DiscreteRandomVariable observed_condition_;
+    cont::vector<double> observed_counts_;
+    cont::vector<double> observed_totals_;
+    double observation_scale_;
+
+    DiscreteRandomVariable::Range
+    condition_range() const;
+
+    void
+    count_children();
+
+    Counters
+    posterior_parameters() const;
+
+    void
+    refresh_row(const DiscreteRandomVariable& condition);
 
     friend std::ostream&
     operator<<(std::ostream& os, const ConditionalDirichletNode& node);
@@ -8,6 +8,7 @@
 #include "DirichletNode.hpp"
 #include "CategoricalNode.hpp"
 #include "DirichletDistribution.hpp"
+#include "PlateNode.hpp"
 
 using namespace std;
 
@@ -50,7 +51,9 @@ namespace cpprob
   }
 
   DirichletNode::DirichletNode(const RandomProbabilities& value, float alpha)
-      : is_evidence_(false), value_(value)
+      : is_evidence_(false), is_collapsed_(false), value_(value), counts_(),
+          total_count_(0.0f), counted_children_(0), forgetting_(1.0f),
+          observed_counts_(), observed_total_(0.0), observation_scale_(1.0)
   {
     for (RandomProbabilities::iterator v_it = value_.begin();
         v_it != value_.end(); ++v_it)
@@ -60,30 +63,160 @@ namespace cpprob
   }
 
   void
-  DirichletNode::init_sampling()
+  DirichletNode::add_count(const DiscreteRandomVariable& var, float weight)
   {
+    if (counts_.empty())
+      return;
+
+    counts_[var.value_index()] += weight;
+    total_count_ += weight;
+    if (is_collapsed_ && !is_evidence_)
+      refresh_value();
+  }
+
+  void
+  DirichletNode::count_children()
+  {
+    const Parameters posterior = posterior_parameters();
+    counts_.clear();
+    total_count_ = 0.0f;
+    for (auto p = posterior.begin(); p != posterior.end(); ++p)
+    {
+      counts_.push_back(p->second);
+      total_count_ += p->second;
+    }
+    counted_children_ = children_.size();
+    for (auto c = children_.begin(); c != children_.end(); ++c)
+      c->counter(this);
+  }
+
+  void
+  DirichletNode::forgetting(float factor)
+  {
+    if (!(factor > 0.0f && factor <= 1.0f))
+      cpprob_throw_invalid_argument(
+          "DirichletNode: The forgetting factor must be in (0, 1].");
+    forgetting_ = factor;
+  }
+
+  void
+  DirichletNode::init_sampling(RandomNumberEngine& rne)
+  {
+    count_children();
+    if (is_collapsed_)
+    {
+      refresh_value();
+      return;
+    }
+
     value_.clear();
     DirichletDistribution sampling_distribution(parameters_.begin(),
         parameters_.end());
     variate_generator<RandomNumberEngine&, DirichletDistribution> sampling_variate_(
-        random_number_engine, sampling_distribution);
+        rne, sampling_distribution);
     value_ = sampling_variate_();
   }
 
   void
-  DirichletNode::sample()
+  DirichletNode::invalidate_counts()
   {
-    DirichletDistribution sample_distribution(parameters_.begin(),
-        parameters_.end());
+    counts_.clear();
+    total_count_ = 0.0f;
+  }
+
+  void
+  DirichletNode::is_collapsed(bool value_is_collapsed)
+  {
+    is_collapsed_ = value_is_collapsed;
+  }
 
+  void
+  DirichletNode::observe(const DiscreteRandomVariable& var, float weight)
+  {
+    cpprob_check_debug(var.value_index() < parameters_.size(),
+        "DirichletNode: The observed value is out of the range of the variable.");
+    if (observed_counts_.empty())
+      observed_counts_.assign(parameters_.size(), 0.0);
+
+    /* Forgetting scales down all earlier counts at once. When the scale
+     * gets too small, it is moved into the counts. */
+    observation_scale_ *= forgetting_;
+    if (observation_scale_ < 1e-200)
+    {
+      for (auto c = observed_counts_.begin(); c != observed_counts_.end(); ++c)
+        *c *= observation_scale_;
+      observed_total_ *= observation_scale_;
+      observation_scale_ = 1.0;
+    }
+    observed_counts_[var.value_index()] += weight / observation_scale_;
+    observed_total_ += weight / observation_scale_;
+  }
+
+  DirichletNode::Parameters
+  DirichletNode::posterior_parameters() const
+  {
+    Parameters posterior = parameters_;
     for (auto c = children_.begin(); c != children_.end(); ++c)
+      posterior[c->value()] += 1.0;
+    for (auto p = plates_.begin(); p != plates_.end(); ++p)
+      p->add_counts(*this, posterior, false);
+    return posterior;
+  }
+
+  float
+  DirichletNode::probability(const DiscreteRandomVariable& var) const
+  {
+    double alpha = 0.0;
+    double total = 0.0;
+    for (auto p = parameters_.begin(); p != parameters_.end(); ++p)
+    {
+      if (p->first == var)
+        alpha = p->second;
+      total += p->second;
+    }
+    double count = 0.0;
+    if (!observed_counts_.empty())
+    {
+      count = observed_counts_[var.value_index()] * observation_scale_;
+      total += observed_total_ * observation_scale_;
+    }
+    return total > 0.0 ? (alpha + count) / total : 1.0 / parameters_.size();
+  }
+
+  void
+  DirichletNode::refresh_value()
+  {
+    /* The counts are ordered by the values. Without any count and a prior
+     * of 0, all values are equally probable. */
+    auto count = counts_.begin();
+    auto v = parameters_.begin();
+    for (; v != parameters_.end(); ++v, ++count)
+      value_[v->first] =
+          total_count_ > 0.0f ? *count / total_count_ : 1.0f / counts_.size();
+  }
+
+  void
+  DirichletNode::sample(RandomNumberEngine& rne)
+  {
+    if (counts_.empty() || counted_children_ != children_.size()
+        || plates_.size() != 0)
+      count_children();
+    if (is_collapsed_)
     {
-      const DiscreteRandomVariable& c_var = c->value();
-      sample_distribution.parameters()[c_var] += 1.0;
+      refresh_value();
+      return;
     }
 
+    /* Set up the sampling distribution from the counts and draw from it. */
+    Parameters posterior = parameters_;
+    auto count = counts_.begin();
+    for (auto p = posterior.begin(); p != posterior.end(); ++p, ++count)
+      p->second = *count;
+    DirichletDistribution sample_distribution(posterior.begin(),
+        posterior.end());
+
     variate_generator<RandomNumberEngine&, DirichletDistribution> sampling_variate_(
-        random_number_engine, sample_distribution);
+        rne, sample_distribution);
     value_ = sampling_variate_();
   }
 
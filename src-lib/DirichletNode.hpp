@@ -33,6 +33,8 @@
 namespace cpprob
 {
 
+  class PlateNode;
+
   /*
    *
    */
@@ -44,12 +46,24 @@ namespace cpprob
 
     typedef cont::RefVector<CategoricalNode> Children;
     typedef DiscreteRandomVariableMap<float> Parameters;
+    typedef cont::RefVector<PlateNode> Plates;
 
     DirichletNode(const RandomProbabilities& value, float alpha);
 
     // Use the implicit destructor, so the implicit copy and move operations
     // are generated by the compiler.
 
+    /**
+     * Adds the weight to the count of the given value. The children call
+     * this with -1 and +1 while they sample a new value. In the collapsed
+     * mode, the value of this node follows the counts.
+     *
+     * The counts are set up by init_sampling(). Until then, and after
+     * invalidate_counts(), the call has no effect.
+     */
+    void
+    add_count(const DiscreteRandomVariable& var, float weight);
+
     Children&
     children()
     {
@@ -62,8 +76,79 @@ namespace cpprob
       return children_;
     }
 
+    /**
+     * Provides the factor by which the observations are discounted with
+     * every new observation. See forgetting(float).
+     */
+    float
+    forgetting() const
+    {
+      return forgetting_;
+    }
+
+    /**
+     * Sets the factor of exponential forgetting. Before every observation,
+     * the counts of the earlier observations are multiplied by this factor.
+     * So the estimate follows a drifting source. A factor of 1 (the
+     * default) keeps all observations.
+     *
+     * @throw std::invalid_argument The factor is not in (0, 1].
+     */
+    void
+    forgetting(float factor);
+
+    void
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
+
+    /**
+     * Drops the counts of the children, so the next sample() counts all
+     * children again. Call this if children change in a way that does not
+     * go through add_count().
+     */
+    void
+    invalidate_counts();
+
+    /**
+     * Tells whether the probabilities are integrated out while sampling.
+     * See is_collapsed(bool).
+     */
+    bool
+    is_collapsed() const
+    {
+      return is_collapsed_;
+    }
+
+    /**
+     * Switches the collapsed mode of Gibbs sampling on or off. In the
+     * collapsed mode, the node does not draw its probabilities from the
+     * Dirichlet posterior. Its value is the predictive distribution
+     * (counts + alpha) / (N + sum alpha) instead. A child takes its own
+     * value out of the counts before it samples and puts the new value back
+     * afterwards. So the children are sampled from the Dirichlet-multinomial
+     * predictive without any gamma variates.
+     */
     void
-    init_sampling();
+    is_collapsed(bool value_is_collapsed);
+
+    /**
+     * Folds an observation of the given value into the running counts of
+     * this node, in constant time. The observations need no nodes in the
+     * network. They count like evidence children for learn() and
+     * probability().
+     */
+    void
+    observe(const DiscreteRandomVariable& var, float weight = 1.0f);
+
+    /**
+     * Observes every value in the range. See observe().
+     */
+    template<class Iterator>
+      void
+      observe_batch(Iterator begin, Iterator end)
+      {
+        for (; begin != end; ++begin)
+          observe(*begin);
+      }
 
     Parameters&
     parameters()
@@ -77,8 +162,33 @@ namespace cpprob
       return parameters_;
     }
 
+    /**
+     * Provides the plates with template variables of this parameter node.
+     * Their rows count like children for learning and sampling.
+     */
+    Plates&
+    plates()
+    {
+      return plates_;
+    }
+
+    const Plates&
+    plates() const
+    {
+      return plates_;
+    }
+
+    /**
+     * Provides the current estimate of the probability of the value from
+     * the Dirichlet parameters and the observations, i.e.
+     * (alpha + count) / (sum alpha + N). This does not consider the
+     * children; use learn() for them.
+     */
+    float
+    probability(const DiscreteRandomVariable& var) const;
+
     void
-    sample();
+    sample(RandomNumberEngine& rne = random_number_engine);
 
     RandomProbabilities&
     value()
@@ -106,13 +216,40 @@ namespace cpprob
 
   private:
 
+    friend class BayesianNetwork;
+
     friend std::ostream&
     operator<<(std::ostream& os, const DirichletNode& node);
 
     bool is_evidence_;
+    bool is_collapsed_;
     Children children_;
+    Plates plates_;
     Parameters parameters_;
     RandomProbabilities value_;
+    /* Dirichlet parameters plus the counts of the children per value index
+     * and their sum. The children keep them up to date, so sample() needs
+     * not visit them. Empty if the children must be counted again. With
+     * plates, every sample() counts again, because the latent values of
+     * plates change without add_count(). */
+    cont::vector<float> counts_;
+    float total_count_;
+    std::size_t counted_children_;
+    /* Counts of the observations per value index and their sum, both
+     * divided by observation_scale_. Forgetting changes only the scale. */
+    float forgetting_;
+    cont::vector<double> observed_counts_;
+    double observed_total_;
+    double observation_scale_;
+
+    void
+    count_children();
+
+    Parameters
+    posterior_parameters() const;
+
+    void
+    refresh_value();
 
   };
 
@@ -9,6 +9,9 @@
 #include "CategoricalDistribution.hpp"
 #include "RandomInteger.hpp"
 #include "RandomNumberEngine.hpp"
+#include "cont/vector.hpp"
+#include <cmath>
+#include <limits>
 
 using namespace std;
 
@@ -44,61 +47,88 @@ namespace cpprob
   {
   }
 
+  DirichletProcessNode::DirichletProcessNode(
+      DirichletProcessParameters& parameters,
+      const DiscreteRandomVariable& component)
+      : DiscreteNode(component), parameters_(parameters)
+  {
+  }
+
   void
-  DirichletProcessNode::init_sampling()
+  DirichletProcessNode::init_sampling(RandomNumberEngine& rne)
   {
     auto prior_distribution = compile_prior_distribution();
 
     /* Draw from the prior distribution. */
     variate_generator<RandomNumberEngine&, CategoricalDistribution> sampling_variate(
-        random_number_engine, prior_distribution);
+        rne, prior_distribution);
     DiscreteRandomVariable sample = sampling_variate();
 
     /* Create a new mixture component if necessary */
+    add_children_counts(-1.0f);
     if (sample != value().value_range().end())
       value() = sample;
     else
-      value() = parameters_.create_component(children());
+      value() = parameters_.create_component(children(), rne);
+    add_children_counts(1.0f);
 
     /* Adjust the counters */
     parameters_.component_counters_[value()] += 1;
 
   }
 
+  void
+  DirichletProcessNode::add_children_counts(float weight)
+  {
+    for (auto c = children().begin(); c != children().end(); ++c)
+      c->add_count(weight);
+  }
+
   CategoricalDistribution
   DirichletProcessNode::compile_posterior_distribution()
   {
     DirichletProcessParameters::ComponentCounters& counters =
         parameters_.component_counters_;
 
-    /* Compile the posterior distribution for the used components. */
-    CategoricalDistribution distribution;
-    float p = 0.0;
+    /* Compile the posterior distribution in the log domain: The products
+     * over many children underflow in float. */
+    cont::vector<double> log_p;
     for (auto count = counters.begin(); count != counters.end(); ++count)
     {
       // The prior
-      p = static_cast<float>(count->second);
+      double log_p_component = log(static_cast<double>(count->second));
 
       // The factors of the posterior update
       value() = count->first;
       for (auto c = children().begin(); c != children().end(); ++c)
-      {
-        p *= c->at_references();
-      }
+        log_p_component += log(c->at_references());
+      log_p.push_back(log_p_component);
+    }
+
+    /* The unused component: the prior and the posterior update. */
+    log_p.push_back(
+        log(parameters_.concentration())
+            + parameters_.log_prior_probability_of_managed_nodes(children()));
+
+    /* Scale the largest probability to 1 before leaving the log domain. */
+    double max_log_p = -numeric_limits<double>::infinity();
+    for (auto l = log_p.begin(); l != log_p.end(); ++l)
+      max_log_p = std::max(max_log_p, *l);
+    if (max_log_p == -numeric_limits<double>::infinity())
+      max_log_p = 0.0;
 
-      auto insert_result = distribution.insert(make_pair(value(), p));
+    CategoricalDistribution distribution;
+    auto l = log_p.begin();
+    for (auto count = counters.begin(); count != counters.end(); ++count, ++l)
+    {
+      auto insert_result = distribution.insert(
+          make_pair(count->first, static_cast<float>(exp(*l - max_log_p))));
       cpprob_check_debug(
           insert_result.second,
           "DirichletProcessNode: Could not insert a counter into the distribution during sampling.");
     }
-
-    /* Compile the posterior distribution for the unused component. */
-    // The prior
-    p = parameters_.concentration();
-    // The posterior update
-    p *= parameters_.prior_probability_of_managed_nodes(children());
     auto value_range_end = value().value_range().end();
-    distribution[value_range_end] = p;
+    distribution[value_range_end] = static_cast<float>(exp(*l - max_log_p));
 
     distribution.normalize();
 
@@ -124,23 +154,29 @@ namespace cpprob
   }
 
   void
-  DirichletProcessNode::sample()
+  DirichletProcessNode::sample(RandomNumberEngine& rne)
   {
+    /* The blocked sampler of the parameters draws all nodes at once. */
+    if (parameters_.truncation() != 0)
+      return;
+
     parameters_.component_counters_[value()] -= 1;
+    add_children_counts(-1.0f);
 
     auto distribution = compile_posterior_distribution();
 
     /* Draw from the posterior distribution. */
     variate_generator<RandomNumberEngine&, CategoricalDistribution> sampling_variate(
-        random_number_engine, distribution);
+        rne, distribution);
     DiscreteRandomVariable sample = sampling_variate();
 
     if (sample != value().value_range().end())
       value() = sample;
     else
-      value() = parameters_.next_component(children());
+      value() = parameters_.next_component(children(), rne);
 
     parameters_.component_counters_[value()] += 1;
+    add_children_counts(1.0f);
   }
 
   CategoricalDistribution
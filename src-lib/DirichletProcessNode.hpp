@@ -46,12 +46,20 @@ namespace cpprob
 
     DirichletProcessNode(DirichletProcessParameters& parameters);
 
+    /**
+     * Creates a node with the given component, like the copy of a network
+     * does. Unlike the other constructor, it keeps the number of components
+     * of the component variable.
+     */
+    DirichletProcessNode(DirichletProcessParameters& parameters,
+        const DiscreteRandomVariable& component);
+
     ~DirichletProcessNode()
     {
     }
 
     void
-    init_sampling();
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
 
     bool
     is_evidence() const
@@ -78,15 +86,22 @@ namespace cpprob
     prior_distribution();
 
     void
-    sample();
+    sample(RandomNumberEngine& rne = random_number_engine);
 
   private:
 
+    friend class DirichletProcessParameters;
+
     friend std::ostream&
     operator<<(std::ostream& os, const DirichletProcessNode& node);
 
     DirichletProcessParameters& parameters_;
 
+    /* Adds the weight to the counts of the children in their parameter
+     * nodes, before and after the condition values change. */
+    void
+    add_children_counts(float weight);
+
     CategoricalDistribution
     compile_posterior_distribution();
 
@@ -7,10 +7,18 @@
 
 #include "DirichletProcessParameters.hpp"
 #include "ConditionalDirichletNode.hpp"
+#include "DirichletProcessNode.hpp"
 #include "DiscreteJointRandomVariable.hpp"
 #include "RandomInteger.hpp"
+#include "RandomNumberEngine.hpp"
 #include "cont/vector.hpp"
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <limits>
 #include <ostream>
+#include <thread>
 
 using namespace std;
 
@@ -29,14 +37,17 @@ namespace cpprob
       std::initializer_list<ConditionalDirichletNode*> managed_nodes)
       : component_counters_(), component_name_(name), concentration_(
           concentration), managed_nodes_(managed_nodes.begin(),
-          managed_nodes.end()), parameters_name_(name + "Parameters")
+          managed_nodes.end()), parameters_name_(name + "Parameters"),
+          log_prior_cache_(), split_merge_interval_(0), split_merge_moves_(1),
+          sweeps_since_split_merge_(0), truncation_(0), max_tail_mass_(0.01f),
+          tail_mass_(0.0), is_tail_mass_warned_(false), sampling_threads_(1)
   {
   }
 #endif
 
   DiscreteRandomVariable
   DirichletProcessParameters::create_component(
-      const Children& children_of_component)
+      const Children& children_of_component, RandomNumberEngine& rne)
   {
     auto old_range = RandomInteger(component_name_ + "_old",
         component_counters_.size(), 0).value_range();
@@ -57,7 +68,9 @@ namespace cpprob
         if (&child->probabilities() == &node->value())
           children_of_node[new_component].push_back(*child);
       }
-      extend_managed_node(*node, old_range, new_range, children_of_node);
+      extend_managed_node(*node, old_range, new_range, children_of_node, rne);
+      // The indices of the joint condition values have changed.
+      node->invalidate_counts();
     }
     return new_component;
   }
@@ -67,7 +80,7 @@ namespace cpprob
       ConditionalDirichletNode& node,
       const DiscreteRandomVariable::Range& old_range,
       const DiscreteRandomVariable::Range&,
-      const ChildrenOfComponent& children_of_node)
+      const ChildrenOfComponent& children_of_node, RandomNumberEngine& rne)
   {
     /**
      * @todo Refactor around children_of_node.
@@ -81,114 +94,132 @@ namespace cpprob
         node.children().begin() != node.children().end(),
         "DirichletProcessParameters: Cannot extend a ConditionalDirichletNode without children.");
 
-    /* Construct a joint reference to the extended condition
-     * (with the new component), condition_refs, and a joint reference with the
-     * old condition set, tmp_old_condition_vars. */
-    auto node_children_it = node.children().begin();
+    /* The index of a joint condition value is
+     *   low + component * low_size + high * low_size * component_size,
+     * where low and high are the joint values of the condition variables
+     * before and after the component in the order of the names. The own
+     * variable is already the extended variable. */
     const DiscreteRandomReferences& condition_refs =
-        node_children_it->condition();
-
-    RandomInteger old_self_condition(old_range.end());
-    DiscreteRandomReferences old_condition_refs;
-    if (old_range.size() != 0)
-    {
-      --old_self_condition;
-      old_condition_refs.insert(old_self_condition);
-    }
-    const RandomInteger last_old_self_condition(old_self_condition);
-
-    DiscreteJointRandomVariable::iterator new_self_condition;
-    DiscreteJointRandomVariable new_condition;
-
+        node.children().begin()->condition();
+    DiscreteJointRandomVariable condition_var;
+    size_t low_size = 1;
+    size_t new_size = 0;
+    size_t high_size = 1;
+    bool is_high = false;
     for (auto var = condition_refs.begin(); var != condition_refs.end(); ++var)
     {
       cpprob_check_debug(
           var->value_range().size() != 0,
           "DirichletProcessParameters: Cannot make a joint condition with the empty variable " << var->name() << ".");
 
-      /* Insert all variable with their last value. So I can step backwards in
-       * the end. The variable of the own node is already the extended variable.
-       * So it only comes in the container of the new condition. The container
-       * of the old condition already contains a variable for the own node
-       * with the old value range. It has been inserted above. */
+      auto insert_result = condition_var.insert(var->value_range().begin());
+      cpprob_check_debug(
+          insert_result.second,
+          "DirichletProcessParameters: Could not insert the variable " << var->value_range().begin() << " in the condition set " << condition_var << ".");
       if (var->name() == component_name_)
       {
-        // This condition variable comes only in the new condition container.
-        // It is the extended variable.
-        auto self_init_value = var->value_range().end();
-        --self_init_value;
-        new_self_condition = new_condition.insert(self_init_value).first;
+        new_size = var->value_range().size();
+        is_high = true;
       }
+      else if (is_high)
+        high_size *= var->value_range().size();
       else
+        low_size *= var->value_range().size();
+    }
+    const size_t old_size = old_range.size();
+    RandomConditionalProbabilities& probability_table = node.value();
+    RandomInteger old_condition(condition_var);
+    RandomInteger new_condition(condition_var);
+    const bool is_dense = probability_table.layout()
+        == RandomConditionalProbabilities::dense_layout;
+    RandomProbabilities row(node.children().begin()->value());
+
+    /* set() keeps the dense layout only in existing rows and in the row
+     * after the last one. The moves and the samples below write from the
+     * back; so a dense table gets all its new rows first. */
+    if (is_dense)
+    {
+      for (size_t index = probability_table.size();
+          index < low_size * new_size * high_size; ++index)
       {
-        auto init_value = var->value_range().end();
-        --init_value;
-        auto insert_result = new_condition.insert(init_value);
-        cpprob_check_debug(
-            insert_result.second,
-            "DirichletProcessParameters: Could not insert the variable " << init_value << " in the condition set " << new_condition << ".");
-        auto condition_var = insert_result.first;
-        old_condition_refs.insert(*condition_var);
+        new_condition.observation(index);
+        probability_table.set(new_condition, row);
       }
     }
-    const DiscreteRandomVariable tmp_condition_begin =
-        new_condition.value_range().begin();
-    DiscreteRandomVariable::ValueLess value_less;
 
-    while (1)
+    /* Move the rows whose index changes, from the back, so that no row is
+     * overwritten before it has moved. The rows of the first high value
+     * keep their index. So if the component is the last condition variable
+     * in the order of the names, no row moves and the table only grows. A
+     * row of the map layout is swapped; a row of the dense layout is copied
+     * through its constant view, because a non-const access to a whole row
+     * converts the table to the map layout. */
+    const RandomConditionalProbabilities& rows = probability_table;
+    for (size_t high = high_size; high-- > 1;)
     {
-      /* Update or insert the probabilities of the current condition. */
-      if (old_range.size() == 0
-          || value_less(last_old_self_condition, *new_self_condition))
+      for (size_t c = old_size; c-- != 0;)
       {
-        auto found_children = children_of_node.find(*new_self_condition);
-        if (found_children == children_of_node.end())
-          node.sample(new_condition, Children());
-        else
-          node.sample(new_condition, found_children->second);
+        for (size_t low = low_size; low-- != 0;)
+        {
+          const size_t offset = low + c * low_size;
+          old_condition.observation(offset + high * low_size * old_size);
+          new_condition.observation(offset + high * low_size * new_size);
+          if (is_dense)
+          {
+            const RandomConditionalProbabilities::Row old_row = rows.at(
+                old_condition);
+            for (auto p = old_row.begin(); p != old_row.end(); ++p)
+              row[p->first] = p->second;
+            probability_table.set(new_condition, row);
+          }
+          else
+            swap(probability_table[new_condition],
+                probability_table[old_condition]);
+        }
       }
-      else
+    }
+
+    /* Sample the rows of the new components, from the back like the
+     * moves. The children are the same for all new components. */
+    const Children no_children;
+    const Children& children =
+        children_of_node.empty() ? no_children : children_of_node.begin()->second;
+    for (size_t high = high_size; high-- != 0;)
+    {
+      for (size_t c = new_size; c-- != old_size;)
       {
-        size_t self_value = RandomInteger(*new_self_condition).observation();
-        old_self_condition.observation(self_value);
-        size_t old_value =
-            RandomInteger(old_condition_refs.joint_value()).observation();
-        RandomInteger old_condition(new_condition);
-        old_condition.observation(old_value);
-        RandomConditionalProbabilities& probability_table = node.value();
-        /* @todo Better with swap? */
-        probability_table[new_condition] = probability_table[old_condition];
+        for (size_t low = low_size; low-- != 0;)
+        {
+          new_condition.observation(
+              low + c * low_size + high * low_size * new_size);
+          node.sample(new_condition, children, rne);
+        }
       }
-
-      if (new_condition == tmp_condition_begin)
-        break;
-      else
-        --new_condition;
     }
   }
 
   DiscreteRandomVariable
   DirichletProcessParameters::next_component(
-      const Children& children_of_component)
+      const Children& children_of_component, RandomNumberEngine& rne)
   {
     for (auto it = component_counters_.begin(); it != component_counters_.end();
         ++it)
     {
       if (it->second == 0)
       {
-        sample_managed_nodes(it->first, children_of_component);
+        sample_managed_nodes(it->first, children_of_component, rne);
         return it->first;
       }
     }
 
-    return create_component(children_of_component);
+    return create_component(children_of_component, rne);
   }
 
-  float
-  DirichletProcessParameters::prior_probability_of_managed_nodes(
+  double
+  DirichletProcessParameters::log_prior_probability_of_managed_nodes(
       const Children& children_of_component) const
   {
-    float p = 1.0;
+    double log_p = 0.0;
     for (auto node = managed_nodes_.begin(); node != managed_nodes_.end();
         ++node)
     {
@@ -199,46 +230,64 @@ namespace cpprob
         if (&child->probabilities() == &node->value())
           child_counters[child->value()] += 1;
       }
-      p *= prior_probability_of_managed_node(*node, child_counters);
+      log_p += log_prior_probability_of_managed_node(*node, child_counters);
     }
-    return p;
+    return log_p;
   }
 
-  float
-  DirichletProcessParameters::prior_probability_of_managed_node(
-      const ConditionalDirichletNode& node, ComponentCounters counters) const
+  double
+  DirichletProcessParameters::log_prior_probability_of_managed_node(
+      const ConditionalDirichletNode& node,
+      const ComponentCounters& counters) const
   {
-    float sum_parameters = 0.0;
-    size_t sum_counters = 0;
-    float nominator = 1.0;
+    LogPriorKey key;
+    key.reserve(2 * node.parameters().size());
     for (auto parameter = node.parameters().begin();
         parameter != node.parameters().end(); ++parameter)
     {
-      float p = parameter->second;
+      auto counter = counters.find(parameter->first);
+      key.push_back(parameter->second);
+      key.push_back(counter != counters.end() ? counter->second : 0);
+    }
+    auto cached = log_prior_cache_.find(key);
+    if (cached != log_prior_cache_.end())
+      return cached->second;
+
+    /* The rising factorial a (a + 1) ... (a + n - 1) is
+     * Gamma(a + n) / Gamma(a). A parameter of 0 makes it 0 for n > 0 and 1
+     * for n = 0. */
+    double sum_parameters = 0.0;
+    double sum_counters = 0.0;
+    double log_p = 0.0;
+    for (auto k = key.begin(); k != key.end(); k += 2)
+    {
+      const double p = k[0];
+      const double counter = k[1];
       sum_parameters += p;
-      size_t counter = counters[parameter->first];
       sum_counters += counter;
-      for (; counter != 0; --counter)
+      if (counter == 0.0)
+        continue;
+      if (p <= 0.0)
       {
-        nominator *= p;
-        p += 1.0;
+        log_p = -numeric_limits<double>::infinity();
+        break;
       }
+      log_p += lgamma(p + counter) - lgamma(p);
     }
+    if (sum_counters != 0.0 && log_p != -numeric_limits<double>::infinity())
+      log_p -= lgamma(sum_parameters + sum_counters) - lgamma(sum_parameters);
 
-    float denominator = 1.0;
-    for (; sum_counters != 0; --sum_counters)
-    {
-      denominator *= sum_parameters;
-      sum_parameters += 1;
-    }
-
-    return nominator / denominator;
+    if (log_prior_cache_.size() == max_cached_log_priors_)
+      log_prior_cache_.clear();
+    log_prior_cache_.insert(make_pair(key, log_p));
+    return log_p;
   }
 
   void
   DirichletProcessParameters::sample_managed_node(
       ConditionalDirichletNode& node, const DiscreteRandomVariable& component,
-      DiscreteRandomVariableMap<Children>& children_of_node)
+      DiscreteRandomVariableMap<Children>& children_of_node,
+      RandomNumberEngine& rne)
   {
     /* Check requirements. */
     cpprob_check_debug(
@@ -272,14 +321,14 @@ namespace cpprob
     for (; condition_var != condition_var.value_range().end(); ++condition_var)
     {
       if (*condition_self_it == component)
-        node.sample(condition_var, children_of_node[condition_var]);
+        node.sample(condition_var, children_of_node[condition_var], rne);
     }
   }
 
   void
   DirichletProcessParameters::sample_managed_nodes(
       const DiscreteRandomVariable& component,
-      const Children& children_of_component)
+      const Children& children_of_component, RandomNumberEngine& rne)
   {
     for (auto node = managed_nodes_.begin(); node != managed_nodes_.end();
         ++node)
@@ -291,8 +340,279 @@ namespace cpprob
         if (&child->probabilities() == &node->value())
           children_of_node[component].push_back(*child);
       }
-      sample_managed_node(*node, component, children_of_node);
+      sample_managed_node(*node, component, children_of_node, rne);
     }
   }
 
+  void
+  DirichletProcessParameters::sample(Nodes& nodes, RandomNumberEngine& rne)
+  {
+    if (truncation_ != 0)
+      sample_blocked(nodes, rne);
+
+    if (split_merge_interval_ == 0
+        || ++sweeps_since_split_merge_ < split_merge_interval_)
+      return;
+
+    sweeps_since_split_merge_ = 0;
+    for (unsigned int m = 0; m != split_merge_moves_; ++m)
+      split_merge(nodes, rne);
+  }
+
+  void
+  DirichletProcessParameters::sample_blocked(Nodes& nodes,
+      RandomNumberEngine& rne)
+  {
+    for (auto node = managed_nodes_.begin(); node != managed_nodes_.end();
+        ++node)
+    {
+      if (node->is_collapsed())
+        cpprob_throw_logic_error(
+            "DirichletProcessParameters: Cannot sample " << name() << " blocked with the collapsed node " << node->value().name() << ".");
+    }
+    if (nodes.size() == 0)
+      return;
+
+    while (component_counters_.size() < truncation_)
+      create_component(Children(), rne);
+    cont::vector<DiscreteRandomVariable> components;
+    components.reserve(component_counters_.size());
+    size_t remaining = 0;
+    for (auto c = component_counters_.begin(); c != component_counters_.end();
+        ++c)
+    {
+      components.push_back(c->first);
+      remaining += c->second;
+    }
+
+    /* The stick weights given the counters: The stick of component k is
+     * Beta(1 + n_k, concentration + n_k+1 + n_k+2 + ...), and the last
+     * component takes the rest. */
+    cont::vector<double> log_weights;
+    log_weights.reserve(components.size());
+    double log_rest = 0.0;
+    for (auto c = component_counters_.begin(); c != component_counters_.end();
+        ++c)
+    {
+      remaining -= c->second;
+      const double rest_parameter = concentration_ + remaining;
+      if (log_weights.size() + 1 == components.size() || rest_parameter <= 0.0)
+      {
+        log_weights.push_back(log_rest);
+        log_rest = -numeric_limits<double>::infinity();
+        continue;
+      }
+      typedef gamma_distribution<double> GammaDistribution;
+      variate_generator<RandomNumberEngine&, GammaDistribution> stick_variate(
+          rne, GammaDistribution(1.0 + c->second));
+      variate_generator<RandomNumberEngine&, GammaDistribution> rest_variate(
+          rne, GammaDistribution(rest_parameter));
+      const double stick = stick_variate();
+      const double rest = rest_variate();
+      log_weights.push_back(log_rest + log(stick / (stick + rest)));
+      log_rest += log(rest / (stick + rest));
+    }
+    tail_mass_ = exp(log_weights.back());
+    if (tail_mass_ <= max_tail_mass_)
+      is_tail_mass_warned_ = false;
+    else if (!is_tail_mass_warned_)
+    {
+      clog << "DirichletProcessParameters: The last stick of " << name()
+          << " has the mass " << tail_mass_ << ", more than "
+          << max_tail_mass_ << ". The truncation level " << truncation_
+          << " is too low." << endl;
+      is_tail_mass_warned_ = true;
+    }
+
+    /* The parameters of every component given its children; an empty
+     * component draws from the prior. */
+    DiscreteRandomVariableMap<Children> children_of_component;
+    for (auto node = nodes.begin(); node != nodes.end(); ++node)
+    {
+      Children& children = children_of_component[node->value()];
+      for (auto c = node->children().begin(); c != node->children().end(); ++c)
+        children.push_back(*c);
+    }
+    for (auto c = components.begin(); c != components.end(); ++c)
+      sample_managed_nodes(*c, children_of_component[*c], rne);
+
+    /* The components of the nodes. The random numbers are drawn here, in
+     * the order of the nodes; so the threads do not change the result. */
+    typedef uniform_real<double> Distribution;
+    variate_generator<RandomNumberEngine&, Distribution> canonical(
+        rne, Distribution(0.0, 1.0));
+    cont::vector<double> uniforms(nodes.size());
+    for (auto u = uniforms.begin(); u != uniforms.end(); ++u)
+      *u = canonical();
+
+    auto sample_node = [&](size_t n)
+    {
+      DirichletProcessNode& node = nodes[n];
+      const DiscreteRandomVariable saved_value = node.value();
+      cont::vector<double> log_p(log_weights);
+      double max_log_p = -numeric_limits<double>::infinity();
+      for (size_t k = 0; k != components.size(); ++k)
+      {
+        node.value() = components[k];
+        for (auto c = node.children().begin(); c != node.children().end(); ++c)
+          log_p[k] += log(static_cast<double>(c->at_references()));
+        max_log_p = max(max_log_p, log_p[k]);
+      }
+      node.value() = saved_value;
+      if (max_log_p == -numeric_limits<double>::infinity())
+        return;
+
+      double sum = 0.0;
+      for (auto p = log_p.begin(); p != log_p.end(); ++p)
+        sum += *p = exp(*p - max_log_p);
+      const double u = uniforms[n] * sum;
+      size_t k = 0;
+      double cumulative = log_p[0];
+      while (cumulative <= u && k + 1 != log_p.size())
+        cumulative += log_p[++k];
+      node.value() = components[k];
+    };
+
+    unsigned int threads = sampling_threads_;
+    if (threads == 0)
+      threads = max(1u, thread::hardware_concurrency());
+    threads = min<size_t>(threads, nodes.size());
+    if (threads <= 1)
+    {
+      for (size_t n = 0; n != nodes.size(); ++n)
+        sample_node(n);
+    }
+    else
+    {
+      atomic<size_t> next(0);
+      cont::vector<exception_ptr> errors(threads);
+      auto run_nodes = [&](unsigned int t)
+      {
+        try
+        {
+          for (size_t n = next++; n < nodes.size(); n = next++)
+            sample_node(n);
+        }
+        catch (...)
+        {
+          errors[t] = current_exception();
+        }
+      };
+      cont::vector<thread> workers;
+      for (unsigned int t = 0; t != threads; ++t)
+        workers.push_back(thread(run_nodes, t));
+      for (auto w = workers.begin(); w != workers.end(); ++w)
+        w->join();
+      for (auto e = errors.begin(); e != errors.end(); ++e)
+      {
+        if (*e)
+          rethrow_exception(*e);
+      }
+    }
+
+    for (auto c = component_counters_.begin(); c != component_counters_.end();
+        ++c)
+      c->second = 0;
+    for (auto node = nodes.begin(); node != nodes.end(); ++node)
+      component_counters_[node->value()] += 1;
+
+    /* The nodes have changed their components without add_children_counts(),
+     * which the threads cannot call on the shared counts. So the managed
+     * nodes count their children again. */
+    for (auto node = managed_nodes_.begin(); node != managed_nodes_.end();
+        ++node)
+      node->invalidate_counts();
+  }
+
+  void
+  DirichletProcessParameters::split_merge(Nodes& nodes,
+      RandomNumberEngine& rne)
+  {
+    const size_t n = nodes.size();
+    if (n < 2)
+      return;
+
+    typedef uniform_real<float> Distribution;
+    variate_generator<RandomNumberEngine&, Distribution> canonical(
+        rne, Distribution(0.0f, 1.0f));
+
+    /* Two different nodes i and j */
+    const size_t i = min(static_cast<size_t>(canonical() * n), n - 1);
+    size_t j = min(static_cast<size_t>(canonical() * (n - 1)), n - 2);
+    if (j >= i)
+      ++j;
+    DirichletProcessNode& node_i = nodes[i];
+    DirichletProcessNode& node_j = nodes[j];
+    const DiscreteRandomVariable component_i = node_i.value();
+    const DiscreteRandomVariable component_j = node_j.value();
+    const bool is_split = component_i == component_j;
+
+    /* The two sides: after the split, or before the merge */
+    cont::vector<DirichletProcessNode*> side_i(1, &node_i);
+    cont::vector<DirichletProcessNode*> side_j(1, &node_j);
+    for (auto node = nodes.begin(); node != nodes.end(); ++node)
+    {
+      if (&*node == &node_i || &*node == &node_j)
+        continue;
+      if (node->value() == component_i && (!is_split || canonical() < 0.5f))
+        side_i.push_back(&*node);
+      else if (node->value() == component_j)
+        side_j.push_back(&*node);
+    }
+
+    Children children_i;
+    Children children_j;
+    Children children_both;
+    for (auto node = side_i.begin(); node != side_i.end(); ++node)
+    {
+      for (auto c = (*node)->children().begin(); c != (*node)->children().end();
+          ++c)
+      {
+        children_i.push_back(*c);
+        children_both.push_back(*c);
+      }
+    }
+    for (auto node = side_j.begin(); node != side_j.end(); ++node)
+    {
+      for (auto c = (*node)->children().begin(); c != (*node)->children().end();
+          ++c)
+      {
+        children_j.push_back(*c);
+        children_both.push_back(*c);
+      }
+    }
+
+    /* The ratio of the split partition to the merged one, times the
+     * inverse of the proposal probability 2^-(n - 2) of the split. */
+    const double size_i = side_i.size();
+    const double size_j = side_j.size();
+    const double log_split_ratio = log(static_cast<double>(concentration_))
+        + lgamma(size_i) + lgamma(size_j) - lgamma(size_i + size_j)
+        + log_prior_probability_of_managed_nodes(children_i)
+        + log_prior_probability_of_managed_nodes(children_j)
+        - log_prior_probability_of_managed_nodes(children_both)
+        + (size_i + size_j - 2.0) * log(2.0);
+    const double log_acceptance =
+        is_split ? log_split_ratio : -log_split_ratio;
+    if (!(log(static_cast<double>(canonical())) < log_acceptance))
+      return;
+
+    /* Side i moves: to a free component for the split, to the component of
+     * j for the merge. */
+    for (auto node = side_i.begin(); node != side_i.end(); ++node)
+      (*node)->add_children_counts(-1.0f);
+    component_counters_[component_i] -= side_i.size();
+    const DiscreteRandomVariable target =
+        is_split ? next_component(children_i, rne) : component_j;
+    for (auto node = side_i.begin(); node != side_i.end(); ++node)
+    {
+      (*node)->value() = target;
+      (*node)->add_children_counts(1.0f);
+    }
+    component_counters_[target] += side_i.size();
+
+    sample_managed_nodes(component_j, is_split ? children_j : children_both,
+        rne);
+  }
+
 } /* namespace cpprob */
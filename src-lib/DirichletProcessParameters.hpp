@@ -9,13 +9,18 @@
 #define DIRICHLETPROCESSPARAMETERS_HPP_
 
 #include "DiscreteRandomVariableMap.hpp"
+#include "RandomNumberEngine.hpp"
 #include "cont/RefVector.hpp"
+#include "cont/map.hpp"
+#include "cont/vector.hpp"
 
 namespace DirichletProcessTest
 {
 
   struct Parameters;
   struct Node;
+  struct LogPrior;
+  struct ExtendRows;
 
 }
 
@@ -24,6 +29,7 @@ namespace cpprob
 
   class ConditionalCategoricalNode;
   class ConditionalDirichletNode;
+  class DirichletProcessNode;
   class RandomInteger;
 
   /*
@@ -36,6 +42,7 @@ namespace cpprob
 
     typedef DiscreteRandomVariableMap<std::size_t> ComponentCounters;
     typedef cont::RefVector<ConditionalDirichletNode> ManagedNodes;
+    typedef cont::RefVector<DirichletProcessNode> Nodes;
 
 #ifndef WITHOUT_INITIALIZER_LIST
     DirichletProcessParameters(const std::string& name, float concentration,
@@ -47,7 +54,11 @@ namespace cpprob
           NodeList& managed_nodes)
           : component_counters_(), component_name_(name), concentration_(
               concentration), managed_nodes_(managed_nodes.begin(),
-              managed_nodes.end()), parameters_name_(name + "Parameters")
+              managed_nodes.end()), parameters_name_(name + "Parameters"),
+              log_prior_cache_(), split_merge_interval_(0), split_merge_moves_(
+              1), sweeps_since_split_merge_(0), truncation_(0), max_tail_mass_(
+              0.01f), tail_mass_(0.0), is_tail_mass_warned_(false),
+              sampling_threads_(1)
       {
       }
 
@@ -84,52 +95,220 @@ namespace cpprob
       return parameters_name_;
     }
 
+    /**
+     * The largest mass of the last stick that the blocked sampler accepts
+     * without a warning; see truncation().
+     */
+    float
+    max_tail_mass() const
+    {
+      return max_tail_mass_;
+    }
+
+    void
+    max_tail_mass(float value)
+    {
+      max_tail_mass_ = value;
+      is_tail_mass_warned_ = false;
+    }
+
+    /**
+     * The number of threads that draw the components of the nodes in the
+     * blocked sampler. 0 means one thread per core. The result does not
+     * depend on the number of threads.
+     */
+    unsigned int
+    sampling_threads() const
+    {
+      return sampling_threads_;
+    }
+
+    void
+    sampling_threads(unsigned int threads)
+    {
+      sampling_threads_ = threads;
+    }
+
+    /**
+     * The mass of the last stick in the last sweep of the blocked sampler.
+     */
+    double
+    tail_mass() const
+    {
+      return tail_mass_;
+    }
+
+    /**
+     * The number of components of the blocked sampler. 0, the default,
+     * samples with the Pólya urn scheme: Every DirichletProcessNode draws
+     * its component in turn, given the components of all other nodes.
+     *
+     * With a truncation level K > 0, sample() runs the blocked Gibbs sampler
+     * of the truncated stick-breaking representation (Ishwaran and James,
+     * 2001) instead, and DirichletProcessNode::sample() does nothing. A sweep
+     * draws the stick weights of at least K components given the counters,
+     * then the parameters of every component given its children, and then
+     * the components of all nodes. Given the weights and the parameters,
+     * the nodes are independent; so the last step runs on
+     * sampling_threads() threads. The last stick takes the rest of the mass.
+     * If it is larger than max_tail_mass(), the truncation is too low, and
+     * a warning goes to std::clog.
+     *
+     * @par Requires:
+     * - The managed nodes are not collapsed.
+     * - With more than one thread, a child has no other DirichletProcessNode
+     *   in its condition.
+     */
+    std::size_t
+    truncation() const
+    {
+      return truncation_;
+    }
+
+    void
+    truncation(std::size_t level)
+    {
+      truncation_ = level;
+    }
+
+    /**
+     * Runs the split-merge moves if they are due. The Gibbs steps of the
+     * DirichletProcessNode objects move one node at a time; so they hardly
+     * split a large component or merge two similar ones. A split-merge move
+     * (Jain and Neal, 2004) proposes this in one step: It picks two nodes
+     * at random. If they are in the same component, it proposes to split
+     * the component, drawing every other member to either side with
+     * probability 1/2. Otherwise it proposes to merge both components. The
+     * Metropolis-Hastings ratio compares the partitions with the marginal
+     * likelihood of the children (see
+     * log_prior_probability_of_managed_nodes()). After an accepted move,
+     * the parameters of the changed components are drawn from their
+     * posterior.
+     *
+     * The sampling of the ConstantNode of the parameters calls this once
+     * per sweep. With a truncation level, it runs the blocked sampler
+     * before; see truncation().
+     *
+     * @param nodes the DirichletProcessNode objects of these parameters
+     * @param rne the random number engine to draw with
+     * @throw std::logic_error The blocked sampler is on and a managed node
+     *     is collapsed.
+     */
+    void
+    sample(Nodes& nodes, RandomNumberEngine& rne = random_number_engine);
+
+    /**
+     * The number of sweeps between the split-merge moves. 0, the default,
+     * turns them off.
+     */
+    unsigned int
+    split_merge_interval() const
+    {
+      return split_merge_interval_;
+    }
+
+    void
+    split_merge_interval(unsigned int interval)
+    {
+      split_merge_interval_ = interval;
+      sweeps_since_split_merge_ = 0;
+    }
+
+    /**
+     * The number of split-merge moves in a sweep where they are due.
+     */
+    unsigned int
+    split_merge_moves() const
+    {
+      return split_merge_moves_;
+    }
+
+    void
+    split_merge_moves(unsigned int moves)
+    {
+      split_merge_moves_ = moves;
+    }
+
   private:
 
     friend class DirichletProcessNode;
     friend struct ::DirichletProcessTest::Parameters;
     friend struct ::DirichletProcessTest::Node;
+    friend struct ::DirichletProcessTest::LogPrior;
+    friend struct ::DirichletProcessTest::ExtendRows;
     typedef cont::RefVector<ConditionalCategoricalNode> Children;
     typedef cont::map<DiscreteRandomVariable, Children,
         DiscreteRandomVariable::NameLess> ChildrenOfComponent;
+    /* The parameters and the counts of a managed node, interleaved. */
+    typedef cont::vector<double> LogPriorKey;
+
+    static const std::size_t max_cached_log_priors_ = 4096;
 
     ComponentCounters component_counters_;
     std::string component_name_;
     float concentration_;
     ManagedNodes managed_nodes_;
     std::string parameters_name_;
+    /* Memo of log_prior_probability_of_managed_node(). The same few count
+     * vectors recur in every sweep, so most calls are hits. The key holds
+     * the parameters too; so it stays valid in a copy of the network. The
+     * cache is cleared when it is full. */
+    mutable cont::map<LogPriorKey, double> log_prior_cache_;
+    unsigned int split_merge_interval_;
+    unsigned int split_merge_moves_;
+    unsigned int sweeps_since_split_merge_;
+    std::size_t truncation_;
+    float max_tail_mass_;
+    double tail_mass_;
+    bool is_tail_mass_warned_;
+    unsigned int sampling_threads_;
 
     DiscreteRandomVariable
-    create_component(const Children& children_of_component);
+    create_component(const Children& children_of_component,
+        RandomNumberEngine& rne);
 
     void
     extend_managed_node(ConditionalDirichletNode& node,
         const DiscreteRandomVariable::Range& old_range,
         const DiscreteRandomVariable::Range& new_range,
-        const ChildrenOfComponent& children_of_component);
+        const ChildrenOfComponent& children_of_component,
+        RandomNumberEngine& rne);
 
     DiscreteRandomVariable
-    next_component(const Children& children_of_component);
+    next_component(const Children& children_of_component,
+        RandomNumberEngine& rne);
 
     friend std::ostream&
     operator<<(std::ostream& os, const DirichletProcessParameters& parameters);
 
-    float
-    prior_probability_of_managed_node(const ConditionalDirichletNode& node,
-        ComponentCounters counters) const;
+    /* The logarithm of the Dirichlet-multinomial probability of the
+     * counted child values in a new component of the node. It is computed
+     * from lgamma differences; so it does not underflow for large counts. */
+    double
+    log_prior_probability_of_managed_node(const ConditionalDirichletNode& node,
+        const ComponentCounters& counters) const;
 
-    float
-    prior_probability_of_managed_nodes(
+    double
+    log_prior_probability_of_managed_nodes(
         const Children& children_of_component) const;
 
     void
     sample_managed_node(ConditionalDirichletNode& node,
         const DiscreteRandomVariable& component,
-        DiscreteRandomVariableMap<Children>& children_of_node);
+        DiscreteRandomVariableMap<Children>& children_of_node,
+        RandomNumberEngine& rne);
 
     void
     sample_managed_nodes(const DiscreteRandomVariable& component,
-        const Children& children_of_component);
+        const Children& children_of_component, RandomNumberEngine& rne);
+
+    /* One sweep of the blocked sampler; see truncation(). */
+    void
+    sample_blocked(Nodes& nodes, RandomNumberEngine& rne);
+
+    /* One split-merge move; see sample(). */
+    void
+    split_merge(Nodes& nodes, RandomNumberEngine& rne);
 
   };
 
@@ -0,0 +1,187 @@
+/*
+ * DiscreteFactor.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "DiscreteFactor.hpp"
+#include <algorithm>
+#include <ostream>
+
+using namespace std;
+
+namespace cpprob
+{
+
+  ostream&
+  operator<<(ostream& os, const DiscreteFactor& factor)
+  {
+    os << "Factor over (";
+    string prefix;
+    for (auto v = factor.variables_.begin(); v != factor.variables_.end(); ++v)
+    {
+      os << prefix << (*v)->name();
+      prefix = ", ";
+    }
+    os << "):";
+    for (auto p = factor.values_.begin(); p != factor.values_.end(); ++p)
+      os << " " << *p;
+    return os << "\n";
+  }
+
+  DiscreteFactor::DiscreteFactor()
+      : variables_(), sizes_(), values_(1, 1.0)
+  {
+  }
+
+  DiscreteFactor::DiscreteFactor(const Variables& variables)
+      : variables_(variables), sizes_(), values_()
+  {
+    size_type table_size = 1;
+    sizes_.reserve(variables_.size());
+    for (auto v = variables_.begin(); v != variables_.end(); ++v)
+    {
+      cpprob_check_debug(
+          (*v)->value_range().size() != 0,
+          "DiscreteFactor: Cannot create a factor over the empty variable " << (*v)->name() << ".");
+      sizes_.push_back((*v)->value_range().size());
+      table_size *= sizes_.back();
+    }
+    values_.assign(table_size, 0.0);
+  }
+
+  void
+  DiscreteFactor::assign_variables(size_type index) const
+  {
+    for (size_type i = 0; i != variables_.size(); ++i)
+    {
+      *variables_[i] = variables_[i]->value_range().at(index % sizes_[i]);
+      index /= sizes_[i];
+    }
+  }
+
+  bool
+  DiscreteFactor::contains(const DiscreteRandomVariable* var) const
+  {
+    return find(variables_.begin(), variables_.end(), var) != variables_.end();
+  }
+
+  DiscreteFactor::size_type
+  DiscreteFactor::index_of_current_values() const
+  {
+    size_type index = 0;
+    size_type stride = 1;
+    for (size_type i = 0; i != variables_.size(); ++i)
+    {
+      index += stride * variables_[i]->value_index();
+      stride *= sizes_[i];
+    }
+    return index;
+  }
+
+  DiscreteFactor
+  DiscreteFactor::product(const DiscreteFactor& other) const
+  {
+    /* Set up the variables of the result: first the own variables, then
+     * the variables of other, which are new. */
+    Variables result_variables(variables_);
+    for (auto v = other.variables_.begin(); v != other.variables_.end(); ++v)
+    {
+      if (!contains(*v))
+        result_variables.push_back(*v);
+    }
+    DiscreteFactor result(result_variables);
+
+    /* Walk through the rows of the result and follow the corresponding rows
+     * in both factors with their strides. */
+    const Sizes this_strides = result.strides_in(*this);
+    const Sizes other_strides = result.strides_in(other);
+    const size_type variable_count = result.variables_.size();
+    Sizes assignment(variable_count, 0);
+    size_type this_index = 0;
+    size_type other_index = 0;
+
+    for (size_type i = 0; i != result.values_.size(); ++i)
+    {
+      result.values_[i] = values_[this_index] * other.values_[other_index];
+
+      for (size_type v = 0; v != variable_count; ++v)
+      {
+        ++assignment[v];
+        if (assignment[v] == result.sizes_[v])
+        {
+          assignment[v] = 0;
+          this_index -= (result.sizes_[v] - 1) * this_strides[v];
+          other_index -= (result.sizes_[v] - 1) * other_strides[v];
+        }
+        else
+        {
+          this_index += this_strides[v];
+          other_index += other_strides[v];
+          break;
+        }
+      }
+    }
+
+    return result;
+  }
+
+  DiscreteFactor::Sizes
+  DiscreteFactor::strides_in(const DiscreteFactor& other) const
+  {
+    Sizes strides(variables_.size(), 0);
+    size_type stride = 1;
+    for (size_type i = 0; i != other.variables_.size(); ++i)
+    {
+      auto found = find(variables_.begin(), variables_.end(),
+          other.variables_[i]);
+      if (found != variables_.end())
+        strides[found - variables_.begin()] = stride;
+      stride *= other.sizes_[i];
+    }
+    return strides;
+  }
+
+  DiscreteFactor
+  DiscreteFactor::sum_out(const DiscreteRandomVariable* var) const
+  {
+    Variables result_variables;
+    for (auto v = variables_.begin(); v != variables_.end(); ++v)
+    {
+      if (*v != var)
+        result_variables.push_back(*v);
+    }
+    DiscreteFactor result(result_variables);
+
+    /* Walk through the own rows and add each row to the row of the result
+     * that has the same values for the remaining variables. */
+    const Sizes result_strides = strides_in(result);
+    const size_type variable_count = variables_.size();
+    Sizes assignment(variable_count, 0);
+    size_type result_index = 0;
+
+    for (size_type i = 0; i != values_.size(); ++i)
+    {
+      result.values_[result_index] += values_[i];
+
+      for (size_type v = 0; v != variable_count; ++v)
+      {
+        ++assignment[v];
+        if (assignment[v] == sizes_[v])
+        {
+          assignment[v] = 0;
+          result_index -= (sizes_[v] - 1) * result_strides[v];
+        }
+        else
+        {
+          result_index += result_strides[v];
+          break;
+        }
+      }
+    }
+
+    return result;
+  }
+
+} /* namespace cpprob */
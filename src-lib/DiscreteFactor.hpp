@@ -0,0 +1,160 @@
+/*
+ * DiscreteFactor.hpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#ifndef DISCRETEFACTOR_HPP_
+#define DISCRETEFACTOR_HPP_
+
+#include "DiscreteRandomVariable.hpp"
+#include "cont/vector.hpp"
+#include <iosfwd>
+
+namespace cpprob
+{
+
+  /**
+   * Table of non-negative numbers over the joint values of some discrete
+   * random variables. Factors are the data structure of exact inference
+   * algorithms like variable elimination. A factor refers to the variables
+   * in the network (it does not copy them). So it can set these variables to
+   * the values of a table row and evaluate the nodes of the network for them.
+   *
+   * The rows are stored in a contiguous vector. They are ordered like the
+   * joint values of DiscreteJointRandomVariable and DiscreteRandomReferences:
+   * the value of the first variable changes fastest.
+   */
+  class DiscreteFactor
+  {
+
+  public:
+
+    typedef cont::vector<DiscreteRandomVariable*> Variables;
+    typedef cont::vector<double> Values;
+    typedef Values::size_type size_type;
+
+    /**
+     * Creates the factor without variables. It has exactly one row with the
+     * value 1. So it is the neutral element of #product.
+     */
+    DiscreteFactor();
+
+    /**
+     * Creates a factor over the given variables with all rows set to 0.
+     *
+     * @par Requires:
+     * - Every variable is associated with a set of outcomes.
+     * - No variable is given twice.
+     */
+    explicit
+    DiscreteFactor(const Variables& variables);
+
+    // Use the implicit destructor, so the implicit copy and move operations
+    // are generated by the compiler.
+
+    /**
+     * Sets the variables of this factor to the values of the row @c index.
+     */
+    void
+    assign_variables(size_type index) const;
+
+    bool
+    contains(const DiscreteRandomVariable* var) const;
+
+    /**
+     * Fills every row of this factor with the result of @c f. Before @c f is
+     * called for a row, the variables of the factor are set to the values of
+     * this row. So @c f is usually something like the probability of a node
+     * for its current value and the current values of its parents. The
+     * variables are left in the state of the last row.
+     */
+    template<class Function>
+      void
+      fill(Function f)
+      {
+        for (size_type i = 0; i != values_.size(); ++i)
+        {
+          assign_variables(i);
+          values_[i] = f();
+        }
+      }
+
+    /**
+     * Provides the index of the row that matches the current values of the
+     * variables.
+     */
+    size_type
+    index_of_current_values() const;
+
+    double&
+    operator[](size_type index)
+    {
+      return values_[index];
+    }
+
+    const double&
+    operator[](size_type index) const
+    {
+      return values_[index];
+    }
+
+    /**
+     * Computes the point-wise product of this factor and @c other. The
+     * variables of the result are the variables of this factor followed by
+     * the variables of @c other that are not in this factor.
+     */
+    DiscreteFactor
+    product(const DiscreteFactor& other) const;
+
+    size_type
+    size() const
+    {
+      return values_.size();
+    }
+
+    /**
+     * Sums over all values of @c var. The result contains all variables of
+     * this factor except @c var. If @c var is not part of this factor, the
+     * result is a copy of this factor.
+     */
+    DiscreteFactor
+    sum_out(const DiscreteRandomVariable* var) const;
+
+    const Values&
+    values() const
+    {
+      return values_;
+    }
+
+    const Variables&
+    variables() const
+    {
+      return variables_;
+    }
+
+  private:
+
+    typedef cont::vector<size_type> Sizes;
+
+    Variables variables_;
+    Sizes sizes_;
+    Values values_;
+
+    /**
+     * Computes for every variable of this factor the step of the row index in
+     * @c other when the variable is incremented. The step is 0 for variables
+     * that are not part of @c other.
+     */
+    Sizes
+    strides_in(const DiscreteFactor& other) const;
+
+    friend std::ostream&
+    operator<<(std::ostream& os, const DiscreteFactor& factor);
+
+  };
+
+} /* namespace cpprob */
+
+#endif /* DISCRETEFACTOR_HPP_ */
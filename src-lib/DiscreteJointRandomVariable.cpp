@@ -24,14 +24,14 @@ namespace cpprob
   DiscreteJointRandomVariable::DiscreteJointRandomVariable(
       const DiscreteRandomVariable& var1, const DiscreteRandomVariable& var2)
   {
-    if (var1.characteristics_ == characteristics_table_.end()
-        || var1.value_ == var1.characteristics_->second.size_)
+    if (var1.characteristics_ == no_characteristics_
+        || var1.value_ == characteristics_table_[var1.characteristics_].size_)
       throw invalid_argument(
           "JointRandomVariable: Could not insert variable " + var1.name()
               + ".");
 
-    if (var2.characteristics_ == characteristics_table_.end()
-        || var2.value_ == var2.characteristics_->second.size_)
+    if (var2.characteristics_ == no_characteristics_
+        || var2.value_ == characteristics_table_[var2.characteristics_].size_)
       throw invalid_argument(
           "JointRandomVariable: Could not insert variable " + var2.name()
               + ".");
@@ -45,7 +45,7 @@ namespace cpprob
           "JointRandomVariable: Could not insert variable " + var2.name()
               + ".");
 
-    update_random_variable();
+    set_up_random_variable();
   }
 
   //----------------------------------------------------------------------------
@@ -87,15 +87,15 @@ namespace cpprob
   pair<DiscreteJointRandomVariable::iterator, bool>
   DiscreteJointRandomVariable::insert(const DiscreteRandomVariable& var)
   {
-    if (var.characteristics_ == characteristics_table_.end()
-        || var.value_ == var.characteristics_->second.size_)
+    if (var.characteristics_ == no_characteristics_
+        || var.value_ == characteristics_table_[var.characteristics_].size_)
       return make_pair(variables_.end(), false);
 
     pair<iterator, bool> result = variables_.insert(var);
     if (result.second == false)
       return result;
 
-    update_random_variable();
+    set_up_random_variable();
     return result;
   }
 
@@ -105,7 +105,7 @@ namespace cpprob
   DiscreteJointRandomVariable::operator--()
   {
     cpprob_check_debug(
-        characteristics_ != characteristics_table_.end(),
+        characteristics_ != no_characteristics_,
         "DiscreteJointRandomVariable: Cannot decrement an empty random variable.");
     cpprob_check_debug( value_ > 0,
         "DiscreteJointRandomVariable: Cannot decrement the value " << value_ //
@@ -137,7 +137,7 @@ namespace cpprob
   DiscreteJointRandomVariable::operator--(int)
   {
     cpprob_check_debug(
-        characteristics_ != characteristics_table_.end(),
+        characteristics_ != no_characteristics_,
         "DiscreteJointRandomVariable: Cannot decrement an empty random variable.");
     cpprob_check_debug( value_ > 0,
         "DiscreteJointRandomVariable: Cannot decrement the value " << value_ //
@@ -171,14 +171,14 @@ namespace cpprob
   DiscreteJointRandomVariable::operator++()
   {
     cpprob_check_debug(
-        characteristics_ != characteristics_table_.end(),
+        characteristics_ != no_characteristics_,
         "DiscreteJointRandomVariable: Cannot increment an empty random variable.");
-    cpprob_check_debug( value_ < characteristics_->second.size_,
+    cpprob_check_debug( value_ < characteristics_table_[characteristics_].size_,
         "DiscreteJointRandomVariable: Cannot increment the value " << value_ //
         << " of the variable " << name() << " above the maximum "//
-        << characteristics_->second.size_ << ".");
+        << characteristics_table_[characteristics_].size_ << ".");
 
-    if (value_ < characteristics_->second.size_ - 1)
+    if (value_ < characteristics_table_[characteristics_].size_ - 1)
     {
       for (Variables::iterator it = variables_.begin(); it != variables_.end();
           ++it)
@@ -191,7 +191,7 @@ namespace cpprob
           break;
       }
     }
-    else if (value_ == characteristics_->second.size_ - 1)
+    else if (value_ == characteristics_table_[characteristics_].size_ - 1)
     {
       DiscreteRandomVariable& var =
           const_cast<DiscreteRandomVariable&>(*(variables_.begin()));
@@ -208,16 +208,16 @@ namespace cpprob
   DiscreteJointRandomVariable::operator++(int)
   {
     cpprob_check_debug(
-        characteristics_ != characteristics_table_.end(),
+        characteristics_ != no_characteristics_,
         "DiscreteJointRandomVariable: Cannot increment an empty random variable.");
-    cpprob_check_debug( value_ < characteristics_->second.size_,
+    cpprob_check_debug( value_ < characteristics_table_[characteristics_].size_,
         "DiscreteJointRandomVariable: Cannot increment the value " << value_ //
         << " of the variable " << name() << " above the maximum "//
-        << characteristics_->second.size_ << ".");
+        << characteristics_table_[characteristics_].size_ << ".");
 
     DiscreteRandomVariable tmp = *this;
 
-    if (value_ < characteristics_->second.size_ - 1)
+    if (value_ < characteristics_table_[characteristics_].size_ - 1)
     {
       for (Variables::iterator it = variables_.begin(); it != variables_.end();
           ++it)
@@ -230,7 +230,7 @@ namespace cpprob
           break;
       }
     }
-    else if (value_ == characteristics_->second.size_ - 1)
+    else if (value_ == characteristics_table_[characteristics_].size_ - 1)
     {
       DiscreteRandomVariable& var =
           const_cast<DiscreteRandomVariable&>(*(variables_.begin()));
@@ -265,28 +265,43 @@ namespace cpprob
 
   //----------------------------------------------------------------------------
 
+  void
+  DiscreteJointRandomVariable::set_up_random_variable()
+  {
+    cont::vector<size_t> parts;
+    parts.reserve(variables_.size());
+    for (Variables::const_iterator it = variables_.begin();
+        it != variables_.end(); ++it)
+    {
+      cpprob_check_debug( it->characteristics_ != no_characteristics_,
+          "DiscreteJointRandomVariable: Cannot join an empty random variable.");
+
+      parts.push_back(it->characteristics_);
+    }
+
+    characteristics_ = set_up_joint_characteristics(parts);
+    update_random_variable();
+  }
+
+  //----------------------------------------------------------------------------
+
   void
   DiscreteJointRandomVariable::update_random_variable()
   {
-    string new_name;
     size_t new_size = 1;
     value_ = 0;
 
     for (Variables::const_iterator it = variables_.begin();
         it != variables_.end(); ++it)
     {
-      cpprob_check_debug( it->characteristics_ != characteristics_table_.end(),
+      cpprob_check_debug( it->characteristics_ != no_characteristics_,
           "DiscreteJointRandomVariable: Cannot join an empty random variable.");
 
-      new_name += it->name();
       value_ += new_size * it->value_;
-      new_size *= it->characteristics_->second.size_;
+      new_size *= characteristics_table_[it->characteristics_].size_;
     }
 
-    if (characteristics_ == characteristics_table_.end()
-        || new_name != characteristics_->first)
-      characteristics_ = set_up_characteristics(new_name, new_size);
-    characteristics_->second.size_ = new_size;
+    characteristics_table_[characteristics_].size_ = new_size;
   }
 
 }
@@ -121,6 +121,17 @@ namespace cpprob
       return *this;
     }
 
+    /**
+     * Looks up the kind of the joint variable by the kinds of its parts and
+     * updates the value. Necessary whenever the set of parts changes.
+     */
+    void
+    set_up_random_variable();
+
+    /**
+     * Updates the value and the size from the parts, whose kinds have not
+     * changed.
+     */
     void
     update_random_variable();
 
@@ -23,15 +23,15 @@ namespace cpprob
     for (auto it = references_.begin(); it != references_.end(); ++it)
     {
       cpprob_check_debug(
-          (*it)->characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          (*it)->characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot join an empty random variable.");
 
       value += range_size * (*it)->value_;
-      range_size *= (*it)->characteristics_->second.size_;
+      range_size *= DiscreteRandomVariable::characteristics_table_[(*it)->characteristics_].size_;
     }
 
     if (characteristics_
-        == DiscreteRandomVariable::characteristics_table_.end())
+        == DiscreteRandomVariable::no_characteristics_)
       set_up_characteristics();
 
     /* Reset the size of the range. This is necessary if any of the
@@ -40,7 +40,7 @@ namespace cpprob
      *
      * This action is rather cheap here and ensures that the resulting value
      * is always correct. The user need not care about it. */
-    characteristics_->second.size_ = range_size;
+    DiscreteRandomVariable::characteristics_table_[characteristics_].size_ = range_size;
 
     return DiscreteRandomVariable(characteristics_, value);
   }
@@ -50,36 +50,19 @@ namespace cpprob
   void
   DiscreteRandomReferences::set_up_characteristics() const
   {
-    typedef DiscreteRandomVariable::Characteristics Characteristics;
-    string name;
-    size_t range_size = 1;
-
+    cont::vector<size_t> parts;
+    parts.reserve(references_.size());
     for (const_iterator it = begin(); it != end(); ++it)
     {
       cpprob_check_debug(
-          it->characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          it->characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot join an empty random variable.");
 
-      name += it->name();
-      range_size *= it->characteristics_->second.size_;
+      parts.push_back(it->characteristics_);
     }
 
     characteristics_ =
-        DiscreteRandomVariable::characteristics_table_.lower_bound(name);
-    if (characteristics_ == DiscreteRandomVariable::characteristics_table_.end()
-        || characteristics_->first != name)
-    {
-      if (characteristics_
-          == DiscreteRandomVariable::characteristics_table_.begin())
-        characteristics_ =
-            DiscreteRandomVariable::characteristics_table_.insert(
-                make_pair(name, Characteristics(range_size))).first;
-      else
-        characteristics_ =
-            DiscreteRandomVariable::characteristics_table_.insert(
-                --characteristics_,
-                make_pair(name, Characteristics(range_size)));
-    }
+        DiscreteRandomVariable::set_up_joint_characteristics(parts);
   }
 
   //---------------------------------------------------------------------------
@@ -94,7 +77,7 @@ namespace cpprob
     for (auto it = references_.begin(); it != references_.end(); ++it)
     {
       cpprob_check_debug(
-          (*it)->characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          (*it)->characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot join an empty random variable.");
 
       if ((*it)->characteristics_ == var.characteristics_)
@@ -102,11 +85,11 @@ namespace cpprob
       else
         start_value += range_size * (*it)->value_;
 
-      range_size *= (*it)->characteristics_->second.size_;
+      range_size *= DiscreteRandomVariable::characteristics_table_[(*it)->characteristics_].size_;
     }
 
     if (characteristics_
-        == DiscreteRandomVariable::characteristics_table_.end())
+        == DiscreteRandomVariable::no_characteristics_)
       set_up_characteristics();
 
     /* Reset the size of the range. This is necessary if any of the
@@ -115,10 +98,10 @@ namespace cpprob
      *
      * This action is rather cheap here and ensures that the resulting value
      * is always correct. The user need not care about it. */
-    characteristics_->second.size_ = range_size;
+    DiscreteRandomVariable::characteristics_table_[characteristics_].size_ = range_size;
 
     size_t end_value = start_value
-        + var.characteristics_->second.size_ * step_size;
+        + DiscreteRandomVariable::characteristics_table_[var.characteristics_].size_ * step_size;
     return SubRange(characteristics_, step_size, start_value, end_value);
   }
 
@@ -67,9 +67,9 @@ namespace cpprob
           const DiscreteRandomVariable* var2) const
       {
         cpprob_check_debug(
-            var1->characteristics_ != DiscreteRandomVariable::characteristics_table_.end() && var2->characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+            var1->characteristics_ != DiscreteRandomVariable::no_characteristics_ && var2->characteristics_ != DiscreteRandomVariable::no_characteristics_,
             "DiscreteRandomReferences: Cannot compare a variable that is not associated with a set of observations.");
-        return var1->characteristics_->first < var2->characteristics_->first;
+        return DiscreteRandomVariable::characteristics_table_[var1->characteristics_].name_ < DiscreteRandomVariable::characteristics_table_[var2->characteristics_].name_;
       }
 
     };
@@ -86,14 +86,14 @@ namespace cpprob
 
     DiscreteRandomReferences()
         : characteristics_(
-            DiscreteRandomVariable::characteristics_table_.end()), references_()
+            DiscreteRandomVariable::no_characteristics_), references_()
     {
     }
 
     template<class Iterator>
       DiscreteRandomReferences(Iterator begin, Iterator end)
           : characteristics_(
-              DiscreteRandomVariable::characteristics_table_.end()), references_(
+              DiscreteRandomVariable::no_characteristics_), references_(
               begin, end)
       {
       }
@@ -142,7 +142,7 @@ namespace cpprob
     std::pair<iterator, bool>
     insert(const DiscreteRandomVariable& new_reference)
     {
-      characteristics_ = DiscreteRandomVariable::characteristics_table_.end();
+      characteristics_ = DiscreteRandomVariable::no_characteristics_;
       return references_.insert(&new_reference);
     }
 
@@ -160,7 +160,7 @@ namespace cpprob
 
   private:
 
-    mutable DiscreteRandomVariable::CharacteristicsTable::iterator characteristics_;
+    mutable std::size_t characteristics_;
     Variables references_;
 
     void
@@ -175,7 +175,7 @@ namespace cpprob
 
     SubRangeEnumerator()
         : characteristics_(
-            DiscreteRandomVariable::characteristics_table_.end()), step_size_(
+            DiscreteRandomVariable::no_characteristics_), step_size_(
             0), value_(0)
     {
     }
@@ -184,7 +184,7 @@ namespace cpprob
     joint_value() const
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot compute the joint value of a singular sub range enumerator.");
 
       return DiscreteRandomVariable(characteristics_, value_);
@@ -194,13 +194,13 @@ namespace cpprob
     operator++()
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot increment a singular sub range enumerator.");
       // The end value may be somewhere behind size_. But the previous value
       // must be lower than size_.
       cpprob_check_debug(
-          value_ < characteristics_->second.size_,
-          "DiscreteRandomReferences: Cannot increment a sub range enumerator past the end (value: " << value_ << ", step_size: " << step_size_ << ", max value: " << characteristics_->second.size_ << ").");
+          value_ < DiscreteRandomVariable::characteristics_table_[characteristics_].size_,
+          "DiscreteRandomReferences: Cannot increment a sub range enumerator past the end (value: " << value_ << ", step_size: " << step_size_ << ", max value: " << DiscreteRandomVariable::characteristics_table_[characteristics_].size_ << ").");
 
       value_ += step_size_;
       return *this;
@@ -210,13 +210,13 @@ namespace cpprob
     operator++(int)
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot increment a singular sub range enumerator.");
       // The end value may be somewhere behind size_. But the previous value
       // must be lower than size_.
       cpprob_check_debug(
-          value_ < characteristics_->second.size_,
-          "DiscreteRandomReferences: Cannot increment a sub range enumerator past the end (value: " << value_ << ", step_size: " << step_size_ << ", max value: " << characteristics_->second.size_ << ").");
+          value_ < DiscreteRandomVariable::characteristics_table_[characteristics_].size_,
+          "DiscreteRandomReferences: Cannot increment a sub range enumerator past the end (value: " << value_ << ", step_size: " << step_size_ << ", max value: " << DiscreteRandomVariable::characteristics_table_[characteristics_].size_ << ").");
 
       auto tmp = *this;
       value_ += step_size_;
@@ -227,7 +227,7 @@ namespace cpprob
     operator--()
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot decrement a singular sub range enumerator.");
       cpprob_check_debug(
           value_ >= step_size_,
@@ -241,7 +241,7 @@ namespace cpprob
     operator--(int)
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: Cannot decrement a singular sub range enumerator.");
       cpprob_check_debug(
           value_ >= step_size_,
@@ -254,26 +254,25 @@ namespace cpprob
 
   private:
 
-    typedef DiscreteRandomVariable::CharacteristicsTable::iterator CharacteristicsIterator;
     friend class SubRange;
 
-    CharacteristicsIterator characteristics_;
+    std::size_t characteristics_;
     std::size_t step_size_;
     std::size_t value_;
 
-    SubRangeEnumerator(CharacteristicsIterator characteristics,
+    SubRangeEnumerator(std::size_t characteristics,
         std::size_t step_size, std::size_t value)
         : characteristics_(characteristics), step_size_(step_size), value_(
             value)
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: A sub range enumerator has been initialized with an invalid characteristics entry.");
       cpprob_check_debug(step_size_ != 0,
           "DiscreteRandomReferences: The step size 0 is invalid.");
       cpprob_check_debug(
-          value_ <= (characteristics_->second.size_ - 1 + step_size_),
-          "DiscreteRandomReferences: The value (" << value_ << ") must be within the value range of the random variable (" << characteristics_->second.size_ << ").");
+          value_ <= (DiscreteRandomVariable::characteristics_table_[characteristics_].size_ - 1 + step_size_),
+          "DiscreteRandomReferences: The value (" << value_ << ") must be within the value range of the random variable (" << DiscreteRandomVariable::characteristics_table_[characteristics_].size_ << ").");
     }
 
   };
@@ -306,27 +305,26 @@ namespace cpprob
 
   private:
 
-    typedef DiscreteRandomVariable::CharacteristicsTable::iterator CharacteristicsIterator;
     friend class DiscreteRandomReferences;
 
-    CharacteristicsIterator characteristics_;
+    std::size_t characteristics_;
     std::size_t step_size_;
     std::size_t value_begin_;
     std::size_t value_end_;
 
-    SubRange(CharacteristicsIterator characteristics, std::size_t step_size,
+    SubRange(std::size_t characteristics, std::size_t step_size,
         std::size_t value_begin, std::size_t value_end)
         : characteristics_(characteristics), step_size_(step_size), value_begin_(
             value_begin), value_end_(value_end)
     {
       cpprob_check_debug(
-          characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+          characteristics_ != DiscreteRandomVariable::no_characteristics_,
           "DiscreteRandomReferences: A sub range has been initialized with an invalid characteristics entry.");
       cpprob_check_debug(step_size_ != 0,
           "DiscreteRandomReferences: The step size 0 is invalid.");
       cpprob_check_debug(
-          value_end_ <= (characteristics_->second.size_ - 1 + step_size_),
-          "DiscreteRandomReferences: The end value (" << value_end_ << ") must be within the value range of the random variable (" << characteristics_->second.size_ << ").");
+          value_end_ <= (DiscreteRandomVariable::characteristics_table_[characteristics_].size_ - 1 + step_size_),
+          "DiscreteRandomReferences: The end value (" << value_end_ << ") must be within the value range of the random variable (" << DiscreteRandomVariable::characteristics_table_[characteristics_].size_ << ").");
       cpprob_check_debug(
           value_begin_ <= value_end_,
           "DiscreteRandomReferences: The start value (" << value_begin_ << ") must be smaller than the end value (" << value_end_ << ").");
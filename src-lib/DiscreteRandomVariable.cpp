@@ -6,26 +6,73 @@
  */
 
 #include "DiscreteRandomVariable.hpp"
+#include <map>
+#include <mutex>
 #include <ostream>
+#include <stdexcept>
+#include <unordered_map>
 
 using namespace std;
 
 namespace cpprob
 {
 
+  namespace
+  {
+    /* Hash of the indices of the parts of a joint variable (the combination
+     * of boost::hash_combine). */
+    struct PartsHash
+    {
+      size_t
+      operator()(const cont::vector<size_t>& parts) const
+      {
+        size_t seed = 0;
+        for (auto p = parts.begin(); p != parts.end(); ++p)
+          seed ^= *p + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+      }
+    };
+
+    typedef map<string, size_t> CharacteristicsIndex;
+    typedef unordered_map<cont::vector<size_t>, size_t, PartsHash> JointCharacteristicsIndex;
+
+    /* Both indices are only used to set up a kind of variable. Afterwards,
+     * the variables refer to the characteristics table directly. They are
+     * local statics, so that they are ready when the static variables of
+     * other translation units are initialized. */
+    CharacteristicsIndex&
+    characteristics_index()
+    {
+      static CharacteristicsIndex index;
+      return index;
+    }
+
+    JointCharacteristicsIndex&
+    joint_characteristics_index()
+    {
+      static JointCharacteristicsIndex index;
+      return index;
+    }
+
+    /* Guards both indices and the growth of the characteristics table.
+     * (Constant-initialized, so ready before any dynamic initialization.) */
+    mutex registration_mutex;
+  }
+
   DiscreteRandomVariable::CharacteristicsTable DiscreteRandomVariable::characteristics_table_;
+  const size_t DiscreteRandomVariable::no_characteristics_;
   const string DiscreteRandomVariable::empty_string_;
 
   void
   DiscreteRandomVariable::assign_random_value(RandomNumberEngine& rng)
   {
     cpprob_check_debug(
-        characteristics_ != characteristics_table_.end(),
+        characteristics_ != no_characteristics_,
         "DiscreteRandomVariable: Cannot compute random value for an empty random variable.");
 
     /// @todo Creating the variate every time from scratch is slow.
     typedef uniform_int<size_t> Distribution;
-    Distribution distribution(0, characteristics_->second.size_ - 1);
+    Distribution distribution(0, characteristics_table_[characteristics_].size_ - 1);
     variate_generator<RandomNumberEngine&, Distribution> variate(rng,
         distribution);
     value_ = variate();
@@ -34,13 +81,13 @@ namespace cpprob
   DiscreteRandomVariable&
   DiscreteRandomVariable::operator=(const DiscreteRandomVariable& var)
   {
-    cpprob_check_debug(var.characteristics_ != characteristics_table_.end(),
+    cpprob_check_debug(var.characteristics_ != no_characteristics_,
         "DiscreteRandomVariable: Cannot assign from empty random variable.");
     cpprob_check_debug(
-        characteristics_ == characteristics_table_.end() || characteristics_ == var.characteristics_,
+        characteristics_ == no_characteristics_ || characteristics_ == var.characteristics_,
         "DiscreteRandomVariable: Cannot assign random variable " //
-        + var.characteristics_->first + " to random variable "//
-        + characteristics_->first);
+        + characteristics_table_[var.characteristics_].name_ + " to random variable "//
+        + characteristics_table_[characteristics_].name_);
 
     characteristics_ = var.characteristics_;
     value_ = var.value_;
@@ -50,13 +97,13 @@ namespace cpprob
   DiscreteRandomVariable&
   DiscreteRandomVariable::operator=(DiscreteRandomVariable&& var)
   {
-    cpprob_check_debug(var.characteristics_ != characteristics_table_.end(),
+    cpprob_check_debug(var.characteristics_ != no_characteristics_,
         "DiscreteRandomVariable: Cannot assign from empty random variable.");
     cpprob_check_debug(
-        characteristics_ == characteristics_table_.end() || characteristics_ == var.characteristics_,
+        characteristics_ == no_characteristics_ || characteristics_ == var.characteristics_,
         "DiscreteRandomVariable: Cannot assign random variable " //
-        + var.characteristics_->first + " to random variable "//
-        + characteristics_->first);
+        + characteristics_table_[var.characteristics_].name_ + " to random variable "//
+        + characteristics_table_[characteristics_].name_);
 
     characteristics_ = var.characteristics_;
     value_ = var.value_;
@@ -66,8 +113,8 @@ namespace cpprob
   ostream&
   DiscreteRandomVariable::put_out(ostream& os) const
   {
-    if (characteristics_ != characteristics_table_.end())
-      return os << characteristics_->first << ":" << value_;
+    if (characteristics_ != no_characteristics_)
+      return os << characteristics_table_[characteristics_].name_ << ":" << value_;
     else
       return os << "(empty random variable)";
   }
@@ -75,34 +122,96 @@ namespace cpprob
   ostream&
   DiscreteRandomVariable::put_out_characteristics_table(ostream& os) const
   {
+    lock_guard<mutex> lock(registration_mutex);
     os << "Characteristics table:\n";
-    for (CharacteristicsTable::iterator it = characteristics_table_.begin();
-        it != characteristics_table_.end(); ++it)
+    const CharacteristicsIndex& index = characteristics_index();
+    for (auto it = index.begin(); it != index.end(); ++it)
     {
-      os << it->first << ": " << it->second.size_ << "\n";
+      os << it->first << ": " << characteristics_table_[it->second].size_
+          << "\n";
     }
     return os;
   }
 
   //----------------------------------------------------------------------------
 
-  DiscreteRandomVariable::CharacteristicsTable::iterator
+  DiscreteRandomVariable::CharacteristicsTable::~CharacteristicsTable()
+  {
+    for (size_t c = 0; c != max_chunks; ++c)
+      delete[] chunks_[c].load(memory_order_relaxed);
+  }
+
+  size_t
+  DiscreteRandomVariable::CharacteristicsTable::push_back(const string& name,
+      size_t size)
+  {
+    const size_t characteristics = size_;
+    const size_t chunk = characteristics >> chunk_bits;
+    if (chunk == max_chunks)
+      cpprob_throw(length_error,
+          "DiscreteRandomVariable: The characteristics table is full. Cannot add the variable " << name << ".");
+
+    Characteristics* entries = chunks_[chunk].load(memory_order_relaxed);
+    if (entries == 0)
+    {
+      entries = new Characteristics[chunk_size];
+      chunks_[chunk].store(entries, memory_order_release);
+    }
+    Characteristics& entry = entries[characteristics & (chunk_size - 1)];
+    entry.name_ = name;
+    entry.size_ = size;
+    ++size_;
+    return characteristics;
+  }
+
+  //----------------------------------------------------------------------------
+
+  size_t
   DiscreteRandomVariable::set_up_characteristics(const string& name,
       size_t size)
   {
-    auto characteristics = characteristics_table_.lower_bound(name);
+    lock_guard<mutex> lock(registration_mutex);
+    CharacteristicsIndex& index = characteristics_index();
+    auto found = index.lower_bound(name);
+    if (found != index.end() && found->first == name)
+      return found->second;
+
+    const size_t characteristics = characteristics_table_.push_back(name,
+        size);
+    index.insert(found, make_pair(name, characteristics));
+    return characteristics;
+  }
+
+  size_t
+  DiscreteRandomVariable::set_up_joint_characteristics(
+      const cont::vector<size_t>& parts)
+  {
+    if (parts.empty())
+      return set_up_characteristics(empty_string_, 1);
+    if (parts.size() == 1)
+      return parts.front();
+
+    {
+      lock_guard<mutex> lock(registration_mutex);
+      JointCharacteristicsIndex& index = joint_characteristics_index();
+      auto found = index.find(parts);
+      if (found != index.end())
+        return found->second;
+    }
 
-    if (characteristics == characteristics_table_.end()
-        || characteristics->first != name)
+    string name;
+    size_t size = 1;
+    for (auto p = parts.begin(); p != parts.end(); ++p)
     {
-      if (characteristics == characteristics_table_.begin())
-        return characteristics_table_.insert(
-            make_pair(name, Characteristics(size))).first;
-      else
-        return characteristics_table_.insert(--characteristics,
-            make_pair(name, Characteristics(size)));
+      name += characteristics_table_[*p].name_;
+      size *= characteristics_table_[*p].size_;
     }
+    const size_t characteristics = set_up_characteristics(name, size);
 
+    /* Another thread may have registered the same parts meanwhile. Then it
+     * got the same entry by the same name. */
+    lock_guard<mutex> lock(registration_mutex);
+    joint_characteristics_index().insert(make_pair(parts, characteristics));
     return characteristics;
   }
 
@@ -21,6 +21,8 @@
 #include "RandomVariable.hpp"
 #include "Error.hpp"
 #include "cont/map.hpp"
+#include "cont/vector.hpp"
+#include <atomic>
 #include <iterator>
 #include <stdexcept>
 #include <type_traits>
@@ -122,9 +124,9 @@ namespace cpprob
           const DiscreteRandomVariable& var2) const
       {
         cpprob_check_debug(
-            var1.characteristics_ != DiscreteRandomVariable::characteristics_table_.end() && var2.characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+            var1.characteristics_ != no_characteristics_ && var2.characteristics_ != no_characteristics_,
             "DiscreteRandomVariable: Cannot compare a variable that is not associated with a set of observations.");
-        return var1.characteristics_->first < var2.characteristics_->first;
+        return characteristics_table_[var1.characteristics_].name_ < characteristics_table_[var2.characteristics_].name_;
       }
 
     };
@@ -160,17 +162,17 @@ namespace cpprob
       operator()(const DiscreteRandomVariable& var1,
           const DiscreteRandomVariable& var2) const
       {
-        /* The default value of characteristics, i.e. characteristics_table_.end(),
+        /* The default value of characteristics, i.e. no_characteristics_,
          * is taken as the highest value. So the ordering of the random variable
-         * store objects is in order of the iterators of CharacteristicsTable.
+         * store objects is in order of the names in the CharacteristicsTable.
          * The sub-ordering criterion, in case both iterators are the same,
          * is the value_. */
-        if (var1.characteristics_ == characteristics_table_.end())
+        if (var1.characteristics_ == no_characteristics_)
           /* No element can be larger than characteristics.
            * (value_ cannot be set.) */
           return false;
 
-        else if (var2.characteristics_ == characteristics_table_.end())
+        else if (var2.characteristics_ == no_characteristics_)
           /* characteristics must be different and thus smaller
            * than var.characteristics. */
           return true;
@@ -179,7 +181,7 @@ namespace cpprob
           return var1.value_ < var2.value_;
 
         else
-          return var1.characteristics_->first < var2.characteristics_->first;
+          return characteristics_table_[var1.characteristics_].name_ < characteristics_table_[var2.characteristics_].name_;
       }
 
     };
@@ -212,10 +214,10 @@ namespace cpprob
           const DiscreteRandomVariable& var2) const
       {
         cpprob_check_debug(
-            var1.characteristics_ != DiscreteRandomVariable::characteristics_table_.end() && var2.characteristics_ != DiscreteRandomVariable::characteristics_table_.end(),
+            var1.characteristics_ != no_characteristics_ && var2.characteristics_ != no_characteristics_,
             "DiscreteRandomVariable: Cannot compare a variable that is not associated with a set of observations.");
         cpprob_check_debug(
-            var1.characteristics_->second.size_ != 0 && var1.characteristics_->second.size_ != 0,
+            characteristics_table_[var1.characteristics_].size_ != 0 && characteristics_table_[var1.characteristics_].size_ != 0,
             "DiscreteRandomVariable: Cannot compare a variable with an empty set of observations.");
         return var1.value_ < var2.value_;
       }
@@ -233,6 +235,18 @@ namespace cpprob
       Range()
       {}
 
+      /**
+       * Provides the value with the given index (see
+       * DiscreteRandomVariable::value_index()).
+       */
+      const_iterator
+      at(std::size_t index) const
+      {
+        cpprob_check_debug(index < size(),
+            "DiscreteRandomVariable: The index " << index << " is not in the range of size " << size() << ".");
+        return DiscreteRandomVariable(characteristics_, index);
+      }
+
       const_iterator
       begin() const
       {
@@ -242,37 +256,36 @@ namespace cpprob
       bool
       empty() const
       {
-        return characteristics_ == characteristics_table_.end()
-            || characteristics_->second.size_ == 0;
+        return characteristics_ == no_characteristics_
+            || characteristics_table_[characteristics_].size_ == 0;
       }
 
       const_iterator
       end() const
       {
-        if (characteristics_ == characteristics_table_.end())
+        if (characteristics_ == no_characteristics_)
           return DiscreteRandomVariable(characteristics_, 0);
         else
           return DiscreteRandomVariable(characteristics_,
-              characteristics_->second.size_);
+              characteristics_table_[characteristics_].size_);
       }
 
       std::size_t
       size() const
       {
-        if (characteristics_ == characteristics_table_.end())
+        if (characteristics_ == no_characteristics_)
           return 0;
         else
-          return characteristics_->second.size_;
+          return characteristics_table_[characteristics_].size_;
       }
 
     private:
 
-      typedef cont::map<std::string, Characteristics> CharacteristicsTable;
       friend class DiscreteRandomVariable;
 
-      CharacteristicsTable::iterator characteristics_;
+      std::size_t characteristics_;
 
-      Range(const CharacteristicsTable::iterator& characteristics)
+      Range(std::size_t characteristics)
           : characteristics_(characteristics)
       {
       }
@@ -297,7 +310,7 @@ namespace cpprob
      * - <tt>this->%value_range().size() == 0</tt>.
      */
     DiscreteRandomVariable()
-        : characteristics_(characteristics_table_.end()), value_(0)
+        : characteristics_(no_characteristics_), value_(0)
     {
     }
 
@@ -327,8 +340,8 @@ namespace cpprob
         const std::string&
         name() const
         {
-          if (characteristics_ != characteristics_table_.end())
-          return characteristics_->first;
+          if (characteristics_ != no_characteristics_)
+          return characteristics_table_[characteristics_].name_;
           else
           return empty_string_;
         }
@@ -354,7 +367,7 @@ namespace cpprob
         virtual DiscreteRandomVariable&
         operator--()
         {
-          cpprob_check_debug(characteristics_ != characteristics_table_.end(),
+          cpprob_check_debug(characteristics_ != no_characteristics_,
               "DiscreteRandomVariable: Cannot decrement an empty random variable.");
           cpprob_check_debug( value_ > 0,
               "DiscreteRandomVariable: Cannot decrement the value " << value_ //
@@ -386,7 +399,7 @@ namespace cpprob
         virtual DiscreteRandomVariable
         operator--(int)
         {
-          cpprob_check_debug(characteristics_ != characteristics_table_.end(),
+          cpprob_check_debug(characteristics_ != no_characteristics_,
               "DiscreteRandomVariable: Cannot decrement an empty random variable.");
           cpprob_check_debug( value_ > 0,
               "DiscreteRandomVariable: Cannot decrement the value " << value_ //
@@ -418,12 +431,12 @@ namespace cpprob
         virtual DiscreteRandomVariable&
         operator++()
         {
-          cpprob_check_debug(characteristics_ != characteristics_table_.end(),
+          cpprob_check_debug(characteristics_ != no_characteristics_,
               "DiscreteRandomVariable: Cannot increment an empty random variable.");
-          cpprob_check_debug( value_ < characteristics_->second.size_,
+          cpprob_check_debug( value_ < characteristics_table_[characteristics_].size_,
               "DiscreteRandomVariable: Cannot increment the value " << value_ //
               << " of the variable " << name() << " above the maximum "//
-              << characteristics_->second.size_ << ".");
+              << characteristics_table_[characteristics_].size_ << ".");
 
           ++value_;
           return *this;
@@ -451,12 +464,12 @@ namespace cpprob
         virtual DiscreteRandomVariable
         operator++(int)
         {
-          cpprob_check_debug(characteristics_ != characteristics_table_.end(),
+          cpprob_check_debug(characteristics_ != no_characteristics_,
               "DiscreteRandomVariable: Cannot increment an empty random variable.");
-          cpprob_check_debug( value_ < characteristics_->second.size_,
+          cpprob_check_debug( value_ < characteristics_table_[characteristics_].size_,
               "DiscreteRandomVariable: Cannot increment the value " << value_ //
               << " of the variable " << name() << " above the maximum "//
-              << characteristics_->second.size_ << ".");
+              << characteristics_table_[characteristics_].size_ << ".");
 
           DiscreteRandomVariable tmp = *this;
           ++value_;
@@ -480,8 +493,8 @@ namespace cpprob
         bool
         operator==(const DiscreteRandomVariable& i) const
         {
-          if (characteristics_ == characteristics_table_.end()
-              || i.characteristics_ == characteristics_table_.end())
+          if (characteristics_ == no_characteristics_
+              || i.characteristics_ == no_characteristics_)
           return characteristics_ == i.characteristics_;
           else
           return value_ == i.value_ && characteristics_ == i.characteristics_;
@@ -501,8 +514,8 @@ namespace cpprob
         bool
         operator!=(const DiscreteRandomVariable& i) const
         {
-          if (characteristics_ == characteristics_table_.end()
-              || i.characteristics_ == characteristics_table_.end())
+          if (characteristics_ == no_characteristics_
+              || i.characteristics_ == no_characteristics_)
           return characteristics_ != i.characteristics_;
           else
           return value_ != i.value_ || characteristics_ != i.characteristics_;
@@ -528,7 +541,7 @@ namespace cpprob
         {
           cpprob_check_debug(
               characteristics_ == var.characteristics_,
-              "DiscreteRandomVariable: Can only compare outcomes of the same kind of random variable, but found the two types " << characteristics_->first << " and " << var.characteristics_->first);
+              "DiscreteRandomVariable: Can only compare outcomes of the same kind of random variable, but found the two types " << characteristics_table_[characteristics_].name_ << " and " << characteristics_table_[var.characteristics_].name_);
           return value_ < var.value_;
         }
 
@@ -618,21 +631,87 @@ namespace cpprob
           return Range(characteristics_);
         }
 
-      protected:
+        /**
+         * Provides the index that represents the value of this variable. The
+         * values of the range have the indices 0 up to the size of the range
+         * in their order; so the index can address arrays of per-value data.
+         *
+         * @return the index of the value
+         * @throw None
+         * @see Range::at()
+         */
+        std::size_t
+        value_index() const
+        {
+          return value_;
+        }
 
         /**
-         * Type of an entry in the characteristics table.
+         * Provides the interned ID of the kind of this variable, i.e. the index
+         * of its entry in the characteristics table. Two variables are of the
+         * same kind if and only if their IDs are equal.
          *
-         * @see #CharacteristicsTable
+         * @return the ID of the kind
+         * @throw None
          */
-        struct Characteristics
+        std::size_t
+        kind_id() const
         {
-          Characteristics(std::size_t size)
+          return characteristics_;
+        }
+
+      protected:
+
+        /**
+         * Size of a kind of variable in the characteristics table. The size of
+         * a kind may change, while variables of this kind are in use (e.g. a
+         * RandomInteger that is created with a new size or a joint variable,
+         * whose parts have grown). Several threads may read the size during
+         * this, so the size is atomic. The size carries no other data, so
+         * relaxed loads and stores are sufficient; they compile to ordinary
+         * loads and stores.
+         *
+         * The atomic only makes the accesses well defined. There is still one
+         * size per kind for the whole program; see #CharacteristicsTable.
+         */
+        class AtomicSize
+        {
+
+        public:
+
+          AtomicSize(std::size_t size = 0)
           : size_(size)
           {
           }
 
-          std::size_t size_;
+          operator std::size_t() const
+          {
+            return size_.load(std::memory_order_relaxed);
+          }
+
+          AtomicSize&
+          operator=(std::size_t size)
+          {
+            size_.store(size, std::memory_order_relaxed);
+            return *this;
+          }
+
+        private:
+
+          std::atomic<std::size_t> size_;
+
+        };
+
+        /**
+         * Type of an entry in the characteristics table. The name is written
+         * once, before the index of the entry is handed out.
+         *
+         * @see #CharacteristicsTable
+         */
+        struct Characteristics
+        {
+          std::string name_;
+          AtomicSize size_;
         };
 
         /**
@@ -651,8 +730,79 @@ namespace cpprob
          * names. The set of outcomes is described here by the size of the index
          * set.
          *
+         * Every kind of variable is interned once: its entry gets a dense
+         * integer index, by which the variables refer to it. So the name and
+         * size of a variable are an indexed access away, and joint variables
+         * find their entry by the indices of their parts (see
+         * #set_up_joint_characteristics) instead of by a concatenated name.
+         *
+         * The table is shared by all networks, also by networks on different
+         * threads. It stores the entries in chunks, which are never moved or
+         * freed until the end of the program. So reading an entry needs no
+         * lock, and name() may return a reference to the name. New entries are
+         * only added in #set_up_characteristics and
+         * #set_up_joint_characteristics under a lock.
+         *
+         * The size of a kind is global, though. A network that resizes a kind
+         * resizes it for all networks. This is what a Dirichlet process does
+         * with its component variable (see
+         * DirichletProcessParameters::create_component()). So two networks
+         * with the same Dirichlet process, like a network and its copy, are
+         * not independent: They must not be sampled side by side, neither on
+         * one thread nor on several.
+         *
+         * The table has no constructor on purpose: As a static object, it is
+         * zero-initialized before any dynamic initialization, so static
+         * variables of other translation units can already use it.
+         */
+        class CharacteristicsTable
+        {
+
+        public:
+
+          ~CharacteristicsTable();
+
+          Characteristics&
+          operator[](std::size_t characteristics)
+          {
+            return chunks_[characteristics >> chunk_bits].load(
+                std::memory_order_acquire)[characteristics & (chunk_size - 1)];
+          }
+
+          /**
+           * Appends an entry. The caller must hold the registration lock.
+           *
+           * @return the index of the new entry
+           * @throw std::length_error The table is full.
+           */
+          std::size_t
+          push_back(const std::string& name, std::size_t size);
+
+          /**
+           * The caller must hold the registration lock.
+           */
+          std::size_t
+          size() const
+          {
+            return size_;
+          }
+
+        private:
+
+          static const std::size_t chunk_bits = 10;
+          static const std::size_t chunk_size = std::size_t(1) << chunk_bits;
+          static const std::size_t max_chunks = std::size_t(1) << 14;
+
+          std::atomic<Characteristics*> chunks_[max_chunks];
+          std::size_t size_;
+
+        };
+
+        /**
+         * Index of the kind of variable that is not associated with a set of
+         * observations.
          */
-        typedef cont::map<std::string, Characteristics> CharacteristicsTable;
+        static const std::size_t no_characteristics_ = static_cast<std::size_t>(-1);
 
         /**
          * String that is used as the name of an uninitialized variable. Since
@@ -669,13 +819,13 @@ namespace cpprob
         static CharacteristicsTable characteristics_table_;
 
         /**
-         * Iterator to the entry in the characteristics table that describes this
-         * discrete random variable. Through this iterator, the variable knows its
+         * Index of the entry in the characteristics table that describes this
+         * discrete random variable. Through this index, the variable knows its
          * name and its size.
          *
          * @see #CharacteristicsTable
          */
-        CharacteristicsTable::iterator characteristics_;
+        std::size_t characteristics_;
 
         /**
          * Index that represents the value of this discrete random variable. To
@@ -692,14 +842,13 @@ namespace cpprob
          * entry in the characteristics table. So this constructor avoid a search
          * in the characteristics table.
          *
-         * @param characteristics an iterator to the name and size in the
+         * @param characteristics the index of the name and size in the
          *             characteristics table
          * @param value the index that represent the outcome stored in this variable
          * @throw None
          */
         DiscreteRandomVariable(
-            const CharacteristicsTable::iterator& characteristics,
-            std::size_t value)
+            std::size_t characteristics, std::size_t value)
         : characteristics_(characteristics), value_(value)
         {
         }
@@ -739,23 +888,42 @@ namespace cpprob
         put_out_characteristics_table(std::ostream& os) const;
 
         /**
-         * Configures the characteristics data structure and iterator. This method
-         * looks for an entry in the characteristics table with the same name as
-         * the given name. If this entry is found, #characteristics_ is set to
-         * point to this entry. If no entry with the given name is found, a new
-         * entry is added to the characteristics table. The new entry has the
-         * given name and the given size property.
+         * Provides the entry in the characteristics table for the given name.
+         * This method looks for an entry in the characteristics table with the
+         * same name as the given name. If this entry is found, its index is
+         * returned. If no entry with the given name is found, a new entry is
+         * added to the characteristics table. The new entry has the given name
+         * and the given size property. This method may be called from several
+         * threads at the same time.
          *
          * Note: If an entry with the given name already exists in the
          * characteristics table, the @c size parameter is ignored.
          *
          * @param name the name of this random random variable
          * @param size the size of the value range of this random variable
-         * @throw None
+         * @return the index of the entry
+         * @throw std::length_error The characteristics table is full.
          */
-        static CharacteristicsTable::iterator
+        static std::size_t
         set_up_characteristics(const std::string& name, std::size_t size);
 
+        /**
+         * Provides the entry in the characteristics table for the joint
+         * variable of the given parts. The parts are given by the indices of
+         * their entries in the order of their names. The entry is looked up
+         * by a hash of these indices. If it does not exist yet, a new entry is
+         * created with the concatenated names of the parts and the product of
+         * their sizes (or the existing entry with this name is taken). A joint
+         * variable of a single part shares the entry of this part. This
+         * method may be called from several threads at the same time.
+         *
+         * @param parts the indices of the parts in the order of their names
+         * @return the index of the entry for the joint variable
+         * @throw std::length_error The characteristics table is full.
+         */
+        static std::size_t
+        set_up_joint_characteristics(const cont::vector<std::size_t>& parts);
+
       private:
 
         friend class DiscreteJointRandomVariable;
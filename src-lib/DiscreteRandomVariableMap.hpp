@@ -101,6 +101,11 @@ namespace cpprob
       {
       }
 
+      ConstIterator_(const Self_& right)
+          : node_(right.node_)
+      {
+      }
+
       ConstIterator_(const NonConstIterator& right)
           : node_(right.node_)
       {
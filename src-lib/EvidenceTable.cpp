@@ -0,0 +1,86 @@
+/*
+ * EvidenceTable.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "EvidenceTable.hpp"
+#include <algorithm>
+#include <ostream>
+
+using namespace std;
+
+namespace cpprob
+{
+
+  ostream&
+  operator<<(ostream& os, const EvidenceTable& table)
+  {
+    os << "Evidence table " << table.name() << " with " << table.size()
+        << " rows\n";
+    os << "  Columns: ";
+    string prefix;
+    for (auto c = table.columns_.begin(); c != table.columns_.end(); ++c)
+    {
+      os << prefix << c->kind_.name();
+      prefix = ", ";
+    }
+    return os << "\n";
+  }
+
+  EvidenceTable::EvidenceTable(const string& name)
+      : name_(name), columns_()
+  {
+  }
+
+  DiscreteRandomVariable
+  EvidenceTable::at(size_t row, const DiscreteRandomVariable& kind) const
+  {
+    const Column* column = find(kind);
+    if (column == 0)
+      cpprob_throw_out_of_range(
+          "EvidenceTable: The table " << name_ << " has no column " << kind.name() << ".");
+    if (row >= column->values_.size())
+      cpprob_throw_out_of_range(
+          "EvidenceTable: The column " << kind.name() << " of the table " << name_ << " has no row " << row << ".");
+    return kind.value_range().at(column->values_[row]);
+  }
+
+  const EvidenceTable::Column*
+  EvidenceTable::find(const DiscreteRandomVariable& kind) const
+  {
+    for (auto c = columns_.begin(); c != columns_.end(); ++c)
+    {
+      if (c->kind_.kind_id() == kind.kind_id())
+        return &(*c);
+    }
+    return 0;
+  }
+
+  void
+  EvidenceTable::insert(const DiscreteRandomVariable& value)
+  {
+    if (value.value_range().empty())
+      cpprob_throw_invalid_argument(
+          "EvidenceTable: Cannot insert an empty random variable into the table " << name_ << ".");
+
+    Column* column = const_cast<Column*>(find(value));
+    if (column == 0)
+    {
+      columns_.push_back(Column(value));
+      column = &columns_.back();
+    }
+    column->values_.push_back(value.value_index());
+  }
+
+  size_t
+  EvidenceTable::size() const
+  {
+    size_t rows = 0;
+    for (auto c = columns_.begin(); c != columns_.end(); ++c)
+      rows = max(rows, c->values_.size());
+    return rows;
+  }
+
+} /* namespace cpprob */
@@ -0,0 +1,123 @@
+/**
+ * @file EvidenceTable.hpp
+ * Table of observed values of several random variables.
+ *
+ * @author Walter Bamberger
+ *
+ * @par License
+ * Copyright (C) 2011 Walter Bamberger
+ * @par
+ * This file is part of CPProb.
+ * @par
+ * CPProb is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version, with the
+ * exceptions mentioned in the file LICENSE.txt.
+ * @par
+ * CPProb is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * @par
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with CPProb.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVIDENCETABLE_HPP_
+#define EVIDENCETABLE_HPP_
+
+#include "DiscreteRandomVariable.hpp"
+#include "cont/vector.hpp"
+
+namespace cpprob
+{
+
+  /**
+   * Table of i.i.d. observations. Every column holds the values of one kind
+   * of random variable, every row is one observation. The values of a column
+   * are stored contiguously as the indices of the outcomes, without a
+   * DiscreteRandomVariable object per value. So a table with many rows needs
+   * little memory and can be scanned fast. A PlateNode takes the values of
+   * its observed template variables from such a table.
+   */
+  class EvidenceTable
+  {
+
+  public:
+
+    explicit
+    EvidenceTable(const std::string& name = "");
+
+    // Use the implicit destructor, so the implicit copy and move operations
+    // are generated by the compiler.
+
+    /**
+     * Provides the value in the given row of the column of the given kind of
+     * variable.
+     *
+     * @param row the index of the row
+     * @param kind a variable of the kind of the column
+     * @throw std::out_of_range The table does not have a column of this kind
+     *     or the column does not have this row.
+     */
+    DiscreteRandomVariable
+    at(std::size_t row, const DiscreteRandomVariable& kind) const;
+
+    bool
+    has_column(const DiscreteRandomVariable& kind) const
+    {
+      return find(kind) != 0;
+    }
+
+    /**
+     * Appends the value to the column of its kind. The first value of a kind
+     * adds a new column.
+     */
+    void
+    insert(const DiscreteRandomVariable& value);
+
+    const std::string&
+    name() const
+    {
+      return name_;
+    }
+
+    /**
+     * Provides the number of rows, i.e. the length of the longest column.
+     */
+    std::size_t
+    size() const;
+
+  private:
+
+    friend class PlateNode;
+
+    friend std::ostream&
+    operator<<(std::ostream& os, const EvidenceTable& table);
+
+    struct Column
+    {
+      Column(const DiscreteRandomVariable& kind)
+          : kind_(kind), values_()
+      {
+      }
+
+      DiscreteRandomVariable kind_;
+      cont::vector<std::size_t> values_;
+    };
+
+    typedef cont::vector<Column> Columns;
+
+    std::string name_;
+    Columns columns_;
+
+    const Column*
+    find(const DiscreteRandomVariable& kind) const;
+
+  };
+
+} /* namespace cpprob */
+
+#endif /* EVIDENCETABLE_HPP_ */
@@ -0,0 +1,222 @@
+/*
+ * MarkovBlanketKernel.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "MarkovBlanketKernel.hpp"
+#include "CategoricalDistribution.hpp"
+#include "ConditionalCategoricalNode.hpp"
+#include "ConditionalDirichletNode.hpp"
+
+using namespace std;
+
+namespace cpprob
+{
+
+  MarkovBlanketKernel::MarkovBlanketKernel()
+      : is_compiled_(false), children_(), parent_values_(), parent_strides_(),
+          dense_rows_(), map_probabilities_()
+  {
+  }
+
+  MarkovBlanketKernel::MarkovBlanketKernel(const MarkovBlanketKernel&)
+      : is_compiled_(false), children_(), parent_values_(), parent_strides_(),
+          dense_rows_(), map_probabilities_()
+  {
+  }
+
+  MarkovBlanketKernel&
+  MarkovBlanketKernel::operator=(const MarkovBlanketKernel&)
+  {
+    clear();
+    return *this;
+  }
+
+  void
+  MarkovBlanketKernel::clear()
+  {
+    is_compiled_ = false;
+    children_.clear();
+    parent_values_.clear();
+    parent_strides_.clear();
+    dense_rows_.clear();
+    map_probabilities_.clear();
+  }
+
+  void
+  MarkovBlanketKernel::compile(const DiscreteRandomVariable& var,
+      const DiscreteNode::Children& children)
+  {
+    clear();
+
+    for (auto c = children.begin(); c != children.end(); ++c)
+    {
+      const RandomConditionalProbabilities& probabilities = c->probabilities();
+      ChildKernel child;
+      child.value = &c->value();
+      child.probabilities = &probabilities;
+      child.revision = probabilities.revision();
+      child.is_dense = probabilities.layout()
+          == RandomConditionalProbabilities::dense_layout;
+      child.row_size = child.is_dense ?
+          probabilities.row_size() : c->value().value_range().size();
+      child.own_stride = 0;
+      child.parents_begin = parent_values_.size();
+      child.rows_begin =
+          child.is_dense ? dense_rows_.size() : map_probabilities_.size();
+
+      /* The joint value of the condition is ordered like in
+       * DiscreteRandomReferences::joint_value(): the first variable changes
+       * fastest. */
+      size_t range_size = 1;
+      const DiscreteRandomReferences& condition = c->condition();
+      for (auto p = condition.begin(); p != condition.end(); ++p)
+      {
+        if (p->name() == var.name())
+        {
+          child.own_stride = range_size;
+        }
+        else
+        {
+          parent_values_.push_back(&(*p));
+          parent_strides_.push_back(range_size);
+        }
+        range_size *= p->value_range().size();
+      }
+      child.parents_end = parent_values_.size();
+      cpprob_check_debug(
+          child.own_stride != 0,
+          "MarkovBlanketKernel: The variable " << var.name() << " is not part of the condition of its child " << c->value().name() << ".");
+
+      /* Look up the probabilities once for all joint values. Missing rows
+       * and probabilities are marked with 0 and reported when they are
+       * used. */
+      DiscreteRandomVariable joint = condition.joint_value();
+      const DiscreteRandomVariable::Range joint_range = joint.value_range();
+      const DiscreteRandomVariable::Range value_range =
+          c->value().value_range();
+      for (joint = joint_range.begin(); joint != joint_range.end(); ++joint)
+      {
+        if (child.is_dense)
+        {
+          dense_rows_.push_back(probabilities.row(joint));
+          continue;
+        }
+
+        auto row = probabilities.find(joint);
+        for (auto v = value_range.begin(); v != value_range.end(); ++v)
+        {
+          if (row == probabilities.end())
+          {
+            map_probabilities_.push_back(0);
+          }
+          else
+          {
+            map_probabilities_.push_back(row->second.find_probability(v));
+          }
+        }
+      }
+
+      children_.push_back(child);
+    }
+    is_compiled_ = true;
+  }
+
+  bool
+  MarkovBlanketKernel::is_current() const
+  {
+    if (!is_compiled_)
+      return false;
+
+    for (auto child = children_.begin(); child != children_.end(); ++child)
+    {
+      if (child->probabilities->revision() != child->revision)
+        return false;
+    }
+    return true;
+  }
+
+  bool
+  MarkovBlanketKernel::has_collapsed_children(
+      const DiscreteNode::Children& children)
+  {
+    for (auto c = children.begin(); c != children.end(); ++c)
+    {
+      if (c->counter() != 0 && c->counter()->is_collapsed())
+        return true;
+    }
+    return false;
+  }
+
+  void
+  MarkovBlanketKernel::multiply_collapsed_likelihoods(
+      DiscreteRandomVariable& var, DiscreteNode::Children& children,
+      CategoricalDistribution& distribution)
+  {
+    for (auto d_it = distribution.begin(); d_it != distribution.end(); ++d_it)
+    {
+      var = d_it->first;
+      for (auto c = children.begin(); c != children.end(); ++c)
+      {
+        d_it->second *= c->probabilities().at(c->value(),
+            c->condition().joint_value());
+        c->add_count(1.0f);
+      }
+      for (auto c = children.begin(); c != children.end(); ++c)
+        c->add_count(-1.0f);
+    }
+  }
+
+  void
+  MarkovBlanketKernel::multiply_likelihoods(
+      CategoricalDistribution& distribution) const
+  {
+    cpprob_check_debug(is_current(),
+        "MarkovBlanketKernel: The kernel must be compiled again.");
+    const auto d_end = distribution.end();
+
+    for (auto child = children_.begin(); child != children_.end(); ++child)
+    {
+      size_t offset = 0;
+      for (size_t p = child->parents_begin; p != child->parents_end; ++p)
+        offset += parent_strides_[p] * parent_values_[p]->value_index();
+
+      const size_t value = child->value->value_index();
+      if (value >= child->row_size)
+        cpprob_throw_out_of_range(
+            "MarkovBlanketKernel: The value of the child " << child->value->name() << " is not in its probability table.");
+
+      if (child->is_dense)
+      {
+        const float* const * row = &dense_rows_[child->rows_begin + offset];
+        for (auto d_it = distribution.begin(); d_it != d_end;
+            ++d_it, row += child->own_stride)
+        {
+          if (*row == 0)
+            cpprob_throw_out_of_range(
+                "MarkovBlanketKernel: Could not find a condition of the child " << child->value->name() << " in its probability table.");
+          d_it->second *= (*row)[value];
+        }
+      }
+      else
+      {
+        /* Step from the probability of the value in one row to the one in
+         * the next row. */
+        const size_t stride = child->own_stride * child->row_size;
+        const float* const * probability = &map_probabilities_[child->rows_begin
+            + offset * child->row_size + value];
+        for (auto d_it = distribution.begin(); d_it != d_end;
+            ++d_it, probability += stride)
+        {
+          if (*probability == 0)
+            cpprob_throw_out_of_range(
+                "MarkovBlanketKernel: Could not find a condition of the child " << child->value->name() << " in its probability table.");
+          d_it->second *= **probability;
+        }
+      }
+    }
+  }
+
+} /* namespace cpprob */
@@ -0,0 +1,150 @@
+/*
+ * MarkovBlanketKernel.hpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#ifndef MARKOVBLANKETKERNEL_HPP_
+#define MARKOVBLANKETKERNEL_HPP_
+
+#include "DiscreteNode.hpp"
+#include "cont/vector.hpp"
+
+namespace cpprob
+{
+
+  class CategoricalDistribution;
+  class RandomConditionalProbabilities;
+
+  /**
+   * Precompiled likelihood computation of the children of a discrete node.
+   * During Gibbs sampling, a node multiplies the probabilities of all its
+   * children into its sampling distribution, once for every value of the node.
+   * Doing this with DiscreteRandomReferences::sub_range() and lookups in the
+   * conditional probability tables is slow. This kernel compiles the children
+   * into flat arrays instead: for every child the rows of its probability
+   * table by joint condition value, the stride of the node in this joint
+   * value, and the strides of the other parents. Then a sweep only computes
+   * the offset of the other parents and walks through the rows with the
+   * stride of the node.
+   *
+   * The results are exactly the same as with the lookups: the same
+   * probabilities are multiplied in the same order.
+   *
+   * The kernel refers to the children and keeps pointers to the
+   * probabilities in their tables: the rows in the dense layout and the
+   * single probabilities in the map layout. The nodes compile it in
+   * init_sampling(), when the children are known. A table that moves its
+   * probabilities or changes its rows gets a new
+   * RandomConditionalProbabilities::revision(); this includes the new
+   * components of a Dirichlet process. Then the kernel is no longer current
+   * and must be compiled again. A copy of a kernel is not compiled, because
+   * the copy of a node has other children.
+   */
+  class MarkovBlanketKernel
+  {
+
+  public:
+
+    MarkovBlanketKernel();
+
+    MarkovBlanketKernel(const MarkovBlanketKernel& other);
+
+    MarkovBlanketKernel&
+    operator=(const MarkovBlanketKernel& other);
+
+    /**
+     * Compiles the kernel for the node with the variable var and the given
+     * children.
+     *
+     * @par Requires:
+     * - var is part of the condition of every child.
+     */
+    void
+    compile(const DiscreteRandomVariable& var,
+        const DiscreteNode::Children& children);
+
+    /**
+     * Tells whether the kernel has been compiled and the probability tables
+     * of the children have the revisions they had then. This takes one
+     * comparison per child. If not, the kernel must be compiled again.
+     */
+    bool
+    is_current() const;
+
+    /**
+     * Multiplies the likelihoods of the children into the given distribution.
+     * The distribution contains one entry for every value of the variable in
+     * the order of the values.
+     *
+     * @par Requires:
+     * - is_current()
+     *
+     * @throw std::out_of_range A probability table lacks a probability for a
+     *     joint condition value.
+     */
+    void
+    multiply_likelihoods(CategoricalDistribution& distribution) const;
+
+    /**
+     * Tells whether a child is counted by a collapsed parameter node. Then
+     * the probabilities of the children depend on each other, and the
+     * likelihoods must be computed with multiply_collapsed_likelihoods().
+     */
+    static bool
+    has_collapsed_children(const DiscreteNode::Children& children);
+
+    /**
+     * Multiplies the likelihoods of the children into the given distribution
+     * in the collapsed mode. For every value of var, the children are scored
+     * one after the other: each child adds its count after it has been
+     * scored, so the next child on the same row of a parameter node sees the
+     * predictive distribution given the children before it. This gives the
+     * exact joint likelihood of the children. The counts are taken out again
+     * before the next value.
+     *
+     * @par Requires:
+     * - The children are not counted by their parameter nodes, i.e. their
+     *   counts have been taken out with -1.
+     *
+     * @par Ensures:
+     * - var has an unspecified value of its range.
+     */
+    static void
+    multiply_collapsed_likelihoods(DiscreteRandomVariable& var,
+        DiscreteNode::Children& children,
+        CategoricalDistribution& distribution);
+
+  private:
+
+    struct ChildKernel
+    {
+      const DiscreteRandomVariable* value;
+      const RandomConditionalProbabilities* probabilities;
+      std::size_t revision;
+      /* Rows in the dense layout are taken from dense_rows_; probabilities
+       * in the map layout from map_probabilities_, row_size per row. */
+      bool is_dense;
+      std::size_t row_size;
+      std::size_t own_stride;
+      std::size_t parents_begin;
+      std::size_t parents_end;
+      std::size_t rows_begin;
+    };
+
+    bool is_compiled_;
+    cont::vector<ChildKernel> children_;
+    cont::vector<const DiscreteRandomVariable*> parent_values_;
+    cont::vector<std::size_t> parent_strides_;
+    cont::vector<const float*> dense_rows_;
+    cont::vector<const float*> map_probabilities_;
+
+    void
+    clear();
+
+  };
+
+} /* namespace cpprob */
+
+#endif /* MARKOVBLANKETKERNEL_HPP_ */
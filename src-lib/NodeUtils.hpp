@@ -76,6 +76,38 @@ namespace cpprob
 
   };
 
+  class DiscreteNodeOfNode : public boost::static_visitor<DiscreteNode*>
+  {
+
+  public:
+
+    DiscreteNode*
+    operator()(CategoricalNode& node) const
+    {
+      return &node;
+    }
+
+    DiscreteNode*
+    operator()(ConditionalCategoricalNode& node) const
+    {
+      return &node;
+    }
+
+    DiscreteNode*
+    operator()(DirichletProcessNode& node) const
+    {
+      return &node;
+    }
+
+    template<class N>
+      DiscreteNode*
+      operator()(N&) const
+      {
+        return 0;
+      }
+
+  };
+
   class DiscreteValueOfNode : public boost::static_visitor<
       DiscreteRandomVariable*>
   {
@@ -114,6 +146,12 @@ namespace cpprob
 
   public:
 
+    explicit
+    InitSamplingOfNode(RandomNumberEngine& rne = random_number_engine)
+        : rne_(rne)
+    {
+    }
+
     template<class V, class C>
       void
       operator()(ConstantNode<V, C>) const
@@ -125,12 +163,16 @@ namespace cpprob
       operator()(N& node) const
       {
         if (!node.is_evidence())
-          node.init_sampling();
+          node.init_sampling(rne_);
       }
 
+  private:
+
+    RandomNumberEngine& rne_;
+
   };
 
-  class NameOfNode : public boost::static_visitor<std::string&>
+  class NameOfNode : public boost::static_visitor<const std::string&>
   {
 
   public:
@@ -198,20 +240,39 @@ namespace cpprob
 
   public:
 
+    explicit
+    SampleNode(RandomNumberEngine& rne = random_number_engine)
+        : rne_(rne)
+    {
+    }
+
     template<class V, class C>
       void
       operator()(ConstantNode<V, C>&) const
       {
       }
 
+    /* The parameters of a Dirichlet process run the split-merge moves of
+     * their nodes. */
+    template<class C>
+      void
+      operator()(ConstantNode<DirichletProcessParameters, C>& node) const
+      {
+        node.value().sample(node.children(), rne_);
+      }
+
     template<class N>
       void
       operator()(N& node) const
       {
         if (!node.is_evidence())
-          node.sample();
+          node.sample(rne_);
       }
 
+  private:
+
+    RandomNumberEngine& rne_;
+
   };
 
   class StreamOutPointerValueToString : public boost::static_visitor<std::string>
@@ -0,0 +1,443 @@
+/*
+ * PlateNode.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "PlateNode.hpp"
+#include "DiscreteJointRandomVariable.hpp"
+#include "RandomNumberEngine.hpp"
+#include <algorithm>
+
+using namespace boost;
+using namespace std;
+
+namespace cpprob
+{
+
+  namespace
+  {
+    /* Draws an index from the unnormalized weights with the uniform number
+     * u in [0, 1). Without any positive weight, the current index is kept. */
+    size_t
+    draw_index(const cont::vector<float>& weights, float u, size_t current)
+    {
+      float sum = 0.0f;
+      for (auto w = weights.begin(); w != weights.end(); ++w)
+        sum += *w;
+      if (!(sum > 0.0f))
+        return current;
+
+      const float threshold = u * sum;
+      float cumulative = 0.0f;
+      size_t last = current;
+      for (size_t v = 0; v != weights.size(); ++v)
+      {
+        if (weights[v] <= 0.0f)
+          continue;
+        cumulative += weights[v];
+        last = v;
+        if (threshold < cumulative)
+          return v;
+      }
+      return last;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+
+  void
+  PlateTemplate::add(const DiscreteRandomVariable& value,
+      const cont::vector<DiscreteRandomVariable>& condition,
+      const ParameterNode& parameter_node)
+  {
+    for (auto c = condition.begin(); c != condition.end(); ++c)
+    {
+      auto parent = nodes_.begin();
+      while (parent != nodes_.end() && parent->value_.name() != c->name())
+        ++parent;
+      if (parent == nodes_.end())
+        cpprob_throw_invalid_argument(
+            "PlateTemplate: The condition " << c->name() << " of " << value.name() << " is not a template variable added before.");
+    }
+
+    Node node =
+    { value, condition, parameter_node };
+    nodes_.push_back(node);
+  }
+
+  void
+  PlateTemplate::add_categorical(const DiscreteRandomVariable& value,
+      ConstantRandomProbabilitiesNode& parameter_node)
+  {
+    add(value, cont::vector<DiscreteRandomVariable>(), &parameter_node);
+  }
+
+  void
+  PlateTemplate::add_categorical(const DiscreteRandomVariable& value,
+      DirichletNode& parameter_node)
+  {
+    add(value, cont::vector<DiscreteRandomVariable>(), &parameter_node);
+  }
+
+  void
+  PlateTemplate::add_conditional_categorical(
+      const DiscreteRandomVariable& value,
+      const cont::vector<DiscreteRandomVariable>& condition,
+      ConditionalDirichletNode& parameter_node)
+  {
+    if (condition.empty())
+      cpprob_throw_invalid_argument(
+          "PlateTemplate: The conditional variable " << value.name() << " needs a condition.");
+    add(value, condition, &parameter_node);
+  }
+
+  void
+  PlateTemplate::add_conditional_categorical(
+      const DiscreteRandomVariable& value,
+      const cont::vector<DiscreteRandomVariable>& condition,
+      ConstantRandomConditionalProbabilitiesNode& parameter_node)
+  {
+    if (condition.empty())
+      cpprob_throw_invalid_argument(
+          "PlateTemplate: The conditional variable " << value.name() << " needs a condition.");
+    add(value, condition, &parameter_node);
+  }
+
+  void
+  PlateTemplate::observe(const EvidenceTable& rows) const
+  {
+    const PlateNode plate(*this, rows);
+    plate.observe();
+  }
+
+  //----------------------------------------------------------------------------
+
+  ostream&
+  operator<<(ostream& os, const PlateNode& node)
+  {
+    os << "PlateNode " << node.value().name() << " with " << node.size()
+        << " rows\n";
+    os << "  Template variables: ";
+    string prefix;
+    for (size_t c = 0; c != node.columns_.size(); ++c)
+    {
+      os << prefix << node.template_.nodes()[c].value_.name();
+      if (!node.columns_[c].is_evidence_)
+        os << " (latent)";
+      prefix = ", ";
+    }
+    return os << "\n";
+  }
+
+  PlateNode::PlateNode(const PlateTemplate& template_nodes,
+      const EvidenceTable& evidence_table)
+      : children_(), template_(template_nodes), columns_(),
+          value_(evidence_table.name())
+  {
+    const PlateTemplate::Nodes& nodes = template_.nodes();
+    for (auto e = evidence_table.columns_.begin();
+        e != evidence_table.columns_.end(); ++e)
+    {
+      auto n = nodes.begin();
+      while (n != nodes.end()
+          && n->value_.kind_id() != e->kind_.kind_id())
+        ++n;
+      if (n == nodes.end())
+        cpprob_throw_invalid_argument(
+            "PlateNode: The column " << e->kind_.name() << " of the evidence table " << evidence_table.name() << " is not a template variable.");
+    }
+
+    const size_t rows = evidence_table.size();
+    for (size_t c = 0; c != nodes.size(); ++c)
+    {
+      const PlateTemplate::Node& node = nodes[c];
+
+      /* Take the values of an observed variable from the evidence table. */
+      EvidenceTable::Column values(node.value_);
+      const EvidenceTable::Column* observed = evidence_table.find(node.value_);
+      if (observed != 0)
+      {
+        if (observed->values_.size() != rows)
+          cpprob_throw_invalid_argument(
+              "PlateNode: The column " << node.value_.name() << " of the evidence table " << evidence_table.name() << " has " << observed->values_.size() << " instead of " << rows << " rows.");
+        values.values_ = observed->values_;
+      }
+      else
+      {
+        values.values_.assign(rows, 0);
+      }
+      value_.columns_.push_back(values);
+
+      Column column;
+      column.is_evidence_ = observed != 0;
+      column.size_ = node.value_.value_range().size();
+
+      /* The joint condition value is built like the one of
+       * DiscreteRandomReferences: The first variable in the order of the
+       * names changes fastest. */
+      for (auto p = node.condition_.begin(); p != node.condition_.end(); ++p)
+        column.parents_.push_back(find(*p));
+      sort(column.parents_.begin(), column.parents_.end(),
+          [this](size_t p1, size_t p2)
+          {
+            return value_.columns_[p1].kind_.name() < value_.columns_[p2].kind_.name();
+          });
+      DiscreteJointRandomVariable condition;
+      size_t stride = 1;
+      for (auto p = column.parents_.begin(); p != column.parents_.end(); ++p)
+      {
+        column.strides_.push_back(stride);
+        columns_[*p].children_.push_back(c);
+        columns_[*p].child_strides_.push_back(stride);
+        condition.insert(value_.columns_[*p].kind_.value_range().begin());
+        stride *= columns_[*p].size_;
+      }
+      column.condition_size_ = stride;
+      if (!column.parents_.empty())
+        column.condition_kind_ = condition;
+      columns_.push_back(column);
+    }
+  }
+
+  DiscreteRandomVariable::Range
+  PlateNode::condition_range(const ConditionalDirichletNode& node) const
+  {
+    for (size_t c = 0; c != columns_.size(); ++c)
+    {
+      ConditionalDirichletNode* const * parameter_node = get<
+          ConditionalDirichletNode*>(&template_.nodes()[c].parameter_node_);
+      if (parameter_node != 0 && *parameter_node == &node)
+        return condition_value(c, 0).value_range();
+    }
+    cpprob_throw_invalid_argument(
+        "PlateNode: No template variable of the plate " << value_.name() << " has the parameter node " << node.value().name() << ".");
+  }
+
+  size_t
+  PlateNode::condition_of_row(size_t c, size_t row) const
+  {
+    const Column& column = columns_[c];
+    size_t condition = 0;
+    for (size_t p = 0; p != column.parents_.size(); ++p)
+      condition += value_.columns_[column.parents_[p]].values_[row]
+          * column.strides_[p];
+    return condition;
+  }
+
+  DiscreteRandomVariable
+  PlateNode::condition_value(size_t c, size_t condition) const
+  {
+    return columns_[c].condition_kind_.value_range().at(condition);
+  }
+
+  cont::vector<float>
+  PlateNode::count(size_t c) const
+  {
+    const Column& column = columns_[c];
+    const cont::vector<size_t>& values = value_.columns_[c].values_;
+    cont::vector<float> counts(column.condition_size_ * column.size_, 0.0f);
+    for (size_t row = 0; row != values.size(); ++row)
+      counts[condition_of_row(c, row) * column.size_ + values[row]] += 1.0f;
+    return counts;
+  }
+
+  size_t
+  PlateNode::find(const DiscreteRandomVariable& kind) const
+  {
+    for (size_t c = 0; c != value_.columns_.size(); ++c)
+    {
+      if (value_.columns_[c].kind_.kind_id() == kind.kind_id())
+        return c;
+    }
+    cpprob_throw_out_of_range(
+        "PlateNode: The plate " << value_.name() << " has no template variable " << kind.name() << ".");
+  }
+
+  void
+  PlateNode::init_sampling(RandomNumberEngine& rne)
+  {
+    refresh_probabilities();
+
+    typedef uniform_real<float> Distribution;
+    variate_generator<RandomNumberEngine&, Distribution> canonical(
+        rne, Distribution(0.0f, 1.0f));
+    cont::vector<float> weights;
+
+    /* The template variables are in topological order. So drawing them in
+     * this order draws every row from the prior. */
+    for (size_t c = 0; c != columns_.size(); ++c)
+    {
+      const Column& column = columns_[c];
+      if (column.is_evidence_)
+        continue;
+
+      cont::vector<size_t>& values = value_.columns_[c].values_;
+      for (size_t row = 0; row != values.size(); ++row)
+      {
+        const float* probabilities = &column.probabilities_[condition_of_row(
+            c, row) * column.size_];
+        weights.assign(probabilities, probabilities + column.size_);
+        values[row] = draw_index(weights, canonical(), values[row]);
+      }
+    }
+  }
+
+  bool
+  PlateNode::is_evidence() const
+  {
+    for (auto c = columns_.begin(); c != columns_.end(); ++c)
+    {
+      if (!c->is_evidence_)
+        return false;
+    }
+    return true;
+  }
+
+  bool
+  PlateNode::is_evidence(const DiscreteRandomVariable& kind) const
+  {
+    return columns_[find(kind)].is_evidence_;
+  }
+
+  void
+  PlateNode::is_evidence(const DiscreteRandomVariable& kind,
+      bool value_is_evidence)
+  {
+    columns_[find(kind)].is_evidence_ = value_is_evidence;
+  }
+
+  void
+  PlateNode::observe() const
+  {
+    const PlateTemplate::Nodes& nodes = template_.nodes();
+    for (size_t c = 0; c != columns_.size(); ++c)
+    {
+      const Column& column = columns_[c];
+      bool is_observed = column.is_evidence_;
+      for (auto p = column.parents_.begin(); p != column.parents_.end(); ++p)
+        is_observed = is_observed && columns_[*p].is_evidence_;
+      if (!is_observed)
+        continue;
+
+      const cont::vector<size_t>& values = value_.columns_[c].values_;
+      if (DirichletNode* const * dirichlet = get<DirichletNode*>(
+          &nodes[c].parameter_node_))
+      {
+        for (size_t row = 0; row != values.size(); ++row)
+          (*dirichlet)->observe(value(c, values[row]));
+      }
+      else if (ConditionalDirichletNode* const * conditional_dirichlet = get<
+          ConditionalDirichletNode*>(&nodes[c].parameter_node_))
+      {
+        for (size_t row = 0; row != values.size(); ++row)
+          (*conditional_dirichlet)->observe(
+              condition_value(c, condition_of_row(c, row)),
+              value(c, values[row]));
+      }
+    }
+  }
+
+  void
+  PlateNode::refresh_probabilities()
+  {
+    const PlateTemplate::Nodes& nodes = template_.nodes();
+    for (size_t c = 0; c != columns_.size(); ++c)
+    {
+      Column& column = columns_[c];
+      const PlateTemplate::ParameterNode& parameter_node =
+          nodes[c].parameter_node_;
+      column.probabilities_.assign(column.condition_size_ * column.size_,
+          0.0f);
+
+      const RandomProbabilities* probabilities = 0;
+      const RandomConditionalProbabilities* conditional_probabilities = 0;
+      if (DirichletNode* const * dirichlet = get<DirichletNode*>(
+          &parameter_node))
+        probabilities = &(*dirichlet)->value();
+      else if (ConstantRandomProbabilitiesNode* const * constant = get<
+          ConstantRandomProbabilitiesNode*>(&parameter_node))
+        probabilities = &(*constant)->value();
+      else if (ConditionalDirichletNode* const * conditional_dirichlet = get<
+          ConditionalDirichletNode*>(&parameter_node))
+        conditional_probabilities = &(*conditional_dirichlet)->value();
+      else
+        conditional_probabilities = &get<
+            ConstantRandomConditionalProbabilitiesNode*>(parameter_node)->value();
+
+      if (probabilities != 0)
+      {
+        for (size_t v = 0; v != column.size_; ++v)
+        {
+          auto p = probabilities->find(value(c, v));
+          if (p != probabilities->end())
+            column.probabilities_[v] = p->second;
+        }
+      }
+      else
+      {
+        for (size_t condition = 0; condition != column.condition_size_;
+            ++condition)
+        {
+          const DiscreteRandomVariable condition_var = condition_value(c,
+              condition);
+          for (size_t v = 0; v != column.size_; ++v)
+            column.probabilities_[condition * column.size_ + v] =
+                conditional_probabilities->at(value(c, v), condition_var);
+        }
+      }
+    }
+  }
+
+  void
+  PlateNode::sample(RandomNumberEngine& rne)
+  {
+    refresh_probabilities();
+
+    typedef uniform_real<float> Distribution;
+    variate_generator<RandomNumberEngine&, Distribution> canonical(
+        rne, Distribution(0.0f, 1.0f));
+    cont::vector<float> weights;
+
+    /* One Gibbs step per row and latent variable. The weight of a value is
+     * its probability given the condition in this row times the likelihood
+     * of the values of the children in this row. */
+    for (size_t row = 0; row != size(); ++row)
+    {
+      for (size_t c = 0; c != columns_.size(); ++c)
+      {
+        const Column& column = columns_[c];
+        if (column.is_evidence_)
+          continue;
+
+        size_t& value = value_.columns_[c].values_[row];
+        const float* probabilities = &column.probabilities_[condition_of_row(
+            c, row) * column.size_];
+        weights.assign(probabilities, probabilities + column.size_);
+
+        for (size_t k = 0; k != column.children_.size(); ++k)
+        {
+          const size_t child = column.children_[k];
+          const size_t stride = column.child_strides_[k];
+          const Column& child_column = columns_[child];
+          const size_t child_value = value_.columns_[child].values_[row];
+          const size_t other_condition = condition_of_row(child, row)
+              - value * stride;
+          for (size_t v = 0; v != column.size_; ++v)
+            weights[v] *= child_column.probabilities_[(other_condition
+                + v * stride) * child_column.size_ + child_value];
+        }
+
+        value = draw_index(weights, canonical(), value);
+      }
+    }
+  }
+
+  DiscreteRandomVariable
+  PlateNode::value(size_t c, size_t v) const
+  {
+    return value_.columns_[c].kind_.value_range().at(v);
+  }
+
+} /* namespace cpprob */
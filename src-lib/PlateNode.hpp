@@ -0,0 +1,386 @@
+/**
+ * @file PlateNode.hpp
+ * Node that repeats a set of template variables for every row of a table.
+ *
+ * @author Walter Bamberger
+ *
+ * @par License
+ * Copyright (C) 2011 Walter Bamberger
+ * @par
+ * This file is part of CPProb.
+ * @par
+ * CPProb is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version, with the
+ * exceptions mentioned in the file LICENSE.txt.
+ * @par
+ * CPProb is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ * @par
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with CPProb.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLATENODE_HPP_
+#define PLATENODE_HPP_
+
+#include "ConditionalDirichletNode.hpp"
+#include "ConstantNode.hpp"
+#include "DirichletNode.hpp"
+#include "EvidenceTable.hpp"
+#include <boost/variant/get.hpp>
+#include <boost/variant/variant.hpp>
+
+namespace cpprob
+{
+
+  /**
+   * Description of the variables that a PlateNode repeats for every row of
+   * its table. Every template variable is a categorical variable, whose
+   * probabilities are given by a parameter node outside the plate. A
+   * conditional template variable has template variables as its condition;
+   * they must be added before it.
+   */
+  class PlateTemplate
+  {
+
+  public:
+
+    typedef boost::variant<ConditionalDirichletNode*,
+        ConstantRandomConditionalProbabilitiesNode*,
+        ConstantRandomProbabilitiesNode*, DirichletNode*> ParameterNode;
+
+    struct Node
+    {
+      DiscreteRandomVariable value_;
+      cont::vector<DiscreteRandomVariable> condition_;
+      ParameterNode parameter_node_;
+    };
+
+    typedef cont::vector<Node> Nodes;
+
+    void
+    add_categorical(const DiscreteRandomVariable& value,
+        ConstantRandomProbabilitiesNode& parameter_node);
+
+    void
+    add_categorical(const DiscreteRandomVariable& value,
+        DirichletNode& parameter_node);
+
+    /**
+     * @throw std::invalid_argument A condition variable is not a template
+     *     variable of this plate.
+     */
+    void
+    add_conditional_categorical(const DiscreteRandomVariable& value,
+        const cont::vector<DiscreteRandomVariable>& condition,
+        ConditionalDirichletNode& parameter_node);
+
+    /**
+     * @throw std::invalid_argument A condition variable is not a template
+     *     variable of this plate.
+     */
+    void
+    add_conditional_categorical(const DiscreteRandomVariable& value,
+        const cont::vector<DiscreteRandomVariable>& condition,
+        ConstantRandomConditionalProbabilitiesNode& parameter_node);
+
+    Nodes&
+    nodes()
+    {
+      return nodes_;
+    }
+
+    const Nodes&
+    nodes() const
+    {
+      return nodes_;
+    }
+
+    /**
+     * Folds the rows of the table into the running counts of the Dirichlet
+     * parameter nodes, row by row (see DirichletNode::observe() and
+     * ConditionalDirichletNode::observe()). This is online learning: The
+     * rows need not stay in the network, and learn() or probability() of
+     * the parameter nodes consider them. A template variable is observed
+     * only if the table has a column for it and for its condition.
+     *
+     * @throw std::invalid_argument The table does not fit to the template;
+     *     see PlateNode::PlateNode().
+     */
+    void
+    observe(const EvidenceTable& rows) const;
+
+  private:
+
+    Nodes nodes_;
+
+    void
+    add(const DiscreteRandomVariable& value,
+        const cont::vector<DiscreteRandomVariable>& condition,
+        const ParameterNode& parameter_node);
+
+  };
+
+  /**
+   * Node that stands for one copy of the template variables per row of an
+   * EvidenceTable. This is the plate notation of graphical models: The rows
+   * are i.i.d. given the parameter nodes. Instead of one CategoricalNode or
+   * ConditionalCategoricalNode per row and variable, the plate holds the
+   * values of a template variable in one contiguous column. So a data set
+   * with many rows takes little memory, and learning and sampling scan the
+   * columns without visiting a node per row.
+   *
+   * A template variable with a column in the evidence table is observed in
+   * every row. A template variable without a column is latent; Gibbs
+   * sampling draws its value in every row from its Markov blanket in the
+   * plate. The Dirichlet parameter nodes count the values of the plate like
+   * the values of their children (see DirichletNode::plates() and
+   * ConditionalDirichletNode::plates()).
+   *
+   * @par Requires:
+   * - The parameter nodes are part of the same network and stay there as
+   *   long as the plate.
+   * - The sizes of the template variables do not change. So a plate cannot
+   *   be managed by a DirichletProcessNode.
+   */
+  class PlateNode
+  {
+
+  public:
+
+    /**
+     * A plate has no children. This type exists for the algorithms that
+     * treat all nodes alike.
+     */
+    typedef cont::RefVector<DiscreteNode> Children;
+
+    /**
+     * @throw std::invalid_argument The evidence table has a column that is
+     *     not a template variable or a column that is shorter than the
+     *     table.
+     */
+    PlateNode(const PlateTemplate& template_nodes,
+        const EvidenceTable& evidence_table);
+
+    // Use the implicit destructor, so the implicit copy and move operations
+    // are generated by the compiler.
+
+    /**
+     * Adds the values of the template variables with the given parameter
+     * node to the counters. This is how a DirichletNode learns from or
+     * samples with the plate.
+     *
+     * @param node the parameter node
+     * @param counters a table from the values to the counts, like
+     *     RandomProbabilities or DiscreteRandomVariableMap<float>
+     * @param only_evidence if true, the values of latent template variables
+     *     are not counted
+     */
+    template<class Counters>
+      void
+      add_counts(const DirichletNode& node, Counters& counters,
+          bool only_evidence) const
+      {
+        for (std::size_t c = 0; c != columns_.size(); ++c)
+        {
+          DirichletNode* const* parameter_node = boost::get<DirichletNode*>(
+              &template_.nodes()[c].parameter_node_);
+          if (parameter_node == 0 || *parameter_node != &node
+              || (only_evidence && !columns_[c].is_evidence_))
+            continue;
+
+          const cont::vector<float> counts = count(c);
+          for (std::size_t v = 0; v != counts.size(); ++v)
+          {
+            if (counts[v] != 0.0f)
+              counters[value(c, v)] += counts[v];
+          }
+        }
+      }
+
+    /**
+     * Adds the values of the template variables with the given parameter
+     * node to the counters of their conditions. This is how a
+     * ConditionalDirichletNode learns from or samples with the plate.
+     *
+     * @param node the parameter node
+     * @param counters a table from the condition values to the counters,
+     *     like RandomConditionalProbabilities or
+     *     DiscreteRandomVariableMap<DiscreteRandomVariableMap<float> >
+     * @param only_evidence if true, the values of latent template variables
+     *     are not counted
+     */
+    template<class Counters>
+      void
+      add_counts(const ConditionalDirichletNode& node, Counters& counters,
+          bool only_evidence) const
+      {
+        for (std::size_t c = 0; c != columns_.size(); ++c)
+        {
+          ConditionalDirichletNode* const* parameter_node = boost::get<
+              ConditionalDirichletNode*>(&template_.nodes()[c].parameter_node_);
+          if (parameter_node == 0 || *parameter_node != &node
+              || (only_evidence && !columns_[c].is_evidence_))
+            continue;
+
+          const Column& column = columns_[c];
+          const cont::vector<float> counts = count(c);
+          for (std::size_t condition = 0; condition != column.condition_size_;
+              ++condition)
+          {
+            const float* row = &counts[condition * column.size_];
+            for (std::size_t v = 0; v != column.size_; ++v)
+            {
+              if (row[v] != 0.0f)
+                counters[condition_value(c, condition)][value(c, v)] += row[v];
+            }
+          }
+        }
+      }
+
+    Children&
+    children()
+    {
+      return children_;
+    }
+
+    const Children&
+    children() const
+    {
+      return children_;
+    }
+
+    /**
+     * Provides the range of the condition of the template variables with
+     * the given parameter node.
+     *
+     * @throw std::invalid_argument No template variable has this parameter
+     *     node.
+     */
+    DiscreteRandomVariable::Range
+    condition_range(const ConditionalDirichletNode& node) const;
+
+    /**
+     * Draws the latent values of every row from the current parameters,
+     * in the order of the template variables.
+     */
+    void
+    init_sampling(RandomNumberEngine& rne = random_number_engine);
+
+    /**
+     * Tells whether all template variables are observed.
+     */
+    bool
+    is_evidence() const;
+
+    /**
+     * Tells whether the template variable of the given kind is observed.
+     *
+     * @throw std::out_of_range The kind is not a template variable.
+     */
+    bool
+    is_evidence(const DiscreteRandomVariable& kind) const;
+
+    /**
+     * Marks the template variable of the given kind as observed or latent.
+     * A latent variable keeps its values until it is sampled.
+     *
+     * @throw std::out_of_range The kind is not a template variable.
+     */
+    void
+    is_evidence(const DiscreteRandomVariable& kind, bool value_is_evidence);
+
+    /**
+     * Draws the latent values of every row from their Markov blankets in the
+     * plate. Each row is one Gibbs step per latent variable.
+     */
+    void
+    sample(RandomNumberEngine& rne = random_number_engine);
+
+    std::size_t
+    size() const
+    {
+      return value_.size();
+    }
+
+    const PlateTemplate&
+    template_nodes() const
+    {
+      return template_;
+    }
+
+    /**
+     * Provides the values of all template variables: the observed ones and
+     * the current values of the latent ones.
+     */
+    const EvidenceTable&
+    value() const
+    {
+      return value_;
+    }
+
+  private:
+
+    friend class PlateTemplate;
+
+    friend std::ostream&
+    operator<<(std::ostream& os, const PlateNode& node);
+
+    /* The structure of a template variable and its probabilities. The
+     * values are in the column of the same index in #value_. */
+    struct Column
+    {
+      bool is_evidence_;
+      std::size_t size_;
+      /* Kind of the joint condition variable; empty without parents. */
+      DiscreteRandomVariable condition_kind_;
+      std::size_t condition_size_;
+      /* Condition columns in the order of the names and their strides in
+       * the joint condition value. */
+      cont::vector<std::size_t> parents_;
+      cont::vector<std::size_t> strides_;
+      /* Columns that have this column in their condition and the stride of
+       * this column in their condition values. */
+      cont::vector<std::size_t> children_;
+      cont::vector<std::size_t> child_strides_;
+      /* Copy of the probabilities of the parameter node, one row of size_
+       * values per condition value; refreshed for every sweep. */
+      cont::vector<float> probabilities_;
+    };
+
+    Children children_;
+    PlateTemplate template_;
+    cont::vector<Column> columns_;
+    EvidenceTable value_;
+
+    std::size_t
+    condition_of_row(std::size_t c, std::size_t row) const;
+
+    DiscreteRandomVariable
+    condition_value(std::size_t c, std::size_t condition) const;
+
+    cont::vector<float>
+    count(std::size_t c) const;
+
+    std::size_t
+    find(const DiscreteRandomVariable& kind) const;
+
+    void
+    observe() const;
+
+    void
+    refresh_probabilities();
+
+    DiscreteRandomVariable
+    value(std::size_t c, std::size_t v) const;
+
+  };
+
+} /* namespace cpprob */
+
+#endif /* PLATENODE_HPP_ */
@@ -47,7 +47,7 @@ namespace cpprob
   ostream&
   RandomBoolean::put_out(ostream& os) const
   {
-    return os << characteristics_->first << ":" << value_;
+    return os << characteristics_table_[characteristics_].name_ << ":" << value_;
   }
 
 }
@@ -17,14 +17,22 @@ namespace cpprob
 
   RandomConditionalProbabilities::RandomConditionalProbabilities(
       const DiscreteRandomVariable& var,
-      const DiscreteRandomVariable& condition)
-      : name_("Probabilities" + var.name() + condition.name())
+      const DiscreteRandomVariable& condition, Layout layout)
+      : name_("Probabilities" + var.name() + condition.name()), var_(var),
+          condition_(condition), layout_(map_layout), cpt_(), dense_(),
+          row_size_(var.value_range().size()), revision_(0)
   {
     DiscreteRandomVariable::Range condition_range = condition.value_range();
     if (condition_range.empty())
     {
       cpt_.insert(make_pair(condition, RandomProbabilities(var)));
     }
+    else if (layout == dense_layout && row_size_ != 0)
+    {
+      layout_ = dense_layout;
+      dense_.assign(condition_range.size() * row_size_,
+          1.0f / static_cast<float>(row_size_));
+    }
     else
     {
       for (DiscreteRandomVariable c = condition_range.begin();
@@ -35,21 +43,81 @@ namespace cpprob
     }
   }
 
+  RandomConditionalProbabilities::RandomConditionalProbabilities(
+      const RandomConditionalProbabilities& other)
+      : RandomVariable(other), name_(other.name_), var_(other.var_),
+          condition_(other.condition_), layout_(other.layout_),
+          cpt_(other.cpt_), dense_(other.dense_), row_size_(other.row_size_),
+          revision_(0)
+  {
+  }
+
   RandomConditionalProbabilities::~RandomConditionalProbabilities()
   {
   }
 
+  RandomConditionalProbabilities&
+  RandomConditionalProbabilities::operator=(
+      const RandomConditionalProbabilities& other)
+  {
+    RandomVariable::operator=(other);
+    name_ = other.name_;
+    var_ = other.var_;
+    condition_ = other.condition_;
+    layout_ = other.layout_;
+    cpt_ = other.cpt_;
+    dense_ = other.dense_;
+    row_size_ = other.row_size_;
+    ++revision_;
+    return *this;
+  }
+
   void
   RandomConditionalProbabilities::assign_random_value(RandomNumberEngine& rne)
   {
-    for (iterator i = cpt_.begin(); i != cpt_.end(); ++i)
-      i->second.assign_random_value(rne);
+    if (layout_ == dense_layout)
+    {
+      /* Draw in the same order and with the same arithmetic as
+       * RandomProbabilities::assign_random_value. */
+      typedef uniform_real<float> Distribution;
+      Distribution distribution(0.0f, 1.0f);
+      variate_generator<RandomNumberEngine&, Distribution> variate(rne,
+          distribution);
+
+      for (auto row = dense_.begin(); row != dense_.end(); row += row_size_)
+      {
+        float sum = 0.0;
+        for (auto p = row; p != row + row_size_; ++p)
+        {
+          *p = variate();
+          sum += *p;
+        }
+        for (auto p = row; p != row + row_size_; ++p)
+          *p /= sum;
+      }
+    }
+    else
+    {
+      for (iterator i = cpt_.begin(); i != cpt_.end(); ++i)
+        i->second.assign_random_value(rne);
+    }
   }
 
   float
   RandomConditionalProbabilities::at(const DiscreteRandomVariable& var,
       const DiscreteRandomVariable& condition) const
   {
+    if (layout_ == dense_layout)
+    {
+      const float* r = row(condition);
+      if (r == 0)
+        return 0.0;
+      if (var.value_index() >= row_size_)
+        cpprob_throw_out_of_range(
+            "RandomConditionalProbabilities: Key " << var << " is not in the probability table.");
+      return r[var.value_index()];
+    }
+
     ConditionalProbabilityTable::const_iterator found = cpt_.find(condition);
     if (found != cpt_.end())
       return found->second.at(var);
@@ -57,21 +125,201 @@ namespace cpprob
       return 0.0;
   }
 
+  RandomConditionalProbabilities::const_iterator
+  RandomConditionalProbabilities::begin() const
+  {
+    return const_iterator(this, cpt_.begin(), dense_.begin(),
+        condition_.value_range().begin());
+  }
+
+  RandomConditionalProbabilities::const_iterator
+  RandomConditionalProbabilities::end() const
+  {
+    return const_iterator(this, cpt_.end(), dense_.end(),
+        condition_.value_range().begin());
+  }
+
+  RandomConditionalProbabilities::const_iterator
+  RandomConditionalProbabilities::find(const key_type& condition) const
+  {
+    if (layout_ == map_layout)
+      return const_iterator(this, cpt_.find(condition), dense_.end(),
+          condition);
+
+    const size_t begin = condition.value_index() * row_size_;
+    if (begin >= dense_.size())
+      return end();
+    return const_iterator(this, cpt_.end(), dense_.begin() + begin,
+        condition);
+  }
+
+  void
+  RandomConditionalProbabilities::convert_to_map_layout()
+  {
+    cpt_.clear();
+    const DiscreteRandomVariable::Range var_range = var_.value_range();
+    const DiscreteRandomVariable::Range condition_range =
+        condition_.value_range();
+    auto p = dense_.begin();
+    for (DiscreteRandomVariable c = condition_range.begin(); p != dense_.end();
+        ++c)
+    {
+      RandomProbabilities probabilities(var_);
+      probabilities.clear();
+      DiscreteRandomVariable v = var_range.begin();
+      for (size_t i = 0; i != row_size_; ++i, ++v, ++p)
+        probabilities[v] = *p;
+      cpt_.insert(make_pair(c, probabilities));
+    }
+    dense_.clear();
+    layout_ = map_layout;
+    ++revision_;
+  }
+
+  bool
+  RandomConditionalProbabilities::dense_row_for(
+      const DiscreteRandomVariable& condition)
+  {
+    const size_t rows = dense_.size() / row_size_;
+    if (condition.value_index() < rows)
+      return true;
+
+    if (condition.value_index() == rows)
+    {
+      dense_.resize(dense_.size() + row_size_,
+          1.0f / static_cast<float>(row_size_));
+      ++revision_;
+      return true;
+    }
+
+    convert_to_map_layout();
+    return false;
+  }
+
+  void
+  RandomConditionalProbabilities::layout(Layout new_layout)
+  {
+    if (new_layout == layout_)
+      return;
+
+    if (new_layout == map_layout)
+    {
+      convert_to_map_layout();
+      return;
+    }
+
+    /* The dense layout needs a full row for every condition value from the
+     * first one to the last one. */
+    const size_t row_size = var_.value_range().size();
+    if (row_size == 0)
+      cpprob_throw_logic_error(
+          "RandomConditionalProbabilities: Cannot store the table " << name_ << " of a variable without values in the dense layout.");
+    size_t expected_condition = 0;
+    for (auto c = cpt_.begin(); c != cpt_.end(); ++c, ++expected_condition)
+    {
+      if (c->first.value_index() != expected_condition
+          || c->second.size() != row_size)
+        cpprob_throw_logic_error(
+            "RandomConditionalProbabilities: Cannot store the table " << name_ << " in the dense layout, because it lacks probabilities for condition " << c->first << ".");
+    }
+
+    row_size_ = row_size;
+    dense_.clear();
+    dense_.reserve(cpt_.size() * row_size_);
+    for (auto c = cpt_.begin(); c != cpt_.end(); ++c)
+      for (auto p = c->second.begin(); p != c->second.end(); ++p)
+        dense_.push_back(p->second);
+    cpt_.clear();
+    layout_ = dense_layout;
+    ++revision_;
+  }
+
+  void
+  RandomConditionalProbabilities::normalize()
+  {
+    if (layout_ == dense_layout)
+    {
+      /* The same arithmetic as RandomProbabilities::normalize. */
+      for (auto row = dense_.begin(); row != dense_.end(); row += row_size_)
+      {
+        float sum = 0.0;
+        for (auto p = row; p != row + row_size_; ++p)
+          sum += *p;
+        for (auto p = row; p != row + row_size_; ++p)
+          *p /= sum;
+      }
+    }
+    else
+    {
+      for (iterator p = cpt_.begin(); p != cpt_.end(); ++p)
+        p->second.normalize();
+    }
+  }
+
+  bool
+  RandomConditionalProbabilities::operator==(
+      const RandomConditionalProbabilities& other) const
+  {
+    if (layout_ == dense_layout && other.layout_ == dense_layout)
+      return row_size_ == other.row_size_ && dense_ == other.dense_;
+
+    /* Compare tables of different layouts in the map layout, without
+     * converting the original tables. */
+    RandomConditionalProbabilities this_map(*this);
+    this_map.layout(map_layout);
+    RandomConditionalProbabilities other_map(other);
+    other_map.layout(map_layout);
+    return this_map.cpt_ == other_map.cpt_;
+  }
+
   std::ostream&
   RandomConditionalProbabilities::put_out(std::ostream& os) const
   {
+    if (layout_ == dense_layout)
+    {
+      RandomConditionalProbabilities map_table(*this);
+      map_table.layout(map_layout);
+      return map_table.put_out(os);
+    }
+
     os << name_ << ":";
     for_each(cpt_.begin(), cpt_.end(), StreamOut(os, "\n      (", ")"));
     return os;
   }
 
+  std::ostream&
+  operator<<(std::ostream& os, const RandomConditionalProbabilities::Row& row)
+  {
+    if (row.probabilities_ != 0)
+      return os << *row.probabilities_;
+
+    os << "Probabilities" << row.first_.name() << ":";
+    for_each(row.begin(), row.end(), StreamOut(os, ",", ""));
+    return os;
+  }
+
   void
   RandomConditionalProbabilities::set(const DiscreteRandomVariable& var,
       const DiscreteRandomVariable& condition, float probability)
   {
+    if (layout_ == dense_layout && var.value_index() < row_size_
+        && dense_row_for(condition))
+    {
+      cpprob_check_debug( probability >= 0.0f,
+          "RandomConditionalProbabilities: Probability " << probability << //
+          " not set. A probability must be greater than 0.");
+      cpprob_check_debug( probability <= 1.0f,
+          "RandomConditionalProbabilities: Probability " << probability << //
+          " not set. A probability must be smaller than 1.");
+      dense_[condition.value_index() * row_size_ + var.value_index()] = probability;
+      return;
+    }
+
+    use_map_layout();
     iterator find_it = cpt_.find(condition);
     if (find_it == cpt_.end())
     {
+      ++revision_;
       /// @todo This additional if is superfluous, but maybe useful for test code.
       std::pair<iterator, bool> insert_result = cpt_.insert(
           std::make_pair(condition, RandomProbabilities(var)));
@@ -87,4 +335,32 @@ namespace cpprob
     }
   }
 
+  void
+  RandomConditionalProbabilities::set(const DiscreteRandomVariable& condition,
+      const RandomProbabilities& probabilities)
+  {
+    if (layout_ == dense_layout && probabilities.size() == row_size_
+        && dense_row_for(condition))
+    {
+      float* row = &dense_[condition.value_index() * row_size_];
+      size_t value = 0;
+      for (auto p = probabilities.begin(); p != probabilities.end();
+          ++p, ++value)
+      {
+        cpprob_check_debug(
+            p->first.value_index() == value,
+            "RandomConditionalProbabilities: The probabilities for condition " << condition << " do not match the rows of the table " << name_ << ".");
+        row[value] = p->second;
+      }
+      return;
+    }
+
+    use_map_layout();
+    /* A new row or a row of another size moves probabilities. */
+    auto found = cpt_.find(condition);
+    if (found == cpt_.end() || found->second.size() != probabilities.size())
+      ++revision_;
+    cpt_[condition] = probabilities;
+  }
+
 }
@@ -9,6 +9,7 @@
 #define RANDOMCONDITIONALPROBABILITIES_HPP_
 
 #include "RandomProbabilities.hpp"
+#include "cont/vector.hpp"
 
 namespace cpprob
 {
@@ -31,6 +32,60 @@ namespace std
 namespace cpprob
 {
 
+  /**
+   * Holds a value that an iterator makes on access, so that the iterator
+   * can provide operator->() for it.
+   */
+  template<class T>
+    class ArrowProxy
+    {
+
+    public:
+
+      explicit
+      ArrowProxy(const T& value)
+          : value_(value)
+      {
+      }
+
+      const T*
+      operator->() const
+      {
+        return &value_;
+      }
+
+    private:
+
+      T value_;
+
+    };
+
+  /**
+   * Conditional probability table: one probability table (RandomProbabilities)
+   * for every value of the condition.
+   *
+   * The table can be stored in two layouts. The map layout stores a
+   * DiscreteRandomVariableMap of RandomProbabilities, i.e. one separately
+   * allocated table per condition value. The dense layout stores all
+   * probabilities in one contiguous buffer with one row per condition value;
+   * the probability of var given condition is at
+   * <tt>condition * row_size() + var</tt>. It saves the keys and links of
+   * the map and keeps the rows close together in memory.
+   *
+   * The dense layout serves the element access (#at(var, condition),
+   * #set(), #row()), #normalize() and #size() directly. The const methods
+   * #at(condition), #find() and the const iterators provide rows as Row
+   * views, which read both layouts. The non-const methods that hand out
+   * references to RandomProbabilities objects (#at(condition),
+   * #operator[](), #find(), #insert() and the iterators) switch the table to
+   * the map layout first; so write rows with #set() to keep the dense
+   * layout. The same holds for modifications that the dense layout cannot
+   * represent, like a condition value that does not directly follow the
+   * last row.
+   *
+   * Code that keeps pointers into the table checks #revision() to know
+   * whether the pointers are still valid.
+   */
   class RandomConditionalProbabilities : public RandomVariable
   {
 
@@ -38,19 +93,293 @@ namespace cpprob
 
   public:
 
-    typedef ConditionalProbabilityTable::const_iterator const_iterator;
-    typedef ConditionalProbabilityTable::const_reference const_reference;
     typedef ConditionalProbabilityTable::iterator iterator;
     typedef ConditionalProbabilityTable::key_type key_type;
     typedef ConditionalProbabilityTable::mapped_type mapped_type;
     typedef ConditionalProbabilityTable::value_type value_type;
 
+    enum Layout
+    {
+      map_layout, dense_layout
+    };
+
+    /**
+     * Read-only view of the probabilities of one condition value. It reads
+     * the RandomProbabilities object of the map layout or the row of the
+     * dense layout, and it iterates like a constant RandomProbabilities
+     * object over pairs of a value and its probability. The view is valid
+     * as long as the #revision() of the table does not change.
+     */
+    class Row
+    {
+
+    public:
+
+      /**
+       * Iterates over the pairs of a value and its probability. The pairs
+       * are made on access; so the iterator hands them out by value.
+       */
+      class const_iterator
+      {
+
+      public:
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<DiscreteRandomVariable, float> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type reference;
+        typedef ArrowProxy<value_type> pointer;
+
+        value_type
+        operator*() const
+        {
+          return p_ == 0 ? value_type(*map_it_) : value_type(var_, *p_);
+        }
+
+        pointer
+        operator->() const
+        {
+          return pointer(operator*());
+        }
+
+        const_iterator&
+        operator++()
+        {
+          if (p_ == 0)
+            ++map_it_;
+          else
+          {
+            ++p_;
+            ++var_;
+          }
+          return *this;
+        }
+
+        const_iterator
+        operator++(int)
+        {
+          const_iterator old(*this);
+          operator++();
+          return old;
+        }
+
+        bool
+        operator==(const const_iterator& other) const
+        {
+          return p_ == 0 ? map_it_ == other.map_it_ : p_ == other.p_;
+        }
+
+        bool
+        operator!=(const const_iterator& other) const
+        {
+          return !operator==(other);
+        }
+
+      private:
+
+        friend class Row;
+
+        RandomProbabilities::const_iterator map_it_;
+        /* The probability in the dense layout; 0 in the map layout. */
+        const float* p_;
+        /* The value of the probability in the dense layout. */
+        DiscreteRandomVariable var_;
+
+        const_iterator(RandomProbabilities::const_iterator map_it,
+            const float* p, const DiscreteRandomVariable& var)
+            : map_it_(map_it), p_(p), var_(var)
+        {
+        }
+
+      };
+
+      /**
+       * @throw std::out_of_range The variable has no probability in the row.
+       */
+      float
+      at(const DiscreteRandomVariable& var) const
+      {
+        if (probabilities_ != 0)
+          return probabilities_->at(var);
+        if (var.value_index() >= size_)
+          cpprob_throw_out_of_range(
+              "RandomConditionalProbabilities: Key " << var << " is not in the probability table.");
+        return row_[var.value_index()];
+      }
+
+      const_iterator
+      begin() const
+      {
+        return probabilities_ != 0 ?
+            const_iterator(probabilities_->begin(), 0, first_) :
+            const_iterator(RandomProbabilities::const_iterator(), row_,
+                first_);
+      }
+
+      const_iterator
+      end() const
+      {
+        return probabilities_ != 0 ?
+            const_iterator(probabilities_->end(), 0, first_) :
+            const_iterator(RandomProbabilities::const_iterator(),
+                row_ + size_, first_);
+      }
+
+      /**
+       * Provides the address of the probability of the variable in the
+       * table, or 0 if the row has no probability for it. The address is
+       * valid as long as the view.
+       */
+      const float*
+      find_probability(const DiscreteRandomVariable& var) const
+      {
+        if (probabilities_ != 0)
+        {
+          RandomProbabilities::const_iterator p = probabilities_->find(var);
+          return p == probabilities_->end() ? 0 : &p->second;
+        }
+        return var.value_index() < size_ ? &row_[var.value_index()] : 0;
+      }
+
+      std::size_t
+      size() const
+      {
+        return probabilities_ != 0 ? probabilities_->size() : size_;
+      }
+
+      /**
+       * Writes the row like a RandomProbabilities object of the variable.
+       */
+      friend std::ostream&
+      operator<<(std::ostream& os, const Row& row);
+
+    private:
+
+      friend class RandomConditionalProbabilities;
+
+      /* The row of the map layout, or 0 in the dense layout. */
+      const RandomProbabilities* probabilities_;
+      /* The row of the dense layout and its size. */
+      const float* row_;
+      std::size_t size_;
+      /* The first value of the variable. */
+      DiscreteRandomVariable first_;
+
+      Row(const RandomProbabilities* probabilities, const float* row,
+          std::size_t size, const DiscreteRandomVariable& first)
+          : probabilities_(probabilities), row_(row), size_(size),
+              first_(first)
+      {
+      }
+
+    };
+
+    /**
+     * Iterates over the rows of a constant table in both layouts. It hands
+     * out pairs of a condition value and its Row by value.
+     */
+    class const_iterator
+    {
+
+    public:
+
+      typedef std::forward_iterator_tag iterator_category;
+      typedef std::pair<DiscreteRandomVariable, Row> value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef value_type reference;
+      typedef ArrowProxy<value_type> pointer;
+
+      value_type
+      operator*() const
+      {
+        const DiscreteRandomVariable first = table_->var_.value_range().begin();
+        if (table_->layout_ == map_layout)
+          return value_type(map_it_->first,
+              Row(&map_it_->second, 0, 0, first));
+        return value_type(condition_,
+            Row(0, &*dense_it_, table_->row_size_, first));
+      }
+
+      pointer
+      operator->() const
+      {
+        return pointer(operator*());
+      }
+
+      const_iterator&
+      operator++()
+      {
+        if (table_->layout_ == map_layout)
+          ++map_it_;
+        else
+        {
+          dense_it_ += table_->row_size_;
+          ++condition_;
+        }
+        return *this;
+      }
+
+      const_iterator
+      operator++(int)
+      {
+        const_iterator old(*this);
+        operator++();
+        return old;
+      }
+
+      bool
+      operator==(const const_iterator& other) const
+      {
+        return table_->layout_ == map_layout ?
+            map_it_ == other.map_it_ : dense_it_ == other.dense_it_;
+      }
+
+      bool
+      operator!=(const const_iterator& other) const
+      {
+        return !operator==(other);
+      }
+
+    private:
+
+      friend class RandomConditionalProbabilities;
+
+      const RandomConditionalProbabilities* table_;
+      ConditionalProbabilityTable::const_iterator map_it_;
+      /* The first probability of the row in the dense layout and its
+       * condition value. */
+      cont::vector<float>::const_iterator dense_it_;
+      DiscreteRandomVariable condition_;
+
+      const_iterator(const RandomConditionalProbabilities* table,
+          ConditionalProbabilityTable::const_iterator map_it,
+          cont::vector<float>::const_iterator dense_it,
+          const DiscreteRandomVariable& condition)
+          : table_(table), map_it_(map_it), dense_it_(dense_it),
+              condition_(condition)
+      {
+      }
+
+    };
+
     RandomConditionalProbabilities(const DiscreteRandomVariable& var,
-        const DiscreteRandomVariable& condition);
+        const DiscreteRandomVariable& condition, Layout layout = map_layout);
+
+    /**
+     * Copies the other table in its layout.
+     */
+    RandomConditionalProbabilities(const RandomConditionalProbabilities& other);
 
     virtual
     ~RandomConditionalProbabilities();
 
+    /**
+     * Copies the probabilities of the other table. This is a new revision
+     * of this table.
+     */
+    RandomConditionalProbabilities&
+    operator=(const RandomConditionalProbabilities& other);
+
     virtual void
     assign_random_value(RandomNumberEngine& rne);
 
@@ -59,11 +388,15 @@ namespace cpprob
     at(const DiscreteRandomVariable& var,
         const DiscreteRandomVariable& condition) const;
 
-    const RandomProbabilities&
+    /**
+     * @throw std::out_of_range The table does not contain the condition
+     *     value.
+     */
+    Row
     at(const DiscreteRandomVariable& condition) const
     {
-      ConditionalProbabilityTable::const_iterator f = cpt_.find(condition);
-      if (f == cpt_.end())
+      const_iterator f = find(condition);
+      if (f == end())
         cpprob_throw_out_of_range(
             "RandomConditionalProbabilities: Could not find condition " << condition << " in the probability table.");
       return f->second;
@@ -72,6 +405,8 @@ namespace cpprob
     RandomProbabilities&
     at(const DiscreteRandomVariable& condition)
     {
+      use_map_layout();
+      ++revision_;
       ConditionalProbabilityTable::iterator f = cpt_.find(condition);
       if (f == cpt_.end())
         cpprob_throw_out_of_range(
@@ -82,51 +417,68 @@ namespace cpprob
     iterator
     begin()
     {
+      use_map_layout();
+      ++revision_;
       return cpt_.begin();
     }
 
     const_iterator
-    begin() const
-    {
-      return cpt_.begin();
-    }
+    begin() const;
 
     void
     clear()
     {
       cpt_.clear();
+      dense_.clear();
+      ++revision_;
     }
 
     iterator
     end()
     {
+      use_map_layout();
+      ++revision_;
       return cpt_.end();
     }
 
     const_iterator
-    end() const
-    {
-      return cpt_.end();
-    }
+    end() const;
 
     const_iterator
-    find(const key_type& var) const
-    {
-      return cpt_.find(var);
-    }
+    find(const key_type& var) const;
 
     iterator
     find(const key_type& var)
     {
+      use_map_layout();
+      ++revision_;
       return cpt_.find(var);
     }
 
     iterator
     insert(iterator position, const value_type& v)
     {
+      use_map_layout();
+      ++revision_;
       return cpt_.insert(position, v);
     }
 
+    Layout
+    layout() const
+    {
+      return layout_;
+    }
+
+    /**
+     * Converts the table to the given layout.
+     *
+     * @throw std::logic_error The dense layout is requested, but the table
+     *     does not contain a full row for every condition value from the
+     *     first one up to its last one.
+     */
+    void
+    layout(Layout new_layout);
+
     virtual const std::string&
     name() const
     {
@@ -134,23 +486,18 @@ namespace cpprob
     }
 
     void
-    normalize()
-    {
-      for (iterator p = begin(); p != end(); ++p)
-        p->second.normalize();
-    }
+    normalize();
 
     RandomProbabilities&
     operator[](const DiscreteRandomVariable& condition)
     {
+      use_map_layout();
+      ++revision_;
       return cpt_[condition];
     }
 
     bool
-    operator==(const RandomConditionalProbabilities& other) const
-    {
-      return cpt_ == other.cpt_;
-    }
+    operator==(const RandomConditionalProbabilities& other) const;
 
     bool
     operator!=(const RandomConditionalProbabilities& other) const
@@ -158,14 +505,66 @@ namespace cpprob
       return !operator==(other);
     }
 
+    /**
+     * Counts the changes that may have moved the probabilities in memory or
+     * changed the rows of the table: conversions of the layout, new rows,
+     * clear(), assignments and every non-const access to whole rows. Changing
+     * probabilities with set() in existing rows does not count.
+     */
+    std::size_t
+    revision() const
+    {
+      return revision_;
+    }
+
+    /**
+     * Provides the probabilities of the given condition value in the dense
+     * layout. The row contains #row_size() probabilities in the order of the
+     * values of the variable. The pointer stays valid until the table is
+     * cleared, converted or gets a new row.
+     *
+     * @par Requires:
+     * - <tt>%layout() == dense_layout</tt>.
+     *
+     * @return the first probability of the row or 0 if the table does not
+     *     contain the condition value.
+     */
+    const float*
+    row(const DiscreteRandomVariable& condition) const
+    {
+      cpprob_check_debug(
+          layout_ == dense_layout,
+          "RandomConditionalProbabilities: Cannot access a row of the table " << name_ << " in the map layout.");
+      const std::size_t begin = condition.value_index() * row_size_;
+      return begin < dense_.size() ? &dense_[begin] : 0;
+    }
+
+    /**
+     * Provides the number of probabilities in a row of the dense layout.
+     */
+    std::size_t
+    row_size() const
+    {
+      return row_size_;
+    }
+
     void
     set(const DiscreteRandomVariable& var,
         const DiscreteRandomVariable& condition, float probability);
 
+    /**
+     * Replaces the probabilities of the given condition value. This is
+     * equivalent to <tt>(*this)[condition] = probabilities</tt>, but stays in
+     * the dense layout.
+     */
+    void
+    set(const DiscreteRandomVariable& condition,
+        const RandomProbabilities& probabilities);
+
     std::size_t
     size() const
     {
-      return cpt_.size();
+      return layout_ == dense_layout ? dense_.size() / row_size_ : cpt_.size();
     }
 
   protected:
@@ -176,7 +575,37 @@ namespace cpprob
   private:
 
     std::string name_;
+    /* The variable and the condition this table was created for. They
+     * provide the keys when the table is converted to the map layout. */
+    DiscreteRandomVariable var_;
+    DiscreteRandomVariable condition_;
+    Layout layout_;
     ConditionalProbabilityTable cpt_;
+    cont::vector<float> dense_;
+    std::size_t row_size_;
+    std::size_t revision_;
+
+    /**
+     * Makes sure that the dense layout contains a row for the condition
+     * value. A new row is appended with equal probabilities, like a new
+     * RandomProbabilities object in the map layout. If the condition value
+     * neither has a row nor directly follows the last row, the table is
+     * converted to the map layout.
+     *
+     * @return whether the table is still in the dense layout.
+     */
+    bool
+    dense_row_for(const DiscreteRandomVariable& condition);
+
+    void
+    use_map_layout()
+    {
+      if (layout_ == dense_layout)
+        convert_to_map_layout();
+    }
+
+    void
+    convert_to_map_layout();
 
   };
 
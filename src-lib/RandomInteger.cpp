@@ -15,8 +15,8 @@ namespace cpprob
   ostream&
   RandomInteger::put_out(ostream& os) const
   {
-    return os << characteristics_->first << ":"
-        << characteristics_->second.size_ << ":" << value_;
+    return os << characteristics_table_[characteristics_].name_ << ":"
+        << characteristics_table_[characteristics_].size_ << ":" << value_;
   }
 
 } /* namespace cpprob */
@@ -27,8 +27,9 @@ namespace cpprob
       /* This constructor allows to change the size of an existing random
        * variable type. The constructor of DiscreteRandomVariable called above
        * does not do that. So I ensure here afterwards that the size in the
-       * characteristics table meets the new size given in this constructor. */
-      characteristics_->second.size_ = size;
+       * characteristics table meets the new size given in this constructor.
+       * The size is shared by all variables of this name in all networks. */
+      characteristics_table_[characteristics_].size_ = size;
     }
 
     explicit
@@ -51,11 +52,11 @@ namespace cpprob
     RandomInteger&
     observation(std::size_t new_value)
     {
-      if (new_value < characteristics_->second.size_)
+      if (new_value < characteristics_table_[characteristics_].size_)
         value_ = new_value;
       else
         cpprob_throw_out_of_range(
-            "RandomInteger: The new value " << new_value << " is greater than or equal to the size " << characteristics_->second.size_);
+            "RandomInteger: The new value " << new_value << " is greater than or equal to the size " << characteristics_table_[characteristics_].size_);
 
       return *this;
     }
@@ -26,6 +26,27 @@ namespace cpprob
 
   extern RandomNumberEngine random_number_engine;
 
+  /**
+   * Draws a value from the distribution with the random number engine rne.
+   * The distribution gets uniformly distributed numbers in [0, 1) like from a
+   * std::variate_generator. But in contrast to a std::variate_generator, the
+   * distribution is not copied and no engine is bound to it. So a node can
+   * keep its sampling distribution as a member and still be sampled with the
+   * engine of any chain (see BayesianNetwork::sample()).
+   *
+   * @par Requires:
+   * - The input type of the distribution is a floating point type.
+   */
+  template<class Distribution>
+    typename Distribution::result_type
+    draw_from(RandomNumberEngine& rne, Distribution& distribution)
+    {
+      typedef typename Distribution::input_type InputType;
+      std::variate_generator<RandomNumberEngine&, std::uniform_real<InputType> > canonical(
+          rne, std::uniform_real<InputType>(0, 1));
+      return distribution(canonical);
+    }
+
 }
 
 #endif /* RANDOMNUMBERENGINE_HPP_ */
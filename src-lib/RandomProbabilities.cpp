@@ -8,21 +8,27 @@
 #include "RandomProbabilities.hpp"
 #include "IoUtils.hpp"
 #include <algorithm>
+#include <mutex>
 
 using namespace std;
 
 namespace cpprob
 {
 
+  namespace
+  {
+    mutex names_mutex;
+  }
+
   RandomProbabilities::Names RandomProbabilities::names_;
 
   RandomProbabilities::RandomProbabilities() :
-      name_(names_.insert("").first)
+      name_(intern_name(""))
   {
   }
 
   RandomProbabilities::RandomProbabilities(const DiscreteRandomVariable& var) :
-      name_(names_.insert("Probabilities" + var.name()).first)
+      name_(intern_name("Probabilities" + var.name()))
   {
     DiscreteRandomVariable::Range range = var.value_range();
     if (!range.empty())
@@ -37,6 +43,13 @@ namespace cpprob
   {
   }
 
+  RandomProbabilities::Names::const_iterator
+  RandomProbabilities::intern_name(const string& name)
+  {
+    lock_guard<mutex> lock(names_mutex);
+    return names_.insert(name).first;
+  }
+
   void
   RandomProbabilities::assign_random_value(RandomNumberEngine& rne)
   {
@@ -473,6 +473,17 @@ namespace cpprob
       return pt_.size();
     }
 
+    /**
+     * Exchanges the name and the probabilities with the other table in
+     * constant time.
+     */
+    void
+    swap(RandomProbabilities& other)
+    {
+      std::swap(name_, other.name_);
+      pt_.swap(other.pt_);
+    }
+
   protected:
 
     // Documented in the base class.
@@ -487,8 +498,22 @@ namespace cpprob
     Names::const_iterator name_;
     ProbabilityTable pt_;
 
+    /**
+     * Inserts the name into #names_. Tables may be created on several
+     * threads at the same time, so the insertion is locked. The iterators
+     * into the set stay valid, so reading a name needs no lock.
+     */
+    static Names::const_iterator
+    intern_name(const std::string& name);
+
   };
 
+  inline void
+  swap(RandomProbabilities& x, RandomProbabilities& y)
+  {
+    x.swap(y);
+  }
+
 }
 
 #endif /* RANDOMPROBABILITIES_HPP_ */
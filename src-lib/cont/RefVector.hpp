@@ -226,6 +226,12 @@ namespace cpprob
           return pointers_.erase(position.base());
         }
 
+        iterator
+        erase(iterator first, iterator last)
+        {
+          return pointers_.erase(first.base(), last.base());
+        }
+
         void
         pop_back()
         {
@@ -6,6 +6,7 @@
  */
 
 #include "../src-lib/BayesianNetwork.hpp"
+#include "../src-lib/CompiledNetwork.hpp"
 #include "../src-lib/DiscreteJointRandomVariable.hpp"
 #include "../src-lib/RandomBoolean.hpp"
 #include <boost/program_options.hpp>
@@ -146,6 +147,51 @@ BOOST_AUTO_TEST_CASE( alarm_test )
 
   float enumeration_false_probability = burglary_distribution.begin()->second;
 
+  t.restart();
+  CategoricalDistribution elimination_distribution = bn.eliminate(
+      burglary_node);
+  duration = t.elapsed();
+  if (!options_map["test-mode"].as<bool>())
+  {
+    cout << "Eliminate\n";
+    cout << "Duration: " << duration << "\n";
+    cout << "Burglary distribution with variable elimination:\n";
+    cout << elimination_distribution << endl;
+  }
+  BOOST_CHECK_SMALL(
+      elimination_distribution.begin()->second - enumeration_false_probability,
+      1e-5f);
+  elimination_distribution = bn.eliminate(burglary_node,
+      BayesianNetwork::min_degree_ordering);
+  BOOST_CHECK_SMALL(
+      elimination_distribution.begin()->second - enumeration_false_probability,
+      1e-5f);
+
+  CompiledNetwork compiled_bn(bn);
+  CategoricalDistribution compiled_distribution = compiled_bn.marginal(
+      burglary_node);
+  BOOST_CHECK_SMALL(
+      compiled_distribution.begin()->second - enumeration_false_probability,
+      1e-5f);
+
+  // Change the evidence of one node and recalibrate only its part of the tree.
+  ConditionalCategoricalNode& john_calls_node = bn.at<
+      ConditionalCategoricalNode>("JohnCalls");
+  DiscreteRandomVariable john_calls_evidence = john_calls_node.value();
+  john_calls_node.value() = john_calls_evidence.value_range().begin();
+  compiled_bn.update(john_calls_node);
+  compiled_distribution = compiled_bn.marginal(burglary_node);
+  burglary_distribution = bn.enumerate(burglary_node);
+  BOOST_CHECK_SMALL(
+      compiled_distribution.begin()->second
+          - burglary_distribution.begin()->second, 1e-5f);
+  john_calls_node.value() = john_calls_evidence;
+  compiled_bn.update(john_calls_node);
+  compiled_distribution = compiled_bn.marginal(burglary_node);
+  BOOST_CHECK_SMALL(
+      compiled_distribution.begin()->second - enumeration_false_probability,
+      1e-5f);
+
   unsigned int burn_in_iterations = options_map["burn-in-iterations"].as<
       unsigned int>();
   unsigned int collect_iterations = options_map["collect-iterations"].as<
@@ -166,6 +212,44 @@ BOOST_AUTO_TEST_CASE( alarm_test )
   BOOST_CHECK_SMALL(sampling_false_probability - enumeration_false_probability,
       0.01f);
 
+  // Several chains in parallel must give the same result for any number of
+  // threads.
+  random_number_engine.seed();
+  CategoricalDistribution chains_distribution = bn.sample(burglary_node,
+      burn_in_iterations, collect_iterations / 4, 4, 2);
+  BOOST_CHECK_SMALL(
+      chains_distribution.begin()->second - enumeration_false_probability,
+      0.01f);
+  random_number_engine.seed();
+  CategoricalDistribution threads_distribution = bn.sample(burglary_node,
+      burn_in_iterations, collect_iterations / 4, 4, 4);
+  BOOST_CHECK_EQUAL(chains_distribution.begin()->second,
+      threads_distribution.begin()->second);
+
+  // The dense layout of the probability tables must not change the samples.
+  const char* conditional_nodes[] =
+  { "Alarm", "JohnCalls", "MaryCalls" };
+  for (int i = 0; i != 3; ++i)
+    bn.at<ConditionalCategoricalNode>(conditional_nodes[i]).probabilities().layout(
+        RandomConditionalProbabilities::dense_layout);
+  random_number_engine.seed();
+  CategoricalDistribution dense_distribution = bn.sample(burglary_node,
+      burn_in_iterations, collect_iterations / 4, 4, 2);
+  BOOST_CHECK_EQUAL(chains_distribution.begin()->second,
+      dense_distribution.begin()->second);
+  for (int i = 0; i != 3; ++i)
+    BOOST_CHECK(
+        bn.at<ConditionalCategoricalNode>(conditional_nodes[i]).probabilities().layout() == RandomConditionalProbabilities::dense_layout);
+  // A constant table reads its rows without a conversion to the map layout.
+  const RandomConditionalProbabilities& alarm_probabilities = bn.at<
+      ConditionalCategoricalNode>("Alarm").probabilities();
+  for (auto row = alarm_probabilities.begin();
+      row != alarm_probabilities.end(); ++row)
+    for (auto p = row->second.begin(); p != row->second.end(); ++p)
+      BOOST_CHECK_EQUAL(p->second, alarm_probabilities.at(p->first, row->first));
+  BOOST_CHECK(
+      alarm_probabilities.layout() == RandomConditionalProbabilities::dense_layout);
+
   random_number_engine.seed(); // Reset in a well-defined state.
   float max_error = 0.02f;
   unsigned int iterations = 0;
@@ -0,0 +1,633 @@
+/*
+ * BayesianNetworkTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/BayesianNetwork.hpp"
+#include "../src-lib/DiscreteJointRandomVariable.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include <algorithm>
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(BayesianNetworkTest)
+
+BOOST_AUTO_TEST_CASE(ParallelLearn)
+{
+  /* Enough rows for several shards per node. The prior of 0.1 is not exact
+   * in floating point, so the order of the additions would matter. */
+  RandomInteger a("LearnA", 3, 0);
+  RandomInteger b("LearnB", 4, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 0.1f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(b, a), 0.1f);
+  for (int r = 0; r != 20000; ++r)
+  {
+    CategoricalNode& a_node = bn.add_categorical(a.observation(r % 3),
+        a_params);
+    a_node.is_evidence(r % 5 != 0);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn.add_conditional_categorical(b.observation((r * r + r / 3) % 4), parents,
+        b_params).is_evidence(r % 7 != 0);
+  }
+
+  BayesianNetwork bn_parallel(bn);
+  bn.learn();
+  bn_parallel.learn(4);
+  BOOST_CHECK(
+      bn_parallel.at<DirichletNode>(a_params.value().name()).value() == a_params.value());
+  BOOST_CHECK(
+      bn_parallel.at<ConditionalDirichletNode>(b_params.value().name()).value() == b_params.value());
+
+  bn_parallel.learn(0);
+  BOOST_CHECK(
+      bn_parallel.at<ConditionalDirichletNode>(b_params.value().name()).value() == b_params.value());
+}
+
+BOOST_AUTO_TEST_CASE(DenseLearn)
+{
+  /* learn() writes the rows of a dense table without converting it, and
+   * the constant table hands out its rows in the dense layout. */
+  RandomInteger a("DenseLearnA", 3, 0);
+  RandomInteger b("DenseLearnB", 2, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(b, a), 1.0f);
+  for (int r = 0; r != 30; ++r)
+  {
+    CategoricalNode& a_node = bn.add_categorical(a.observation(r % 3),
+        a_params);
+    a_node.is_evidence(true);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn.add_conditional_categorical(b.observation(r % 5 == 0), parents,
+        b_params).is_evidence(true);
+  }
+
+  BayesianNetwork bn_dense(bn);
+  RandomConditionalProbabilities& dense_value = bn_dense.at<
+      ConditionalDirichletNode>(b_params.value().name()).value();
+  dense_value.layout(RandomConditionalProbabilities::dense_layout);
+  bn.learn();
+  bn_dense.learn();
+  BOOST_CHECK(
+      dense_value.layout() == RandomConditionalProbabilities::dense_layout);
+  BOOST_CHECK(dense_value == b_params.value());
+
+  const RandomConditionalProbabilities& const_value = dense_value;
+  BOOST_CHECK_EQUAL(const_value.at(a.observation(1)).size(), 2);
+  BOOST_CHECK_EQUAL(const_value.at(a.observation(1)).at(b.observation(0)),
+      b_params.value().at(b.observation(0), a.observation(1)));
+  size_t rows = 0;
+  for (auto row = const_value.begin(); row != const_value.end(); ++row, ++rows)
+  {
+    for (auto p = row->second.begin(); p != row->second.end(); ++p)
+      BOOST_CHECK_EQUAL(p->second, b_params.value().at(p->first, row->first));
+  }
+  BOOST_CHECK_EQUAL(rows, 3);
+  BOOST_CHECK(const_value.find(a.observation(2)) != const_value.end());
+  BOOST_CHECK(
+      dense_value.layout() == RandomConditionalProbabilities::dense_layout);
+}
+
+BOOST_AUTO_TEST_CASE(EnumerateManyChildren)
+{
+  /* 200 children with a probability of 0.1 or 0.9 each. The joint
+   * probability is about 1e-105 and underflows even in double without the
+   * log domain. Both values of X explain the children equally well; so the
+   * posterior is the prior. */
+  RandomInteger x("EnumerateX", 2, 0);
+  RandomInteger y("EnumerateY", 2, 0);
+  RandomProbabilities x_probabilities(x);
+  x_probabilities[x.observation(0)] = 0.3f;
+  x_probabilities[x.observation(1)] = 0.7f;
+  RandomConditionalProbabilities y_probabilities(y, x);
+  y_probabilities[x.observation(0)][y.observation(0)] = 0.1f;
+  y_probabilities[x.observation(0)][y.observation(1)] = 0.9f;
+  y_probabilities[x.observation(1)][y.observation(0)] = 0.9f;
+  y_probabilities[x.observation(1)][y.observation(1)] = 0.1f;
+
+  BayesianNetwork bn;
+  CategoricalNode& x_node = bn.add_categorical(x,
+      bn.add_constant(x_probabilities));
+  ConstantRandomConditionalProbabilitiesNode& y_params = bn.add_constant(
+      y_probabilities);
+  cont::RefVector<DiscreteNode> parents(1, x_node);
+  for (int c = 0; c != 200; ++c)
+    bn.add_conditional_categorical(y.observation(c % 2), parents, y_params).is_evidence(
+        true);
+
+  CategoricalDistribution distribution = bn.enumerate(x_node);
+  BOOST_CHECK_CLOSE(distribution[x.observation(0)], 0.3f, 0.01f);
+  BOOST_CHECK_CLOSE(distribution[x.observation(1)], 0.7f, 0.01f);
+}
+
+/* Fills the table with uneven probabilities; the seed varies them. */
+void
+fill_conditional_probabilities(RandomConditionalProbabilities& table,
+    const DiscreteRandomVariable& var, const DiscreteRandomVariable& condition,
+    unsigned int seed)
+{
+  for (auto c = condition.value_range().begin();
+      c != condition.value_range().end(); ++c)
+  {
+    for (auto v = var.value_range().begin(); v != var.value_range().end();
+        ++v)
+    {
+      seed = (seed * 7 + 3) % 11;
+      table.set(v, c, (1.0f + seed) / 11.0f);
+    }
+  }
+  table.normalize();
+}
+
+/* Compares eliminate() with both orderings to enumerate(). */
+template<class N>
+  void
+  check_elimination(BayesianNetwork& bn, N& node)
+  {
+    const CategoricalDistribution expected = bn.enumerate(node);
+    const BayesianNetwork::EliminationOrdering orderings[] =
+    { BayesianNetwork::min_degree_ordering, BayesianNetwork::min_fill_ordering };
+    for (size_t o = 0; o != 2; ++o)
+    {
+      CategoricalDistribution actual = bn.eliminate(node, orderings[o]);
+      BOOST_CHECK_EQUAL(actual.size(), expected.size());
+      for (auto p = expected.begin(); p != expected.end(); ++p)
+        BOOST_CHECK_CLOSE(actual[p->first], p->second, 0.01f);
+    }
+  }
+
+BOOST_AUTO_TEST_CASE(EliminateOrderings)
+{
+  /* The loop A - B - D - C - A needs a fill-in edge, and E hangs off D. So
+   * the heuristics choose different orders. */
+  RandomInteger a("EliminateA", 3, 0);
+  RandomInteger b("EliminateB", 2, 0);
+  RandomInteger c("EliminateC", 2, 0);
+  RandomInteger d("EliminateD", 3, 0);
+  RandomInteger e("EliminateE", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.2f;
+  a_probabilities[a.observation(1)] = 0.5f;
+  a_probabilities[a.observation(2)] = 0.3f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  fill_conditional_probabilities(b_probabilities, b, a, 1);
+  RandomConditionalProbabilities c_probabilities(c, a);
+  fill_conditional_probabilities(c_probabilities, c, a, 2);
+  const DiscreteJointRandomVariable bc(b, c);
+  RandomConditionalProbabilities d_probabilities(d, bc);
+  fill_conditional_probabilities(d_probabilities, d, bc, 3);
+  RandomConditionalProbabilities e_probabilities(e, d);
+  fill_conditional_probabilities(e_probabilities, e, d, 4);
+
+  BayesianNetwork bn;
+  CategoricalNode& a_node = bn.add_categorical(a,
+      bn.add_constant(a_probabilities));
+  cont::RefVector<DiscreteNode> parents(1, a_node);
+  ConditionalCategoricalNode& b_node = bn.add_conditional_categorical(b,
+      parents, bn.add_constant(b_probabilities));
+  ConditionalCategoricalNode& c_node = bn.add_conditional_categorical(c,
+      parents, bn.add_constant(c_probabilities));
+  parents.clear();
+  parents.push_back(b_node);
+  parents.push_back(c_node);
+  ConditionalCategoricalNode& d_node = bn.add_conditional_categorical(d,
+      parents, bn.add_constant(d_probabilities));
+  parents.clear();
+  parents.push_back(d_node);
+  ConditionalCategoricalNode& e_node = bn.add_conditional_categorical(e,
+      parents, bn.add_constant(e_probabilities));
+
+  check_elimination(bn, a_node);
+  check_elimination(bn, b_node);
+  check_elimination(bn, c_node);
+  check_elimination(bn, d_node);
+  check_elimination(bn, e_node);
+
+  e_node.value() = e.observation(1);
+  e_node.is_evidence(true);
+  c_node.value() = c.observation(0);
+  c_node.is_evidence(true);
+  check_elimination(bn, a_node);
+  check_elimination(bn, b_node);
+  check_elimination(bn, d_node);
+}
+
+BOOST_AUTO_TEST_CASE(LearnEm)
+{
+  /* Rows (A = 0, B = 0), (A = 1, B = 1) and (A = ?, B = 0). With the
+   * initial parameters, A = 0 has the posterior 0.5 * 0.8 / (0.5 * 0.8 +
+   * 0.5 * 0.2) = 0.8 in the last row. So with a prior of 1, the first
+   * M-step gives P(A = 0) = (1 + 1.8) / 5 and
+   * P(B = 0 | A = 0) = (1 + 1.8) / 3.8. */
+  RandomInteger a("EmA", 2, 0);
+  RandomInteger b("EmB", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.5f;
+  a_probabilities[a.observation(1)] = 0.5f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  b_probabilities[a.observation(0)][b.observation(0)] = 0.8f;
+  b_probabilities[a.observation(0)][b.observation(1)] = 0.2f;
+  b_probabilities[a.observation(1)][b.observation(0)] = 0.2f;
+  b_probabilities[a.observation(1)][b.observation(1)] = 0.8f;
+
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(a_probabilities, 1.0f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      b_probabilities, 1.0f);
+  const int rows[][2] =
+  {
+  { 0, 0 },
+  { 1, 1 },
+  { 1, 0 } };
+  cont::vector<CategoricalNode*> a_nodes;
+  for (int r = 0; r != 3; ++r)
+  {
+    CategoricalNode& a_node = bn.add_categorical(a.observation(rows[r][0]),
+        a_params);
+    a_node.is_evidence(r != 2);
+    a_nodes.push_back(&a_node);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn.add_conditional_categorical(b.observation(rows[r][1]), parents,
+        b_params).is_evidence(true);
+  }
+  BayesianNetwork bn_parallel(bn);
+
+  unsigned int iterations = 0;
+  const double log_likelihood = bn.learn_em(1, 0.0f, &iterations);
+  BOOST_CHECK_EQUAL(iterations, 1);
+  BOOST_CHECK_CLOSE(log_likelihood, 2.0 * log(0.4) + log(0.5), 0.001);
+  BOOST_CHECK_CLOSE(a_params.value().at(a.observation(0)), 2.8f / 5.0f,
+      0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(0), a.observation(0)),
+      2.8f / 3.8f, 0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(0), a.observation(1)),
+      1.2f / 3.2f, 0.001f);
+  BOOST_CHECK_EQUAL(a_nodes[2]->value(), a.observation(1));
+
+  /* EM converges, and the threads do not change the result. */
+  bn.learn_em(100, 1e-6f, &iterations);
+  BOOST_CHECK_LT(iterations, 100);
+  bn_parallel.learn_em(iterations + 1, 1e-6f, 0, 4);
+  BOOST_CHECK(
+      bn_parallel.at<DirichletNode>(a_params.value().name()).value() == a_params.value());
+}
+
+BOOST_AUTO_TEST_CASE(LearnEmZeroEvidence)
+{
+  /* The observed row A = 1 has the probability 0 under the initial
+   * parameters. The first M-step gives P(A = 1) = (1 + 1) / 3, and the
+   * log-likelihood follows the learned parameters until it stays. */
+  RandomInteger a("EmZeroA", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 1.0f;
+  a_probabilities[a.observation(1)] = 0.0f;
+
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(a_probabilities, 1.0f);
+  bn.add_categorical(a.observation(1), a_params).is_evidence(true);
+
+  unsigned int iterations = 0;
+  const double log_likelihood = bn.learn_em(100, 1e-6f, &iterations);
+  BOOST_CHECK_EQUAL(iterations, 3);
+  BOOST_CHECK_CLOSE(log_likelihood, log(2.0 / 3.0), 0.001);
+  BOOST_CHECK_CLOSE(a_params.value().at(a.observation(1)), 2.0f / 3.0f,
+      0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(SampleChains)
+{
+  RandomInteger a("ChainA", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.25f;
+  a_probabilities[a.observation(1)] = 0.75f;
+  BayesianNetwork bn;
+  CategoricalNode& a_node = bn.add_categorical(a,
+      bn.add_constant(a_probabilities));
+
+  /* A chain draws from the given engine: once to initialize the node and
+   * once per sweep. */
+  RandomNumberEngine rne;
+  rne.seed_from_canonical(
+  { 0.1f, 0.9f, 0.2f, 0.3f, 0.8f });
+  random_number_engine.seed();
+  CategoricalDistribution distribution = bn.sample(a_node, 1, 3, rne);
+  BOOST_CHECK_EQUAL(rne.size(), 0);
+  BOOST_CHECK_CLOSE(distribution[a.observation(0)], 1.0f / 3.0f, 0.001f);
+
+  /* Every chain is seeded with one number of the global engine and then
+   * draws from its own engine only. One number initializes a chain, so the
+   * first sweep fails, and the error is rethrown in the calling thread. */
+  random_number_engine.seed_from_canonical(
+  { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f });
+  BOOST_CHECK_THROW(bn.sample(a_node, 0, 1, 3, 2), runtime_error);
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 4);
+
+  /* Without latent nodes, the chains draw nothing. The result does not
+   * depend on the number of threads, and the network keeps its values. */
+  a_node.value() = a.observation(1);
+  a_node.is_evidence(true);
+  for (unsigned int threads = 0; threads != 5; ++threads)
+  {
+    random_number_engine.seed(
+    { 1u, 2u, 3u, 4u });
+    distribution = bn.sample(a_node, 2, 3, 4, threads);
+    BOOST_CHECK_EQUAL(random_number_engine.size(), 0);
+    BOOST_CHECK_EQUAL(distribution[a.observation(1)], 1.0f);
+    BOOST_CHECK(a_node.value() == a.observation(1));
+  }
+
+  BOOST_CHECK_THROW(bn.sample(a_node, 1, 1, 0, 1), invalid_argument);
+  BayesianNetwork other_bn;
+  CategoricalNode& other_node = other_bn.add_categorical(a,
+      other_bn.add_constant(a_probabilities));
+  BOOST_CHECK_THROW(bn.sample(other_node, 1, 1, 2, 1), invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(SweepPlanOrder)
+{
+  /* Two runs of categorical nodes around a run of conditional ones, with an
+   * evidence node in between. sample() sweeps with its plan; the copy is
+   * swept node by node with the visitors. From the same random numbers, both
+   * must draw the same values. */
+  RandomInteger a("SweepA", 2, 0);
+  RandomInteger b("SweepB", 3, 0);
+  RandomInteger c("SweepC", 2, 0);
+  RandomInteger d("SweepD", 2, 0);
+  RandomInteger e("SweepE", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.35f;
+  a_probabilities[a.observation(1)] = 0.65f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  fill_conditional_probabilities(b_probabilities, b, a, 1);
+  RandomConditionalProbabilities c_probabilities(c, b);
+  fill_conditional_probabilities(c_probabilities, c, b, 2);
+  RandomConditionalProbabilities d_probabilities(d, c);
+  fill_conditional_probabilities(d_probabilities, d, c, 3);
+  RandomProbabilities e_probabilities(e);
+  e_probabilities[e.observation(0)] = 0.55f;
+  e_probabilities[e.observation(1)] = 0.45f;
+
+  BayesianNetwork bn;
+  CategoricalNode& a_node = bn.add_categorical(a,
+      bn.add_constant(a_probabilities));
+  cont::RefVector<DiscreteNode> parents(1, a_node);
+  ConditionalCategoricalNode& b_node = bn.add_conditional_categorical(b,
+      parents, bn.add_constant(b_probabilities));
+  parents.clear();
+  parents.push_back(b_node);
+  bn.add_conditional_categorical(c.observation(1), parents,
+      bn.add_constant(c_probabilities)).is_evidence(true);
+  parents.clear();
+  parents.push_back(bn.at<ConditionalCategoricalNode>(c.name()));
+  bn.add_conditional_categorical(d, parents, bn.add_constant(d_probabilities));
+  bn.add_categorical(e, bn.add_constant(e_probabilities));
+  BayesianNetwork bn_visitor(bn);
+
+  /* One number to initialize and one per sweep for each of the four latent
+   * nodes: 1 + 3 sweeps */
+  RandomNumberEngine plan_rne;
+  plan_rne.seed_from_canonical(
+  { 0.1f, 0.5f, 0.9f, 0.3f, 0.7f, 0.2f, 0.6f, 0.4f, 0.8f, 0.05f, 0.95f,
+      0.45f, 0.25f, 0.75f, 0.15f, 0.65f });
+  RandomNumberEngine visitor_rne(plan_rne);
+  CategoricalDistribution plan_distribution = bn.sample(a_node, 1, 2,
+      plan_rne);
+  BOOST_CHECK_EQUAL(plan_rne.size(), 0);
+
+  CategoricalDistribution visitor_distribution;
+  visitor_distribution[a.observation(0)] = 0.0f;
+  visitor_distribution[a.observation(1)] = 0.0f;
+  for_each(bn_visitor.begin(), bn_visitor.end(),
+      make_apply_visitor_delayed(InitSamplingOfNode(visitor_rne)));
+  for (unsigned int sweep = 0; sweep != 3; ++sweep)
+  {
+    for_each(bn_visitor.begin(), bn_visitor.end(),
+        make_apply_visitor_delayed(SampleNode(visitor_rne)));
+    if (sweep != 0)
+      visitor_distribution[bn_visitor.at<CategoricalNode>(a.name()).value()] +=
+          1.0f;
+  }
+  visitor_distribution.normalize();
+  BOOST_CHECK_EQUAL(visitor_rne.size(), 0);
+
+  BOOST_CHECK_EQUAL(plan_distribution[a.observation(0)],
+      visitor_distribution[a.observation(0)]);
+  BOOST_CHECK_EQUAL(plan_distribution[a.observation(1)],
+      visitor_distribution[a.observation(1)]);
+  BOOST_CHECK(
+      a_node.value() == bn_visitor.at<CategoricalNode>(a.name()).value());
+  BOOST_CHECK(
+      b_node.value() == bn_visitor.at<ConditionalCategoricalNode>(b.name()).value());
+  BOOST_CHECK(
+      bn.at<ConditionalCategoricalNode>(d.name()).value() == bn_visitor.at<ConditionalCategoricalNode>(d.name()).value());
+  BOOST_CHECK(
+      bn.at<CategoricalNode>(e.name()).value() == bn_visitor.at<CategoricalNode>(e.name()).value());
+}
+
+BOOST_AUTO_TEST_CASE(FindByName)
+{
+  RandomInteger a("FindA", 2, 0);
+  RandomInteger b("FindB", 2, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 1.0f);
+  CategoricalNode& a1 = bn.add_categorical(a.observation(0), a_params);
+  CategoricalNode& a2 = bn.add_categorical(a.observation(1), a_params);
+
+  BOOST_CHECK_EQUAL(&bn.at<DirichletNode>(a_params.value().name()), &a_params);
+  BOOST_CHECK_EQUAL(bn.find<CategoricalNode>("FindA"), &a1);
+  BOOST_CHECK(bn.find<CategoricalNode>("FindB") == 0);
+  BOOST_CHECK(bn.find<DirichletNode>("FindA") == 0);
+  BOOST_CHECK_THROW(bn.at<CategoricalNode>("FindB"), out_of_range);
+
+  /* The next node of the same name takes the place of an erased one. */
+  BOOST_CHECK_EQUAL(bn.erase(a1), 1);
+  BOOST_CHECK_EQUAL(bn.find<CategoricalNode>("FindA"), &a2);
+  const BayesianNetwork& const_bn = bn;
+  BOOST_CHECK_EQUAL(&const_bn.at<CategoricalNode>("FindA"), &a2);
+
+  /* A node is renamed by erasing it and adding it again. */
+  BOOST_CHECK_EQUAL(bn.erase(a2), 1);
+  CategoricalNode& b1 = bn.add_categorical(b.observation(0),
+      bn.add_dirichlet(RandomProbabilities(b), 1.0f));
+  BOOST_CHECK(bn.find<CategoricalNode>("FindA") == 0);
+  BOOST_CHECK_EQUAL(bn.find<CategoricalNode>("FindB"), &b1);
+  BOOST_CHECK_EQUAL(&const_bn.at<CategoricalNode>("FindB"), &b1);
+
+  BayesianNetwork bn_copy(bn);
+  BOOST_CHECK(bn_copy.find<DirichletNode>(a_params.value().name()) != 0);
+  BOOST_CHECK(
+      bn_copy.find<DirichletNode>(a_params.value().name()) != &a_params);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaStorage)
+{
+  /* The reserved nodes lie one after the other in memory, and an erased
+   * node makes room for the next one. */
+  RandomInteger a("ArenaA", 2, 0);
+  BayesianNetwork bn;
+  bn.reserve(100);
+  ConstantRandomProbabilitiesNode& a_params = bn.add_constant(
+      RandomProbabilities(a));
+  cont::vector<CategoricalNode*> nodes;
+  for (int n = 0; n != 99; ++n)
+    nodes.push_back(&bn.add_categorical(a.observation(n % 2), a_params));
+  const char* first = reinterpret_cast<const char*>(nodes[0]);
+  const ptrdiff_t stride = reinterpret_cast<const char*>(nodes[1]) - first;
+  BOOST_CHECK_GT(stride, 0);
+  BOOST_CHECK_EQUAL(reinterpret_cast<const char*>(nodes[98]) - first,
+      98 * stride);
+
+  BOOST_CHECK_EQUAL(bn.erase(*nodes[50]), 1);
+  BOOST_CHECK_EQUAL(&bn.add_categorical(a.observation(0), a_params),
+      nodes[50]);
+  BOOST_CHECK_EQUAL(bn.size(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(EraseRows)
+{
+  /* A sliding window of rows A -> B. Erasing the oldest rows removes them
+   * from the children of their parents, and the rows in between stay. */
+  RandomInteger a("EraseA", 2, 0);
+  RandomInteger b("EraseB", 2, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(b, a), 1.0f);
+  cont::vector<CategoricalNode*> a_nodes;
+  cont::vector<ConditionalCategoricalNode*> b_nodes;
+  for (int r = 0; r != 10; ++r)
+  {
+    CategoricalNode& a_node = bn.add_categorical(a.observation(r % 2),
+        a_params);
+    a_node.is_evidence(true);
+    a_nodes.push_back(&a_node);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    b_nodes.push_back(
+        &bn.add_conditional_categorical(b.observation(0), parents, b_params));
+  }
+  BOOST_CHECK_EQUAL(bn.size(), 22);
+
+  /* A parent with a child must stay, alone and in a range. */
+  BOOST_CHECK_THROW(bn.erase(*a_nodes[0]), invalid_argument);
+  auto first_row = std::next(bn.begin(), 2);
+  BOOST_CHECK_THROW(bn.erase(first_row, std::next(first_row)),
+      invalid_argument);
+  BOOST_CHECK_EQUAL(bn.size(), 22);
+
+  BOOST_CHECK_EQUAL(bn.erase(*b_nodes[0]), 1);
+  BOOST_CHECK_EQUAL(bn.erase(*b_nodes[0]), 0);
+  BOOST_CHECK_EQUAL(bn.erase(*a_nodes[0]), 1);
+  BOOST_CHECK_EQUAL(a_params.children().size(), 9);
+  BOOST_CHECK_EQUAL(&a_params.children().front(), a_nodes[1]);
+  BOOST_CHECK_EQUAL(b_params.children().size(), 9);
+
+  /* The next three rows in one range */
+  first_row = std::next(bn.begin(), 2);
+  BOOST_CHECK_EQUAL(bn.erase(first_row, std::next(first_row, 6)), 6);
+  BOOST_CHECK_EQUAL(&a_params.children().front(), a_nodes[4]);
+  BOOST_CHECK_EQUAL(&b_params.children().front(), b_nodes[4]);
+
+  /* All rows with A = 1 */
+  struct IsOddRow
+  {
+    const cont::vector<CategoricalNode*>& a_nodes_;
+    const cont::vector<ConditionalCategoricalNode*>& b_nodes_;
+
+    bool
+    operator()(const BayesianNetwork::iterator::value_type& node) const
+    {
+      for (std::size_t r = 1; r < a_nodes_.size(); r += 2)
+      {
+        if (boost::get<CategoricalNode>(&node) == a_nodes_[r]
+            || boost::get<ConditionalCategoricalNode>(&node) == b_nodes_[r])
+          return true;
+      }
+      return false;
+    }
+  } is_odd_row =
+  { a_nodes, b_nodes };
+  BOOST_CHECK_EQUAL(bn.erase_if(is_odd_row), 6);
+  BOOST_CHECK_EQUAL(bn.size(), 8);
+  BOOST_CHECK_EQUAL(a_params.children().size(), 3);
+  BOOST_CHECK_EQUAL(&a_params.children()[1], a_nodes[6]);
+  BOOST_CHECK_EQUAL(a_nodes[8]->children().size(), 1);
+  BOOST_CHECK_EQUAL(bn.find<CategoricalNode>("EraseA"), a_nodes[4]);
+  BOOST_CHECK_EQUAL(bn.erase(bn.begin(), bn.begin()), 0);
+
+  bn.learn();
+  BOOST_CHECK_CLOSE(a_params.value().at(a.observation(0)), 4.0f / 5.0f,
+      0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(Overlay)
+{
+  /* A -> B with fixed probabilities. The overlay observes B = 0 and leaves
+   * the network as it is. */
+  RandomInteger a("OverlayA", 2, 0);
+  RandomInteger b("OverlayB", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.4f;
+  a_probabilities[a.observation(1)] = 0.6f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  b_probabilities[a.observation(0)][b.observation(0)] = 0.9f;
+  b_probabilities[a.observation(0)][b.observation(1)] = 0.1f;
+  b_probabilities[a.observation(1)][b.observation(0)] = 0.2f;
+  b_probabilities[a.observation(1)][b.observation(1)] = 0.8f;
+
+  BayesianNetwork bn;
+  ConstantRandomProbabilitiesNode& a_params = bn.add_constant(a_probabilities);
+  ConstantRandomConditionalProbabilitiesNode& b_params = bn.add_constant(
+      b_probabilities);
+  CategoricalNode& a_node = bn.add_categorical(a, a_params);
+  cont::RefVector<DiscreteNode> parents(1, a_node);
+  ConditionalCategoricalNode& b_node = bn.add_conditional_categorical(b,
+      parents, b_params);
+
+  BayesianNetwork overlay = bn.overlay();
+  BOOST_CHECK_EQUAL(overlay.size(), 2);
+  BOOST_CHECK(overlay.find<ConstantRandomProbabilitiesNode>("OverlayA") == 0);
+  CategoricalNode& a_overlay = overlay.at<CategoricalNode>("OverlayA");
+  ConditionalCategoricalNode& b_overlay = overlay.at<
+      ConditionalCategoricalNode>("OverlayB");
+  BOOST_CHECK_EQUAL(&a_overlay.probabilities(), &a_params.value());
+  BOOST_CHECK_EQUAL(&b_overlay.probabilities(), &b_params.value());
+  BOOST_REQUIRE_EQUAL(a_overlay.children().size(), 1);
+  BOOST_CHECK_EQUAL(&a_overlay.children().front(), &b_overlay);
+  BOOST_CHECK_EQUAL(a_params.children().size(), 1);
+  BOOST_CHECK_EQUAL(b_params.children().size(), 1);
+
+  /* P(A = 0 | B = 0) = 0.4 * 0.9 / (0.4 * 0.9 + 0.6 * 0.2) = 0.75 */
+  b_overlay.value() = b.observation(0);
+  b_overlay.is_evidence(true);
+  CategoricalDistribution distribution = overlay.enumerate(a_overlay);
+  BOOST_CHECK_CLOSE(distribution[a.observation(0)], 0.75f, 0.01f);
+  BOOST_CHECK(!b_node.is_evidence());
+  distribution = bn.enumerate(a_node);
+  BOOST_CHECK_CLOSE(distribution[a.observation(0)], 0.4f, 0.01f);
+
+  /* A copy of the overlay shares the parameters, too. */
+  BayesianNetwork overlay_copy(overlay);
+  BOOST_CHECK_EQUAL(overlay_copy.size(), 2);
+  BOOST_CHECK_EQUAL(
+      &overlay_copy.at<CategoricalNode>("OverlayA").probabilities(),
+      &a_params.value());
+  BOOST_CHECK(overlay_copy.at<ConditionalCategoricalNode>("OverlayB").is_evidence());
+
+  /* An ordinary copy does not share parameters outside the network. */
+  BayesianNetwork outside;
+  outside.add_categorical(a, a_params);
+  BOOST_CHECK_THROW(BayesianNetwork outside_copy(outside), logic_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
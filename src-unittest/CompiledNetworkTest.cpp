@@ -0,0 +1,223 @@
+/*
+ * CompiledNetworkTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/CompiledNetwork.hpp"
+#include "../src-lib/DiscreteJointRandomVariable.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(CompiledNetworkTest)
+
+/* Fills the table with uneven probabilities; the seed varies them. */
+void
+fill_conditional_probabilities(RandomConditionalProbabilities& table,
+    const DiscreteRandomVariable& var, const DiscreteRandomVariable& condition,
+    unsigned int seed)
+{
+  for (auto c = condition.value_range().begin();
+      c != condition.value_range().end(); ++c)
+  {
+    for (auto v = var.value_range().begin(); v != var.value_range().end();
+        ++v)
+    {
+      seed = (seed * 7 + 3) % 11;
+      table.set(v, c, (1.0f + seed) / 11.0f);
+    }
+  }
+  table.normalize();
+}
+
+template<class N>
+  void
+  check_marginal(CompiledNetwork& compiled_bn, BayesianNetwork& bn, N& node)
+  {
+    const CategoricalDistribution expected = bn.enumerate(node);
+    CategoricalDistribution actual = compiled_bn.marginal(node);
+    BOOST_CHECK_EQUAL(actual.size(), expected.size());
+    for (auto p = expected.begin(); p != expected.end(); ++p)
+      BOOST_CHECK_CLOSE(actual[p->first], p->second, 0.01f);
+  }
+
+/* The loop A - B - D - C - A and the leaf E below D */
+struct LoopFixture
+{
+  LoopFixture()
+      : a("CompiledA", 3, 0), b("CompiledB", 2, 0), c("CompiledC", 2, 0), d(
+          "CompiledD", 3, 0), e("CompiledE", 2, 0), bn()
+  {
+    RandomProbabilities a_probabilities(a);
+    a_probabilities[a.observation(0)] = 0.2f;
+    a_probabilities[a.observation(1)] = 0.5f;
+    a_probabilities[a.observation(2)] = 0.3f;
+    RandomConditionalProbabilities b_probabilities(b, a);
+    fill_conditional_probabilities(b_probabilities, b, a, 1);
+    RandomConditionalProbabilities c_probabilities(c, a);
+    fill_conditional_probabilities(c_probabilities, c, a, 2);
+    const DiscreteJointRandomVariable bc(b, c);
+    RandomConditionalProbabilities d_probabilities(d, bc);
+    fill_conditional_probabilities(d_probabilities, d, bc, 3);
+    RandomConditionalProbabilities e_probabilities(e, d);
+    fill_conditional_probabilities(e_probabilities, e, d, 4);
+
+    a_node = &bn.add_categorical(a, bn.add_constant(a_probabilities));
+    cont::RefVector<DiscreteNode> parents(1, *a_node);
+    b_node = &bn.add_conditional_categorical(b, parents,
+        bn.add_constant(b_probabilities));
+    c_node = &bn.add_conditional_categorical(c, parents,
+        bn.add_constant(c_probabilities));
+    parents.clear();
+    parents.push_back(*b_node);
+    parents.push_back(*c_node);
+    d_node = &bn.add_conditional_categorical(d, parents,
+        bn.add_constant(d_probabilities));
+    parents.clear();
+    parents.push_back(*d_node);
+    e_node = &bn.add_conditional_categorical(e, parents,
+        bn.add_constant(e_probabilities));
+  }
+
+  RandomInteger a;
+  RandomInteger b;
+  RandomInteger c;
+  RandomInteger d;
+  RandomInteger e;
+  BayesianNetwork bn;
+  CategoricalNode* a_node;
+  ConditionalCategoricalNode* b_node;
+  ConditionalCategoricalNode* c_node;
+  ConditionalCategoricalNode* d_node;
+  ConditionalCategoricalNode* e_node;
+};
+
+BOOST_FIXTURE_TEST_CASE(Marginal, LoopFixture)
+{
+  /* On demand, without calibrate() */
+  CompiledNetwork compiled_bn(bn);
+  check_marginal(compiled_bn, bn, *a_node);
+  check_marginal(compiled_bn, bn, *b_node);
+  check_marginal(compiled_bn, bn, *c_node);
+  check_marginal(compiled_bn, bn, *d_node);
+  check_marginal(compiled_bn, bn, *e_node);
+
+  /* Both orderings triangulate the loop. */
+  CompiledNetwork min_degree_bn(bn, BayesianNetwork::min_degree_ordering);
+  min_degree_bn.calibrate();
+  check_marginal(min_degree_bn, bn, *a_node);
+  check_marginal(min_degree_bn, bn, *b_node);
+  check_marginal(min_degree_bn, bn, *c_node);
+  check_marginal(min_degree_bn, bn, *d_node);
+  check_marginal(min_degree_bn, bn, *e_node);
+}
+
+BOOST_FIXTURE_TEST_CASE(Update, LoopFixture)
+{
+  CompiledNetwork compiled_bn(bn);
+  compiled_bn.calibrate();
+  check_marginal(compiled_bn, bn, *a_node);
+
+  /* New evidence */
+  e_node->value() = e.observation(1);
+  e_node->is_evidence(true);
+  compiled_bn.update(*e_node);
+  check_marginal(compiled_bn, bn, *a_node);
+  check_marginal(compiled_bn, bn, *c_node);
+
+  /* Changed evidence */
+  e_node->value() = e.observation(0);
+  compiled_bn.update(*e_node);
+  check_marginal(compiled_bn, bn, *a_node);
+  check_marginal(compiled_bn, bn, *d_node);
+
+  /* Changed probabilities */
+  RandomConditionalProbabilities& b_probabilities = b_node->probabilities();
+  b_probabilities.set(b.observation(0), a.observation(1), 0.95f);
+  b_probabilities.set(b.observation(1), a.observation(1), 0.05f);
+  compiled_bn.update(*b_node);
+  check_marginal(compiled_bn, bn, *a_node);
+  check_marginal(compiled_bn, bn, *d_node);
+
+  BayesianNetwork other_bn;
+  CategoricalNode& other_node = other_bn.add_categorical(a);
+  BOOST_CHECK_THROW(compiled_bn.update(other_node), out_of_range);
+  BOOST_CHECK_THROW(compiled_bn.marginal(other_node), out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(MessageCache)
+{
+  /* The chain A - B - C - D has the cliques AB, BC and CD in a row, so
+   * the tree has two edges and four messages. */
+  RandomInteger a("CacheA", 2, 0);
+  RandomInteger b("CacheB", 2, 0);
+  RandomInteger c("CacheC", 2, 0);
+  RandomInteger d("CacheD", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.4f;
+  a_probabilities[a.observation(1)] = 0.6f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  fill_conditional_probabilities(b_probabilities, b, a, 1);
+  RandomConditionalProbabilities c_probabilities(c, b);
+  fill_conditional_probabilities(c_probabilities, c, b, 2);
+  RandomConditionalProbabilities d_probabilities(d, c);
+  fill_conditional_probabilities(d_probabilities, d, c, 3);
+
+  BayesianNetwork bn;
+  CategoricalNode& a_node = bn.add_categorical(a,
+      bn.add_constant(a_probabilities));
+  cont::RefVector<DiscreteNode> parents(1, a_node);
+  ConditionalCategoricalNode& b_node = bn.add_conditional_categorical(b,
+      parents, bn.add_constant(b_probabilities));
+  parents.clear();
+  parents.push_back(b_node);
+  ConditionalCategoricalNode& c_node = bn.add_conditional_categorical(c,
+      parents, bn.add_constant(c_probabilities));
+  parents.clear();
+  parents.push_back(c_node);
+  ConditionalCategoricalNode& d_node = bn.add_conditional_categorical(d,
+      parents, bn.add_constant(d_probabilities));
+
+  CompiledNetwork compiled_bn(bn);
+  BOOST_CHECK_EQUAL(compiled_bn.clique_count(), 3);
+
+  /* A query collects the two messages toward its clique only. */
+  check_marginal(compiled_bn, bn, a_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 2);
+  check_marginal(compiled_bn, bn, a_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 2);
+  check_marginal(compiled_bn, bn, d_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 4);
+  check_marginal(compiled_bn, bn, b_node);
+  check_marginal(compiled_bn, bn, c_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 4);
+
+  /* The evidence on D invalidates the two messages sent away from CD. The
+   * messages toward CD stay cached. */
+  d_node.value() = d.observation(1);
+  d_node.is_evidence(true);
+  compiled_bn.update(d_node);
+  CategoricalDistribution d_distribution = compiled_bn.marginal(d_node);
+  BOOST_CHECK_EQUAL(d_distribution[d.observation(1)], 1.0f);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 4);
+  check_marginal(compiled_bn, bn, c_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 5);
+  check_marginal(compiled_bn, bn, a_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 6);
+  check_marginal(compiled_bn, bn, b_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 6);
+
+  /* calibrate() computes all messages again. */
+  compiled_bn.calibrate();
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 10);
+  check_marginal(compiled_bn, bn, a_node);
+  check_marginal(compiled_bn, bn, b_node);
+  BOOST_CHECK_EQUAL(compiled_bn.message_computations(), 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
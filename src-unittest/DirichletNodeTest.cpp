@@ -0,0 +1,152 @@
+/*
+ * DirichletNodeTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/BayesianNetwork.hpp"
+#include "../src-lib/NodeUtils.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include "../src-lib/RandomNumberEngine.hpp"
+#include <boost/test/floating_point_comparison.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(DirichletNodeTest)
+
+BOOST_AUTO_TEST_CASE(CollapsedSampling)
+{
+  /* Three rows of A -> B; A3 is latent, the rest is evidence:
+   *   A1 = 1, B1 = 1
+   *   A2 = 1, B2 = 1
+   *   A3 = ?, B3 = 1
+   * With a prior of 1, the predictive distribution of A3 without itself is
+   * (1/4, 3/4). The predictive of B3 without itself is 1/2 given A3 = 0 and
+   * 3/4 given A3 = 1. So A3 = 0 has the probability
+   * (1/4 * 1/2) / (1/4 * 1/2 + 3/4 * 3/4) = 2/11. */
+  RandomInteger a("CollapsedA", 2, 0);
+  RandomInteger b("CollapsedB", 2, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(b, a), 1.0f);
+  a_params.is_collapsed(true);
+  b_params.is_collapsed(true);
+
+  const int a_values[] =
+  { 1, 1, 0 };
+  cont::vector<CategoricalNode*> a_nodes;
+  for (int r = 0; r != 3; ++r)
+  {
+    CategoricalNode& a_node = bn.add_categorical(a.observation(a_values[r]),
+        a_params);
+    a_node.is_evidence(r != 2);
+    a_nodes.push_back(&a_node);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn.add_conditional_categorical(b.observation(1), parents, b_params).is_evidence(
+        true);
+  }
+
+  /* A3 starts with 0 (0.1 < 1/4) and moves to 1 (0.2 > 2/11). */
+  random_number_engine.seed_from_canonical(
+    { 0.1f, 0.2f });
+  for_each(bn.begin(), bn.end(),
+      make_apply_visitor_delayed(InitSamplingOfNode()));
+  BOOST_CHECK_EQUAL(a_nodes[2]->value(), a.observation(0));
+  BOOST_CHECK_EQUAL(a_nodes[2]->counter(), &a_params);
+  for_each(bn.begin(), bn.end(), make_apply_visitor_delayed(SampleNode()));
+  BOOST_CHECK_EQUAL(a_nodes[2]->value(), a.observation(1));
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 0);
+
+  /* The values follow the counts of the last sweep. */
+  BOOST_CHECK_CLOSE(a_params.value().at(a.observation(1)), 0.8f, 0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(1), a.observation(1)),
+      0.8f, 0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(1), a.observation(0)),
+      0.5f, 0.001f);
+
+  /* A new row A4 = 0, B4 = 1 is counted in the next sweep. Then A3 = 0 has
+   * the probability (2/5 * 2/3) / (2/5 * 2/3 + 3/5 * 3/4) = 0.37. */
+  CategoricalNode& a4 = bn.add_categorical(a.observation(0), a_params);
+  a4.is_evidence(true);
+  cont::RefVector<DiscreteNode> parents(1, a4);
+  bn.add_conditional_categorical(b.observation(1), parents, b_params).is_evidence(
+      true);
+  random_number_engine.seed_from_canonical(0.3f);
+  for_each(bn.begin(), bn.end(), make_apply_visitor_delayed(SampleNode()));
+  BOOST_CHECK_EQUAL(a_nodes[2]->value(), a.observation(0));
+  BOOST_CHECK_CLOSE(a_params.value().at(a.observation(1)), 0.5f, 0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(1), a.observation(0)),
+      0.75f, 0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(CollapsedSharedRow)
+{
+  /* A1 = 1, B1 = 1 are evidence; A2 is latent with the two children
+   * B2 = 1 and B3 = 1 on the same row of the collapsed table of B. Without
+   * A2 and its children, the predictive of A is (1/3, 2/3). Given A2 = 0,
+   * the children have the probability 1/2 * 2/3, the second one counting the
+   * first. Given A2 = 1, they have 2/3 * 3/4. So A2 = 0 has the probability
+   * (1/3 * 1/3) / (1/3 * 1/3 + 2/3 * 1/2) = 1/4. Scoring both children
+   * against the same row would give 9/41 instead. */
+  RandomInteger a("SharedRowA", 2, 0);
+  RandomInteger b("SharedRowB", 2, 0);
+  BayesianNetwork bn;
+  DirichletNode& a_params = bn.add_dirichlet(RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(b, a), 1.0f);
+  a_params.is_collapsed(true);
+  b_params.is_collapsed(true);
+
+  CategoricalNode& a1 = bn.add_categorical(a.observation(1), a_params);
+  a1.is_evidence(true);
+  cont::RefVector<DiscreteNode> parents1(1, a1);
+  bn.add_conditional_categorical(b.observation(1), parents1, b_params).is_evidence(
+      true);
+  CategoricalNode& a2 = bn.add_categorical(a.observation(0), a_params);
+  cont::RefVector<DiscreteNode> parents2(1, a2);
+  for (int c = 0; c != 2; ++c)
+    bn.add_conditional_categorical(b.observation(1), parents2, b_params).is_evidence(
+        true);
+
+  /* A2 starts with 1 (0.9 > 1/3) and moves to 0 (0.23 < 1/4). */
+  random_number_engine.seed_from_canonical(
+    { 0.9f, 0.23f });
+  for_each(bn.begin(), bn.end(),
+      make_apply_visitor_delayed(InitSamplingOfNode()));
+  BOOST_CHECK_EQUAL(a2.value(), a.observation(1));
+  for_each(bn.begin(), bn.end(), make_apply_visitor_delayed(SampleNode()));
+  BOOST_CHECK_EQUAL(a2.value(), a.observation(0));
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 0);
+
+  /* The counts are the same as after a recount. */
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(1), a.observation(0)),
+      0.75f, 0.001f);
+  BOOST_CHECK_CLOSE(b_params.value().at(b.observation(1), a.observation(1)),
+      2.0f / 3.0f, 0.001f);
+}
+
+BOOST_AUTO_TEST_CASE(ObserveWithForgetting)
+{
+  RandomInteger a("ObservedA", 2, 0);
+  DirichletNode a_params(RandomProbabilities(a), 1.0f);
+  BOOST_CHECK_THROW(a_params.forgetting(0.0f), invalid_argument);
+  BOOST_CHECK_CLOSE(a_params.probability(a.observation(0)), 0.5f, 0.001f);
+
+  /* With a factor of 0.5, the count of value 0 goes to 1 + 1/2 + 1/4 + ...
+   * = 2, and the first count of value 1 falls to 2^-1000. With the prior of
+   * 1, this gives (1 + 2) / (2 + 2). The scale passes 1e-200 on the way. */
+  a_params.forgetting(0.5f);
+  a_params.observe(a.observation(1));
+  cont::vector<DiscreteRandomVariable> zeros(1000, a.observation(0));
+  a_params.observe_batch(zeros.begin(), zeros.end());
+  BOOST_CHECK_CLOSE(a_params.probability(a.observation(0)), 0.75f,
+      0.001f);
+  BOOST_CHECK_CLOSE(a_params.probability(a.observation(1)), 0.25f,
+      0.001f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,7 +15,9 @@
 #include <boost/range/numeric.hpp>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_monitor.hpp>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 using namespace boost::adaptors;
 using namespace cpprob;
@@ -567,6 +569,174 @@ BOOST_AUTO_TEST_CASE(Sampling)
   set_observation_probabilities_component_2();
 }
 
+BOOST_AUTO_TEST_CASE(SplitMerge)
+{
+  auto& dp_parameters = dp_parameters_node->value();
+  init_sampling();
+  auto mixture_component_0 = mixture_component.observation(0);
+  auto mixture_component_1 = mixture_component.observation(1);
+
+  CPPROB_CHECKPOINT("The moves are off by default");
+
+  BOOST_CHECK_EQUAL(dp_parameters.split_merge_interval(), 0);
+  random_number_engine.seed_from_canonical(0.0);
+  dp_parameters.sample(dp_parameters_node->children());
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 1);
+
+  CPPROB_CHECKPOINT("Merge component 0 into component 1");
+
+  /* Every second sweep: The first sweep draws no random number. The move
+   * picks node 1 and node 3 (0.0 and 0.9), accepts (0.0) and draws the
+   * parameters of component 1 from its posterior. */
+  dp_parameters.split_merge_interval(2);
+  random_number_engine.seed_from_canonical(
+    { 0.0f, 0.9f, 0.0f, 0.1f, 0.2f, 0.05f, 0.1f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f,
+        0.4f });
+  dp_parameters.sample(dp_parameters_node->children());
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 13);
+  dp_parameters.sample(dp_parameters_node->children());
+  check_number_generator_empty();
+  check_mixture(*dp_parameters_node, *mixture_node1, mixture_component_1,
+      { 0, 3});
+  BOOST_CHECK_EQUAL(mixture_node2->value(), mixture_component_1);
+  BOOST_CHECK_EQUAL(mixture_node3->value(), mixture_component_1);
+
+  CPPROB_CHECKPOINT("Split node 1 and node 3 into the free component 0");
+
+  /* The move picks node 1 and node 2 (0.0 and 0.0), puts node 3 on the side
+   * of node 1 (0.1) and accepts (0.0). */
+  dp_parameters.split_merge_interval(1);
+  random_number_engine.seed_from_canonical(
+    { 0.0f, 0.0f, 0.1f, 0.0f, 0.1f, 0.2f, 0.05f, 0.1f, 0.4f, 0.5f, 0.6f, 0.7f,
+        0.8f, 0.4f, 0.1f, 0.2f, 0.05f, 0.1f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f,
+        0.4f });
+  dp_parameters.sample(dp_parameters_node->children());
+  check_number_generator_empty();
+  check_mixture(*dp_parameters_node, *mixture_node1, mixture_component_0,
+      { 2, 1});
+  BOOST_CHECK_EQUAL(mixture_node2->value(), mixture_component_1);
+  BOOST_CHECK_EQUAL(mixture_node3->value(), mixture_component_0);
+  BOOST_CHECK_EQUAL(mixture_component.value_range().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(BlockedSampling)
+{
+  auto& dp_parameters = dp_parameters_node->value();
+  init_sampling();
+  dp_parameters.truncation(4);
+  dp_parameters.sampling_threads(3);
+
+  /* The nodes do not draw on their own. */
+  random_number_engine.seed_from_canonical(0.5f);
+  mixture_node1->sample();
+  BOOST_CHECK_EQUAL(random_number_engine.size(), 1);
+
+  /* The sweep adds two components up to the truncation level and draws
+   * the components of all nodes. */
+  const initializer_list<float> numbers =
+    { 0.62f, 0.73f, 0.78f, 0.92f, 0.73f, 0.91f, 0.05f, 0.47f, 0.93f, 0.64f,
+        0.88f, 0.13f, 0.47f, 0.26f, 0.54f, 0.57f, 0.03f, 0.23f, 0.29f, 0.90f,
+        0.76f, 0.17f, 0.79f, 0.15f, 0.61f, 0.14f, 0.02f, 0.86f, 0.22f, 0.23f,
+        0.96f, 0.86f, 0.30f, 0.94f, 0.54f, 0.67f, 0.22f, 0.92f, 0.68f, 0.95f,
+        0.88f, 0.31f, 0.37f, 0.18f, 0.16f, 0.08f, 0.31f, 0.60f, 0.02f, 0.67f,
+        0.34f, 0.32f, 0.81f, 0.48f, 0.32f, 0.48f, 0.70f, 0.07f, 0.96f, 0.04f,
+        0.74f, 0.83f, 0.04f, 0.78f, 0.37f, 0.58f, 0.03f, 0.06f, 0.19f, 0.94f,
+        0.21f, 0.75f, 0.91f, 0.92f, 0.35f, 0.36f, 0.52f, 0.76f, 0.12f, 0.74f,
+        0.79f, 0.85f, 0.06f, 0.93f, 0.11f, 0.35f, 0.61f, 0.90f, 0.35f, 0.91f,
+        0.54f, 0.32f, 0.32f, 0.19f, 0.10f, 0.16f, 0.68f, 0.98f, 0.18f, 0.07f,
+        0.97f, 0.53f, 0.41f, 0.25f, 0.59f, 0.81f, 0.46f, 0.42f, 0.07f, 0.90f,
+        0.05f, 0.49f, 0.82f, 0.15f, 0.72f, 0.93f, 0.63f, 0.78f, 0.12f, 0.44f };
+  random_number_engine.seed_from_canonical(numbers);
+  dp_parameters.sample(dp_parameters_node->children());
+
+  BOOST_CHECK_EQUAL(mixture_component.value_range().size(), 4);
+  BOOST_CHECK_EQUAL(observation_probabilities_node->value().size(), 4);
+  BOOST_CHECK_EQUAL(dp_parameters.component_counters().size(), 4);
+  BOOST_CHECK_GT(dp_parameters.component_counters().at(mixture_node1->value()),
+      0);
+  BOOST_CHECK_EQUAL(
+      boost::accumulate(dp_parameters.component_counters() | map_values, 0), 3);
+  BOOST_CHECK_GT(dp_parameters.tail_mass(), 0.0);
+  BOOST_CHECK_LE(dp_parameters.tail_mass(), 1.0);
+
+  /* The managed node counts the observations, and a second sweep moves
+   * them to other components. Then the collapsed rows of the managed node
+   * must follow a recount. */
+  random_number_engine.seed_from_canonical(numbers);
+  observation_probabilities_node->sample();
+  const DiscreteRandomVariable component1 = mixture_node1->value();
+  random_number_engine.seed_from_canonical(
+    { 0.05f, 0.49f, 0.82f, 0.15f, 0.72f, 0.93f, 0.63f, 0.78f, 0.12f, 0.44f,
+        0.54f, 0.32f, 0.32f, 0.19f, 0.10f, 0.16f, 0.68f, 0.98f, 0.18f, 0.07f,
+        0.97f, 0.53f, 0.41f, 0.25f, 0.59f, 0.81f, 0.46f, 0.42f, 0.07f, 0.90f,
+        0.79f, 0.85f, 0.06f, 0.93f, 0.11f, 0.35f, 0.61f, 0.90f, 0.35f, 0.91f,
+        0.74f, 0.83f, 0.04f, 0.78f, 0.37f, 0.58f, 0.03f, 0.06f, 0.19f, 0.94f,
+        0.21f, 0.75f, 0.91f, 0.92f, 0.35f, 0.36f, 0.52f, 0.76f, 0.12f, 0.74f,
+        0.88f, 0.31f, 0.37f, 0.18f, 0.16f, 0.08f, 0.31f, 0.60f, 0.02f, 0.67f,
+        0.34f, 0.32f, 0.81f, 0.48f, 0.32f, 0.48f, 0.70f, 0.07f, 0.96f, 0.04f });
+  dp_parameters.sample(dp_parameters_node->children());
+  BOOST_CHECK(mixture_node1->value() != component1);
+  BOOST_CHECK_EQUAL(mixture_component.value_range().size(), 4);
+  observation_probabilities_node->is_collapsed(true);
+  observation_probabilities_node->sample();
+  const ConditionalCategoricalNode* observation_nodes[] =
+    { observation_node1, observation_node2, observation_node3 };
+  const DirichletProcessNode* mixture_nodes[] =
+    { mixture_node1, mixture_node2, mixture_node3 };
+  for (auto c = mixture_component.value_range().begin();
+      c != mixture_component.value_range().end(); ++c)
+  {
+    for (auto o = observation.value_range().begin();
+        o != observation.value_range().end(); ++o)
+    {
+      float count = 0.0f;
+      float total = 0.0f;
+      for (int n = 0; n != 3; ++n)
+      {
+        if (mixture_nodes[n]->value() != c)
+          continue;
+        total += 1.0f;
+        if (observation_nodes[n]->value() == o)
+          count += 1.0f;
+      }
+      BOOST_CHECK_CLOSE(observation_probabilities_node->value().at(o, c),
+          (1.0f + count) / (5.0f + total), 0.001f);
+    }
+  }
+
+  // Do not leave numbers for the next test.
+  random_number_engine.seed();
+}
+
+BOOST_AUTO_TEST_CASE(Copy)
+{
+  /* The copy keeps the components and refers to its own nodes. */
+  init_sampling();
+  BayesianNetwork bn_copy(bn);
+  BOOST_CHECK_EQUAL(mixture_component.value_range().size(), 2);
+  const ConstantDirichletProcessParametersNode* copy_parameters_node =
+      bn_copy.find<ConstantDirichletProcessParametersNode>(
+          "MixtureComponentParameters");
+  BOOST_REQUIRE(copy_parameters_node != 0);
+  BOOST_CHECK(copy_parameters_node != dp_parameters_node);
+  const DirichletProcessParameters& copy_parameters =
+      copy_parameters_node->value();
+  BOOST_CHECK(
+      copy_parameters.component_counters() == dp_parameters_node->value().component_counters());
+  BOOST_CHECK_EQUAL(&copy_parameters.managed_nodes().front(),
+      bn_copy.find<ConditionalDirichletNode>(
+          observation_probabilities_node->value().name()));
+  BOOST_REQUIRE_EQUAL(copy_parameters_node->children().size(), 3);
+  BOOST_CHECK_EQUAL(copy_parameters_node->children()[1].value(),
+      mixture_node2->value());
+  BOOST_CHECK_EQUAL(&copy_parameters_node->children()[1].parameters(),
+      &copy_parameters);
+  BOOST_CHECK_THROW(bn.overlay(), logic_error);
+  // The chains would share the size of the component variable.
+  BOOST_CHECK_THROW(bn.sample(*mixture_node1, 1, 1, 2, 1), NetworkError);
+  BOOST_CHECK_EQUAL(mixture_component.value_range().size(), 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE(DirichletProcessTest)
@@ -705,12 +875,12 @@ BOOST_AUTO_TEST_CASE(Parameters)
   cout << "\nFill probabilities_node1" << endl;
   BOOST_TEST_CHECKPOINT("Fill probabilities_node1");
   cout << "probabilities_node1 before: " << probabilities_node1.value() << endl;
-  dp_parameters1.extend_managed_node(probabilities_node1, old_condition1.value_range(), condition1.value_range(), child_lists1);
+  dp_parameters1.extend_managed_node(probabilities_node1, old_condition1.value_range(), condition1.value_range(), child_lists1, random_number_engine);
   cout << "probabilities_node1 afterwards: " << probabilities_node1.value() << endl;
   cout << "\nFill probabilities_node2" << endl;
   BOOST_TEST_CHECKPOINT("Fill probabilities_node2");
   cout << "probabilities_node2 before: " << probabilities_node2.value() << endl;
-  dp_parameters1.extend_managed_node(probabilities_node2, old_condition1.value_range(), condition1.value_range(), child_lists2);
+  dp_parameters1.extend_managed_node(probabilities_node2, old_condition1.value_range(), condition1.value_range(), child_lists2, random_number_engine);
   cout << "probabilities_node2 afterwards: " << probabilities_node2.value() << endl;
 
   auto dp_parameters2 = dp_parameters_node2.value();
@@ -718,27 +888,27 @@ BOOST_AUTO_TEST_CASE(Parameters)
 
   cout << "\nFill probabilities_node3 with parent 2" << endl;
   BOOST_TEST_CHECKPOINT("Fill probabilities_node2 with parent 2");
-  dp_parameters2.extend_managed_node(probabilities_node2, old_condition2.value_range(), condition2.value_range(), child_lists2);
+  dp_parameters2.extend_managed_node(probabilities_node2, old_condition2.value_range(), condition2.value_range(), child_lists2, random_number_engine);
   cout << "probabilities_node2 afterwards: " << probabilities_node2.value() << endl;
 
   cout << "\nCreate new component of parent 1" << endl;
 #ifndef WITHOUT_INITIALIZER_LIST
   dp_parameters1.create_component(
-      { &child1_node4});
+      { &child1_node4}, random_number_engine);
 #else
   cont::RefVector<ConditionalCategoricalNode> children(1, child1_node4);
-  dp_parameters1.create_component(children);
+  dp_parameters1.create_component(children, random_number_engine);
 #endif
   cout << "probabilities_node1 afterwards: " << probabilities_node1.value() << endl;
 
   cout << "\nCreate new component of parent 2" << endl;
 #ifndef WITHOUT_INITIALIZER_LIST
   dp_parameters2.create_component(
-      { &child2_node4});
+      { &child2_node4}, random_number_engine);
 #else
   children.clear();
   children.push_back(child2_node4);
-  dp_parameters2.create_component(children);
+  dp_parameters2.create_component(children, random_number_engine);
 #endif
   cout << "probabilities_node2 afterwards: " << probabilities_node2.value() << endl;
 }
@@ -879,4 +1049,166 @@ BOOST_AUTO_TEST_CASE(Node)
   cout << probabilities_node2.value() << endl;
 }
 
+/* The Dirichlet-multinomial probability of the counters as the product of
+ * the rising factorials a (a + 1) ... (a + n - 1), which the memoised
+ * logarithm replaces. */
+double
+rising_factorial_prior(const ConditionalDirichletNode::Parameters& parameters,
+    const DirichletProcessParameters::ComponentCounters& counters)
+{
+  double sum_parameters = 0.0;
+  size_t sum_counters = 0;
+  double nominator = 1.0;
+  for (auto parameter = parameters.begin(); parameter != parameters.end();
+      ++parameter)
+  {
+    double p = parameter->second;
+    sum_parameters += p;
+    auto counter = counters.find(parameter->first);
+    size_t n = counter != counters.end() ? counter->second : 0;
+    sum_counters += n;
+    for (; n != 0; --n, p += 1.0)
+      nominator *= p;
+  }
+
+  double denominator = 1.0;
+  for (; sum_counters != 0; --sum_counters, sum_parameters += 1.0)
+    denominator *= sum_parameters;
+  return nominator / denominator;
+}
+
+BOOST_AUTO_TEST_CASE(LogPrior)
+{
+  RandomInteger component("PriorComponent", 1, 0);
+  RandomInteger value("PriorValue", 3, 0);
+  BayesianNetwork bn;
+  ConditionalDirichletNode& node = bn.add_conditional_dirichlet(
+      RandomConditionalProbabilities(value, component), 0.5f);
+  node.parameters()[value.observation(1)] = 2.0f;
+  cont::RefVector<DiscreteNode> parents(1, bn.add_categorical(component));
+  cont::RefVector<ConditionalCategoricalNode> children;
+  cont::RefVector<ConditionalCategoricalNode> first_children;
+  const unsigned int child_values[] = { 0, 1, 1, 2, 1, 0, 1 };
+  for (auto v = begin(child_values); v != end(child_values); ++v)
+  {
+    ConditionalCategoricalNode& child = bn.add_conditional_categorical(value,
+        parents, node);
+    child.value() = value.observation(*v);
+    children.push_back(child);
+    if (v < begin(child_values) + 3)
+      first_children.push_back(child);
+  }
+  cont::vector<ConditionalDirichletNode*> managed_nodes(1, &node);
+  DirichletProcessParameters parameters("PriorComponent", 1, managed_nodes);
+
+  /* All children, then the first three. The second call of each is a hit
+   * of the memo. */
+  DirichletProcessParameters::ComponentCounters counters;
+  counters[value.observation(0)] = 2;
+  counters[value.observation(1)] = 4;
+  counters[value.observation(2)] = 1;
+  const double expected = rising_factorial_prior(node.parameters(), counters);
+  BOOST_CHECK_CLOSE(
+      exp(parameters.log_prior_probability_of_managed_nodes(children)),
+      expected, 1e-4);
+  BOOST_CHECK_CLOSE(
+      exp(parameters.log_prior_probability_of_managed_nodes(children)),
+      expected, 1e-4);
+  BOOST_CHECK_EQUAL(parameters.log_prior_cache_.size(), 1);
+
+  counters[value.observation(1)] = 2;
+  counters[value.observation(2)] = 0;
+  counters[value.observation(0)] = 1;
+  const double expected_first = rising_factorial_prior(node.parameters(),
+      counters);
+  BOOST_CHECK_CLOSE(
+      exp(parameters.log_prior_probability_of_managed_nodes(first_children)),
+      expected_first, 1e-4);
+  BOOST_CHECK_CLOSE(
+      exp(parameters.log_prior_probability_of_managed_nodes(first_children)),
+      expected_first, 1e-4);
+  BOOST_CHECK_EQUAL(parameters.log_prior_cache_.size(), 2);
+
+  /* A parameter of 0 allows no count of its value. */
+  node.parameters()[value.observation(2)] = 0.0f;
+  BOOST_CHECK_CLOSE(
+      exp(parameters.log_prior_probability_of_managed_nodes(first_children)),
+      rising_factorial_prior(node.parameters(), counters), 1e-4);
+  BOOST_CHECK_EQUAL(parameters.log_prior_probability_of_managed_nodes(children),
+      -numeric_limits<double>::infinity());
+}
+
+BOOST_AUTO_TEST_CASE(ExtendRows)
+{
+  const RandomConditionalProbabilities::Layout layouts[] =
+  { RandomConditionalProbabilities::map_layout,
+      RandomConditionalProbabilities::dense_layout };
+  for (auto layout = begin(layouts); layout != end(layouts); ++layout)
+  {
+    /* RowsA comes before RowsB in the order of the names. So the component
+     * is not the last condition variable, and a new component moves the
+     * rows of the second value of RowsB. */
+    RandomInteger component("RowsA", 2, 0);
+    RandomInteger other("RowsB", 2, 0);
+    RandomInteger value("RowsValue", 3, 0);
+    RandomConditionalProbabilities probabilities(value,
+        DiscreteJointRandomVariable(component, other));
+    unsigned int seed = 1;
+    for (unsigned int c = 0; c != 4; ++c)
+    {
+      for (unsigned int v = 0; v != 3; ++v)
+      {
+        seed = (seed * 7 + 3) % 11;
+        probabilities.set(value.observation(v),
+            DiscreteJointRandomVariable(component.observation(c % 2),
+                other.observation(c / 2)), (1.0f + seed) / 11.0f);
+      }
+    }
+    probabilities.normalize();
+    probabilities.layout(*layout);
+    cont::vector<float> old_rows;
+    for (unsigned int c = 0; c != 4; ++c)
+    {
+      const DiscreteJointRandomVariable old_condition(
+          component.observation(c % 2), other.observation(c / 2));
+      for (unsigned int v = 0; v != 3; ++v)
+        old_rows.push_back(
+            probabilities.at(value.observation(v), old_condition));
+    }
+
+    BayesianNetwork bn;
+    ConditionalDirichletNode& node = bn.add_conditional_dirichlet(
+        probabilities, 1);
+    cont::RefVector<DiscreteNode> parents;
+    parents.push_back(bn.add_categorical(component));
+    parents.push_back(bn.add_categorical(other));
+    bn.add_conditional_categorical(value, parents, node);
+    cont::vector<ConditionalDirichletNode*> managed_nodes(1, &node);
+    DirichletProcessParameters parameters("RowsA", 1, managed_nodes);
+    parameters.component_counters_[component.observation(0)] = 1;
+    parameters.component_counters_[component.observation(1)] = 1;
+
+    RandomNumberEngine rne;
+    rne.seed_from_canonical(
+    { 0.1f, 0.5f, 0.9f, 0.3f, 0.7f, 0.2f, 0.6f, 0.4f, 0.8f, 0.05f, 0.95f,
+        0.45f, 0.25f, 0.75f, 0.15f, 0.65f, 0.35f, 0.55f, 0.85f, 0.12f,
+        0.62f, 0.32f, 0.82f, 0.42f });
+    parameters.create_component(cont::RefVector<ConditionalCategoricalNode>(),
+        rne);
+
+    const RandomConditionalProbabilities& rows = node.value();
+    BOOST_CHECK(rows.layout() == *layout);
+    BOOST_CHECK_EQUAL(rows.size(), 6);
+    auto old_p = old_rows.begin();
+    for (unsigned int c = 0; c != 4; ++c)
+    {
+      const DiscreteJointRandomVariable new_condition(
+          component.observation(c % 2), other.observation(c / 2));
+      for (unsigned int v = 0; v != 3; ++v, ++old_p)
+        BOOST_CHECK_EQUAL(rows.at(new_condition).at(value.observation(v)),
+            *old_p);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,64 @@
+/*
+ * DiscreteRandomVariableTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/DiscreteJointRandomVariable.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <thread>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(DiscreteRandomVariableTest)
+
+BOOST_AUTO_TEST_CASE(JointKind)
+{
+  RandomInteger a("JointKindA", 2, 1);
+  RandomInteger b("JointKindB", 3, 2);
+  DiscreteJointRandomVariable ab(a, b);
+  DiscreteJointRandomVariable ba(b, a);
+
+  BOOST_CHECK_EQUAL(ab.name(), "JointKindAJointKindB");
+  BOOST_CHECK_EQUAL(ab.value_range().size(), 6);
+  BOOST_CHECK_EQUAL(ab, ba);
+
+  DiscreteJointRandomVariable single;
+  single.insert(a);
+  BOOST_CHECK_EQUAL(single, a);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentRegistration)
+{
+  // Threads register the same and different kinds at the same time. The
+  // same names must end up in the same kind.
+  const int thread_count = 4;
+  const int kind_count = 2000;
+  cont::vector<cont::vector<DiscreteRandomVariable> > kinds(thread_count);
+  cont::vector<thread> threads;
+  for (int t = 0; t != thread_count; ++t)
+    threads.push_back(thread([t, &kinds]()
+    {
+      for (int k = 0; k != kind_count; ++k)
+      {
+        ostringstream name;
+        name << "ConcurrentKind" << k;
+        RandomInteger var(name.str(), 4, 0);
+        RandomInteger other("ConcurrentOther", 4, 0);
+        kinds[t].push_back(DiscreteJointRandomVariable(var, other));
+      }
+    }));
+  for (auto t = threads.begin(); t != threads.end(); ++t)
+    t->join();
+
+  for (int t = 1; t != thread_count; ++t)
+    for (int k = 0; k != kind_count; ++k)
+      BOOST_CHECK_EQUAL(kinds[t][k], kinds[0][k]);
+  BOOST_CHECK_EQUAL(kinds[0][0].value_range().size(), 16);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,215 @@
+/*
+ * MarkovBlanketKernelTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/BayesianNetwork.hpp"
+#include "../src-lib/DiscreteJointRandomVariable.hpp"
+#include "../src-lib/MarkovBlanketKernel.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(MarkovBlanketKernelTest)
+
+/* Fills the table with uneven probabilities; the seed varies them. */
+void
+fill_conditional_probabilities(RandomConditionalProbabilities& table,
+    const DiscreteRandomVariable& var, const DiscreteRandomVariable& condition,
+    unsigned int seed)
+{
+  for (auto c = condition.value_range().begin();
+      c != condition.value_range().end(); ++c)
+  {
+    for (auto v = var.value_range().begin(); v != var.value_range().end();
+        ++v)
+    {
+      seed = (seed * 7 + 3) % 11;
+      table.set(v, c, (1.0f + seed) / 11.0f);
+    }
+  }
+  table.normalize();
+}
+
+/* The likelihoods as the nodes computed them before the kernel: with
+ * DiscreteRandomReferences::sub_range() and the lookups in the tables. */
+CategoricalDistribution
+lookup_likelihoods(const DiscreteRandomVariable& var,
+    const DiscreteNode::Children& children)
+{
+  CategoricalDistribution distribution;
+  for (auto v = var.value_range().begin(); v != var.value_range().end(); ++v)
+    distribution[v] = 1.0f;
+  for (auto c = children.begin(); c != children.end(); ++c)
+  {
+    const ConditionalCategoricalNode& child = *c;
+    const RandomConditionalProbabilities& probabilities =
+        child.probabilities();
+    auto condition = child.condition().sub_range(var).begin();
+    for (auto d = distribution.begin(); d != distribution.end();
+        ++d, ++condition)
+      d->second *= probabilities.at(condition.joint_value()).at(
+          child.value());
+  }
+  return distribution;
+}
+
+void
+check_kernel(const MarkovBlanketKernel& kernel,
+    const DiscreteRandomVariable& var, const DiscreteNode::Children& children)
+{
+  BOOST_REQUIRE(kernel.is_current());
+  CategoricalDistribution actual;
+  for (auto v = var.value_range().begin(); v != var.value_range().end(); ++v)
+    actual[v] = 1.0f;
+  kernel.multiply_likelihoods(actual);
+  const CategoricalDistribution expected = lookup_likelihoods(var, children);
+  auto a = actual.begin();
+  for (auto e = expected.begin(); e != expected.end(); ++e, ++a)
+  {
+    BOOST_CHECK(a->first == e->first);
+    BOOST_CHECK_EQUAL(a->second, e->second);
+  }
+}
+
+/* X has three children: Y | X in the map layout, Z | W, X in the dense
+ * layout, and V | X, W, where X comes first in the joint condition. */
+struct BlanketFixture
+{
+  BlanketFixture()
+      : w("BlanketW", 2, 0), x("BlanketX", 3, 0), y("BlanketY", 2, 0), z(
+          "BlanketZ", 3, 0), v("BlanketV", 2, 0), bn()
+  {
+    RandomProbabilities w_probabilities(w);
+    w_probabilities[w.observation(0)] = 0.4f;
+    w_probabilities[w.observation(1)] = 0.6f;
+    RandomProbabilities x_probabilities(x);
+    x_probabilities[x.observation(0)] = 0.2f;
+    x_probabilities[x.observation(1)] = 0.5f;
+    x_probabilities[x.observation(2)] = 0.3f;
+    RandomConditionalProbabilities y_probabilities(y, x);
+    fill_conditional_probabilities(y_probabilities, y, x, 1);
+    const DiscreteJointRandomVariable wx(w, x);
+    RandomConditionalProbabilities z_probabilities(z, wx);
+    fill_conditional_probabilities(z_probabilities, z, wx, 2);
+    z_probabilities.layout(RandomConditionalProbabilities::dense_layout);
+    RandomConditionalProbabilities v_probabilities(v, wx);
+    fill_conditional_probabilities(v_probabilities, v, wx, 3);
+
+    w_node = &bn.add_categorical(w, bn.add_constant(w_probabilities));
+    x_node = &bn.add_categorical(x, bn.add_constant(x_probabilities));
+    cont::RefVector<DiscreteNode> parents(1, *x_node);
+    y_node = &bn.add_conditional_categorical(y, parents,
+        bn.add_constant(y_probabilities));
+    parents.clear();
+    parents.push_back(*w_node);
+    parents.push_back(*x_node);
+    z_node = &bn.add_conditional_categorical(z, parents,
+        bn.add_constant(z_probabilities));
+    parents.clear();
+    parents.push_back(*x_node);
+    parents.push_back(*w_node);
+    v_node = &bn.add_conditional_categorical(v, parents,
+        bn.add_constant(v_probabilities));
+  }
+
+  RandomInteger w;
+  RandomInteger x;
+  RandomInteger y;
+  RandomInteger z;
+  RandomInteger v;
+  BayesianNetwork bn;
+  CategoricalNode* w_node;
+  CategoricalNode* x_node;
+  ConditionalCategoricalNode* y_node;
+  ConditionalCategoricalNode* z_node;
+  ConditionalCategoricalNode* v_node;
+};
+
+BOOST_FIXTURE_TEST_CASE(Likelihoods, BlanketFixture)
+{
+  BOOST_CHECK(
+      z_node->probabilities().layout() == RandomConditionalProbabilities::dense_layout);
+  BOOST_CHECK(
+      y_node->probabilities().layout() == RandomConditionalProbabilities::map_layout);
+
+  MarkovBlanketKernel kernel;
+  BOOST_CHECK(!kernel.is_current());
+  kernel.compile(x_node->value(), x_node->children());
+
+  /* For every value of the other parent and of the children */
+  for (unsigned int w_value = 0; w_value != 2; ++w_value)
+  {
+    w_node->value() = w.observation(w_value);
+    for (unsigned int child_values = 0; child_values != 12; ++child_values)
+    {
+      y_node->value() = y.observation(child_values % 2);
+      z_node->value() = z.observation(child_values / 2 % 3);
+      v_node->value() = v.observation(child_values / 6);
+      check_kernel(kernel, x_node->value(), x_node->children());
+    }
+  }
+
+  /* The parent W sees the same children except Y. */
+  MarkovBlanketKernel w_kernel;
+  w_kernel.compile(w_node->value(), w_node->children());
+  check_kernel(w_kernel, w_node->value(), w_node->children());
+}
+
+BOOST_FIXTURE_TEST_CASE(Revision, BlanketFixture)
+{
+  MarkovBlanketKernel kernel;
+  kernel.compile(x_node->value(), x_node->children());
+
+  /* set() in existing rows keeps the probabilities in place, in both
+   * layouts. The kernel reads the new values. */
+  y_node->probabilities().set(y.observation(0), x.observation(1), 0.9f);
+  y_node->probabilities().set(y.observation(1), x.observation(1), 0.1f);
+  w.observation(1);
+  z_node->probabilities().set(z.observation(2),
+      DiscreteJointRandomVariable(w, x), 0.05f);
+  BOOST_CHECK(kernel.is_current());
+  check_kernel(kernel, x_node->value(), x_node->children());
+
+  /* Sampling reads the tables as constants. */
+  const RandomConditionalProbabilities& const_z = z_node->probabilities();
+  BOOST_CHECK_EQUAL(const_z.at(DiscreteJointRandomVariable(w, x)).size(), 3);
+  BOOST_CHECK(const_z.begin() != const_z.end());
+  BOOST_CHECK(kernel.is_current());
+
+  /* A conversion of the layout moves the probabilities. */
+  z_node->probabilities().layout(RandomConditionalProbabilities::map_layout);
+  BOOST_CHECK(!kernel.is_current());
+  kernel.compile(x_node->value(), x_node->children());
+  check_kernel(kernel, x_node->value(), x_node->children());
+
+  /* So does a non-const access to a whole row. */
+  y_node->probabilities()[x.observation(2)].set(y.observation(0), 0.7f);
+  BOOST_CHECK(!kernel.is_current());
+  kernel.compile(x_node->value(), x_node->children());
+  BOOST_CHECK(kernel.is_current());
+
+  y_node->probabilities().at(x.observation(2));
+  BOOST_CHECK(!kernel.is_current());
+  kernel.compile(x_node->value(), x_node->children());
+
+  /* And an assignment of the whole table */
+  RandomConditionalProbabilities v_probabilities(v_node->probabilities());
+  v_node->probabilities() = v_probabilities;
+  BOOST_CHECK(!kernel.is_current());
+  kernel.compile(x_node->value(), x_node->children());
+  check_kernel(kernel, x_node->value(), x_node->children());
+
+  /* A copy of a kernel is not compiled: the copy of a node has other
+   * children. */
+  MarkovBlanketKernel copy(kernel);
+  BOOST_CHECK(!copy.is_current());
+  copy = kernel;
+  BOOST_CHECK(!copy.is_current());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,198 @@
+/*
+ * PlateNodeTest.cpp
+ *
+ *  Created on: 17.10.2026
+ *      Author: wbam
+ */
+
+#include "../src-lib/BayesianNetwork.hpp"
+#include "../src-lib/RandomInteger.hpp"
+#include "../src-lib/RandomNumberEngine.hpp"
+#include <boost/test/unit_test.hpp>
+
+using namespace cpprob;
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(PlateNodeTest)
+
+BOOST_AUTO_TEST_CASE(Table)
+{
+  RandomInteger a("PlateA", 2, 0);
+  RandomInteger b("PlateB", 3, 0);
+  EvidenceTable table("PlateTable");
+  table.insert(a.observation(1));
+  table.insert(b.observation(2));
+  table.insert(a.observation(0));
+
+  BOOST_CHECK_EQUAL(table.size(), 2);
+  BOOST_CHECK(table.has_column(b));
+  BOOST_CHECK_EQUAL(table.at(0, a), a.observation(1));
+  BOOST_CHECK_EQUAL(table.at(1, a), a.observation(0));
+  BOOST_CHECK_EQUAL(table.at(0, b), b.observation(2));
+  BOOST_CHECK_THROW(table.at(1, b), out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(Learn)
+{
+  // The plate must learn the same parameters as one node per row and
+  // variable.
+  RandomInteger a("PlateA", 2, 0);
+  RandomInteger b("PlateB", 3, 0);
+  const int rows[][2] =
+  {
+  { 0, 0 },
+  { 0, 1 },
+  { 1, 2 },
+  { 1, 2 },
+  { 0, 0 } };
+
+  BayesianNetwork bn_nodes;
+  DirichletNode& a_params_nodes = bn_nodes.add_dirichlet(
+      RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params_nodes =
+      bn_nodes.add_conditional_dirichlet(RandomConditionalProbabilities(b, a),
+          1.0f);
+  BayesianNetwork bn_plate;
+  DirichletNode& a_params_plate = bn_plate.add_dirichlet(
+      RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params_plate =
+      bn_plate.add_conditional_dirichlet(RandomConditionalProbabilities(b, a),
+          1.0f);
+
+  EvidenceTable table;
+  for (int r = 0; r != 5; ++r)
+  {
+    CategoricalNode& a_node = bn_nodes.add_categorical(
+        a.observation(rows[r][0]), a_params_nodes);
+    a_node.is_evidence(true);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn_nodes.add_conditional_categorical(b.observation(rows[r][1]), parents,
+        b_params_nodes).is_evidence(true);
+
+    table.insert(a.observation(rows[r][0]));
+    table.insert(b.observation(rows[r][1]));
+  }
+  PlateTemplate plate_template;
+  plate_template.add_categorical(a, a_params_plate);
+  plate_template.add_conditional_categorical(b,
+      cont::vector<DiscreteRandomVariable>(1, a), b_params_plate);
+  PlateNode& plate = bn_plate.add_plate(plate_template, table);
+  BOOST_CHECK(plate.is_evidence());
+  BOOST_CHECK_EQUAL(plate.size(), 5);
+
+  bn_nodes.learn();
+  bn_plate.learn();
+  BOOST_CHECK(a_params_plate.value() == a_params_nodes.value());
+  BOOST_CHECK(b_params_plate.value() == b_params_nodes.value());
+
+  BayesianNetwork bn_copy(bn_plate);
+  bn_copy.learn();
+  BOOST_CHECK(
+      bn_copy.at<ConditionalDirichletNode>(b_params_plate.value().name()).value() == b_params_nodes.value());
+}
+
+BOOST_AUTO_TEST_CASE(Observe)
+{
+  // Observing the rows must learn the same parameters as one node per row,
+  // without any node or plate in the network.
+  RandomInteger a("PlateA", 2, 0);
+  RandomInteger b("PlateB", 3, 0);
+  const int rows[][2] =
+  {
+  { 0, 0 },
+  { 0, 1 },
+  { 1, 2 },
+  { 1, 2 },
+  { 0, 0 } };
+
+  BayesianNetwork bn_nodes;
+  DirichletNode& a_params_nodes = bn_nodes.add_dirichlet(
+      RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params_nodes =
+      bn_nodes.add_conditional_dirichlet(RandomConditionalProbabilities(b, a),
+          1.0f);
+  BayesianNetwork bn_observed;
+  DirichletNode& a_params_observed = bn_observed.add_dirichlet(
+      RandomProbabilities(a), 1.0f);
+  ConditionalDirichletNode& b_params_observed =
+      bn_observed.add_conditional_dirichlet(
+          RandomConditionalProbabilities(b, a), 1.0f);
+
+  EvidenceTable table;
+  for (int r = 0; r != 5; ++r)
+  {
+    CategoricalNode& a_node = bn_nodes.add_categorical(
+        a.observation(rows[r][0]), a_params_nodes);
+    a_node.is_evidence(true);
+    cont::RefVector<DiscreteNode> parents(1, a_node);
+    bn_nodes.add_conditional_categorical(b.observation(rows[r][1]), parents,
+        b_params_nodes).is_evidence(true);
+
+    table.insert(a.observation(rows[r][0]));
+    table.insert(b.observation(rows[r][1]));
+  }
+  PlateTemplate plate_template;
+  plate_template.add_categorical(a, a_params_observed);
+  plate_template.add_conditional_categorical(b,
+      cont::vector<DiscreteRandomVariable>(1, a), b_params_observed);
+  plate_template.observe(table);
+  BOOST_CHECK_EQUAL(bn_observed.size(), 2);
+
+  // (1 + 3) / (2 + 5) and (1 + 2) / (3 + 2)
+  BOOST_CHECK_EQUAL(a_params_observed.probability(a.observation(0)),
+      4.0f / 7.0f);
+  BOOST_CHECK_EQUAL(
+      b_params_observed.probability(b.observation(2), a.observation(1)),
+      3.0f / 5.0f);
+
+  bn_nodes.learn();
+  bn_observed.learn();
+  BOOST_CHECK(a_params_observed.value() == a_params_nodes.value());
+  BOOST_CHECK(b_params_observed.value() == b_params_nodes.value());
+
+  BayesianNetwork bn_copy(bn_observed);
+  bn_copy.learn();
+  BOOST_CHECK(
+      bn_copy.at<ConditionalDirichletNode>(b_params_observed.value().name()).value() == b_params_nodes.value());
+}
+
+BOOST_AUTO_TEST_CASE(SampleLatent)
+{
+  // B copies A, so the latent A must follow the observed B whatever the
+  // random numbers are.
+  RandomInteger a("PlateA", 2, 0);
+  RandomInteger b("PlateB", 2, 0);
+  RandomProbabilities a_probabilities(a);
+  a_probabilities[a.observation(0)] = 0.5f;
+  a_probabilities[a.observation(1)] = 0.5f;
+  RandomConditionalProbabilities b_probabilities(b, a);
+  b_probabilities[a.observation(0)][b.observation(0)] = 1.0f;
+  b_probabilities[a.observation(0)][b.observation(1)] = 0.0f;
+  b_probabilities[a.observation(1)][b.observation(0)] = 0.0f;
+  b_probabilities[a.observation(1)][b.observation(1)] = 1.0f;
+
+  BayesianNetwork bn;
+  PlateTemplate plate_template;
+  plate_template.add_categorical(a, bn.add_constant(a_probabilities));
+  plate_template.add_conditional_categorical(b,
+      cont::vector<DiscreteRandomVariable>(1, a),
+      bn.add_constant(b_probabilities));
+  EvidenceTable table;
+  const int b_values[] =
+  { 1, 0, 1, 1 };
+  for (int r = 0; r != 4; ++r)
+    table.insert(b.observation(b_values[r]));
+  PlateNode& plate = bn.add_plate(plate_template, table);
+  BOOST_CHECK(!plate.is_evidence());
+  BOOST_CHECK(!plate.is_evidence(a));
+  BOOST_CHECK(plate.is_evidence(b));
+
+  random_number_engine.seed_from_canonical(
+    { 0.1f, 0.9f, 0.3f, 0.7f, 0.2f, 0.8f, 0.4f, 0.6f });
+  plate.init_sampling();
+  plate.sample();
+  for (int r = 0; r != 4; ++r)
+    BOOST_CHECK_EQUAL(plate.value().at(r, a), a.observation(b_values[r]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()